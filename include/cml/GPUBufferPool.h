@@ -0,0 +1,44 @@
+#ifndef CML_GPU_BUFFER_POOL_H
+#define CML_GPU_BUFFER_POOL_H
+
+#include <cml/device/GPU.h>
+#include <intdefs.h>
+
+#include <stddef.h>
+
+// Smallest size class, every request is rounded up to at least this many bytes
+#define CML_GPU_BUFFER_MIN_SIZE 256
+
+// Device buffers handed out by size class and kept for reuse once released, so binding and unbinding
+// models in a long running process reuses device memory instead of creating new buffers each time.
+// Size classes are quarter steps between powers of two, a buffer is at most a quarter larger than asked for.
+// Buffers are CL_MEM_READ_WRITE. Safe to use from several threads.
+typedef struct cml_GPUBufferPool cml_GPUBufferPool;
+
+typedef struct {
+    uint64 requests;    // cml_acquireGPUBuffer calls
+    uint64 hits;        // requests served by a pooled buffer
+    uint64 bytesInUse;  // of buffers acquired and not released yet
+    uint64 bytesPooled; // of released buffers kept for reuse
+    uint64 peakBytes;   // highest bytesInUse + bytesPooled so far
+} cml_GPUBufferPoolStats;
+
+// Buffers of gpu's context, gpu has to outlive the pool. Released buffers that would take the pooled bytes
+// over limit are freed instead, 0 keeps every released buffer.
+cml_GPUBufferPool* cml_createGPUBufferPool(cml_GPU* gpu, const size_t limit);
+// Frees the pooled buffers, buffers still acquired are left to their users to release with clReleaseMemObject
+void cml_deleteGPUBufferPool(cml_GPUBufferPool* pool);
+
+// A buffer of at least size bytes, cml_getGPUBufferSizeClass(size) exactly
+// Returns NULL if the device can't create one
+cl_mem cml_acquireGPUBuffer(cml_GPUBufferPool* pool, const size_t size);
+// buffer has to come from cml_acquireGPUBuffer on the same pool and not be in use anymore
+void cml_releaseGPUBuffer(cml_GPUBufferPool* pool, cl_mem buffer);
+// Frees every pooled buffer, returns the bytes freed
+size_t cml_trimGPUBufferPool(cml_GPUBufferPool* pool);
+
+cml_GPUBufferPoolStats cml_getGPUBufferPoolStats(cml_GPUBufferPool* pool);
+// Bytes a buffer of size comes in
+size_t cml_getGPUBufferSizeClass(const size_t size);
+
+#endif // CML_GPU_BUFFER_POOL_H
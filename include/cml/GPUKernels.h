@@ -0,0 +1,68 @@
+#ifndef CML_GPU_KERNELS_H
+#define CML_GPU_KERNELS_H
+
+#include <cml/device/GPU.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Programs of the library, compiled into it (see KernelSources.h). cml_simpleSetupGPU, which is part of
+// the matrix library, still reads its three from the working directory.
+#define CML_MATRIX_MULTIPLY_PROGRAM "matrix_multiply.cl"
+#define CML_MATRIX_ADD_ROW_PROGRAM "matrix_add_row.cl"
+#define CML_MATRIX_RELU_PROGRAM "matrix_relu.cl"
+#define CML_MATRIX_MULTIPLY_TILED_PROGRAM "matrix_multiply_tiled.cl"
+#define CML_MATRIX_ADD_ROW_BROADCAST_PROGRAM "matrix_add_row_broadcast.cl"
+#define CML_MATRIX_DENSE_PROGRAM "matrix_dense.cl"
+
+// A work-group of matrixMultiplyTiled computes a CML_MULTIPLY_TILE_ROWS x CML_MULTIPLY_TILE_COLUMNS block
+// of the result, CML_MULTIPLY_TILE_WIDTH adjacent columns per work-item. Must match matrix_multiply_tiled.cl
+#define CML_MULTIPLY_TILE_ROWS 16
+#define CML_MULTIPLY_TILE_COLUMNS 64
+#define CML_MULTIPLY_TILE_WIDTH 4
+
+// Kernel objects keep their arguments, so every user gets its own instance of the kernel instead of
+// sharing the one in gpu->kernelMap. The program is looked up through gpu->kernelMap, then through
+// gpu->programMap, and only loaded and built, into gpu->programMap, the first time a kernel of it is
+// asked for, so every program is compiled once per gpu. Kernel names are expected to be unique per gpu,
+// which only holds for the library's own programs, use cml_createGPUKernelFromProgram for any other.
+// programFilename names an embedded program, any other file is read from that path.
+// Like the rest of cml_GPU, not safe to call from several threads on the same gpu.
+// Returns a kernel to release with clReleaseKernel, NULL if the program can't be read or built
+cl_kernel cml_createGPUKernelInstance(cml_GPU* gpu, const char* programFilename, const char* kernelName);
+// Same as cml_createGPUKernelInstance from the programs gpu has loaded only, nothing is built
+// Returns NULL if none of them has the kernel
+cl_kernel cml_createLoadedGPUKernelInstance(cml_GPU* gpu, const char* kernelName);
+// Creates kernelName from programFilename only. Loaded programs are not searched, so a kernel of the same name
+// in another program, builtin or not, is never used instead. The program is built through the program cache
+// the first time gpu's context asks for it and kept in a table of the library, not in gpu->programMap, until
+// cml_releaseGPUPrograms. The table is shared by every gpu, so this is not safe to call from several threads
+// at once even on different gpus.
+// Returns a kernel to release with clReleaseKernel, NULL if the program can't be read or built or lacks the kernel
+cl_kernel cml_createGPUKernelFromProgram(cml_GPU* gpu, const char* programFilename, const char* kernelName);
+// Releases the programs cml_createGPUKernelFromProgram built for gpu's context, call it before cml_deleteGPU.
+// Kernels created from them keep working until they are released.
+void cml_releaseGPUPrograms(cml_GPU* gpu);
+
+// Like cml_simpleSetupGPU on the first device of cml_getGPUsWithCUDASupport, but every program comes
+// from the embedded sources and is built through the program cache (see GPUProgramCache.h), including
+// the ones bound models use. Does not depend on the working directory.
+// A program that fails to load is left out. Returns a gpu with context == NULL if there is no device
+cml_GPU cml_setupGPU();
+// cml_setupGPU on the given device, for setups with more than one
+cml_GPU cml_setupGPUForDevice(cl_device_id device);
+
+// Whether matrixMultiplyTiled beats matrixMultiply for a [rows x sharedDimension] * [sharedDimension x columns]
+// multiply. Its float4 loads need columns to be a multiple of CML_MULTIPLY_TILE_WIDTH, and narrow or short
+// results leave most of a work-group idle.
+bool cml_useTiledMatrixMultiply(const size_t rows, const size_t sharedDimension, const size_t columns);
+// Whether the device runs work-groups the size matrixMultiplyTiled requires
+bool cml_canRunTiledMatrixMultiply(cml_GPU* gpu, cl_kernel tiledKernel);
+
+// Launch sizes of a 2 dimensional matrixMultiplyTiled for a result of rows x columns, whole tiles
+void cml_getTiledMatrixMultiplyWorkSize(const size_t rows, const size_t columns, size_t* globalSize, size_t* localSize);
+// Launch size of a 2 dimensional matrixDense kernel for a result of rows x columns, rounded up to whole
+// work-groups of localSize. A localSize of NULL or {0, 0} leaves the work-group size to the driver
+void cml_getDenseWorkSize(const size_t rows, const size_t columns, const size_t* localSize, size_t* globalSize);
+
+#endif // CML_GPU_KERNELS_H
@@ -0,0 +1,93 @@
+#ifndef CML_GPU_MODEL_H
+#define CML_GPU_MODEL_H
+
+#include <cml/ActivationFunction.h>
+#include <cml/GPUBufferPool.h>
+#include <cml/GPUTuning.h>
+#include <cml/Model.h>
+#include <cml/device/GPU.h>
+#include <cml/util/Thread.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// How a bound layer runs on the device
+enum cml_GPULayerKernels {
+    CML_GPU_LAYER_SEPARATE, // matrixMultiply, matrixAddRowBroadcast (matrixAddRow if loadedKernelsOnly), then the activation
+    CML_GPU_LAYER_TILED,    // matrixMultiplyTiled adding the biases, then the activation
+    CML_GPU_LAYER_DENSE     // one matrixDense launch with the activation built in
+};
+
+// A model whose weights and biases stay in device buffers. cml_bindModelGPU uploads them once,
+// after that a predict only writes the input and reads the output, where cml_predictGPU sends
+// every weight matrix again on every call.
+// Every layer runs on the device, multiply, bias and activation kernels are enqueued back to back
+// and only the last layer is read back.
+// The bound model is a snapshot, later changes to the model (e.g. cml_applyModelPatch) need a new bind.
+typedef struct {
+    cml_GPU* gpu;
+    uint64* layerSizes;
+    size_t layerCount;
+    size_t scale; // rows per predict, same as the model's
+    enum cml_ActivationID* activationIDs; // count = layerCount - 1
+    cl_mem* weights;           // count = layerCount - 1
+    cl_mem* biases;            // count = layerCount - 1
+    cl_mem* activationInputs;  // count = layerCount, the first one holds the input
+    cl_mem* activationOutputs; // count = layerCount - 1, the activation input itself where the activation runs in place
+    // one instance per layer with its buffers set as arguments at bind time
+    enum cml_GPULayerKernels* layerKernels; // picked by the tuning profile or layer shape at bind time
+    size_t* localSizes; // two per layer, the work-group size of dense layers, 0 leaves it to the driver
+    cl_kernel* multiplyKernels;   // the dense kernel for dense layers
+    cl_kernel* addRowKernels;     // NULL unless the layer is separate
+    cl_kernel* activationKernels; // NULL for linear layers and dense relu layers
+    cml_Mutex* lock; // held by predict, predicts share the activation buffers
+    cml_GPUBufferPool* pool; // the buffers came from, NULL if they were created for the model
+    bool sharesWeights; // a copy, the weights and biases belong to the model it was copied from
+    bool loadedKernelsOnly; // bound with that option, add row kernels run one work-item per row
+} cml_GPUModel;
+
+// Choices for binding a model
+typedef struct {
+    const cml_GPUProfile* profile; // kernels and work-group sizes for the layer shapes it has, see GPUTuning.h
+    cml_GPUBufferPool* pool; // device buffers are acquired from it and released back on unbind, it has to outlive the bound model
+    // every layer separate with the matrixMultiply, matrixAddRow and matrixRelu of the programs gpu has loaded,
+    // as cml_simpleSetupGPU loads them, so the bind builds no builtin program. The profile is not used then
+    bool loadedKernelsOnly;
+} cml_GPUBindOptions;
+
+// gpu has to outlive the bound model. CML_LINEAR and CML_RELU layers run builtin kernels, CML_CUSTOM layers the
+// kernel their metadata names, taken from gpuProgramFilename (an embedded program or a path) only. That program
+// is built once per context of gpu, cml_releaseGPUPrograms releases it (see cml_createGPUKernelFromProgram).
+// A custom kernel takes the activation input and a separate output buffer, one work-item per element like matrixRelu:
+// __kernel void name(__global const float* in, __global float* out)
+// A lazily verified model is checked first.
+// Returns a bound model with weights == NULL if the model is corrupt or a buffer or kernel can't be created
+cml_GPUModel cml_bindModelGPU(const cml_Model model, cml_GPU* gpu);
+// Same as cml_bindModelGPU with the kernels and work-group sizes of profile for the layer shapes it has,
+// see GPUTuning.h. profile may be NULL and is not used after the bind. A tiled tuning for columns that aren't a
+// multiple of CML_MULTIPLY_TILE_WIDTH is not followed, the layer gets the dense kernel instead.
+cml_GPUModel cml_bindTunedModelGPU(const cml_Model model, cml_GPU* gpu, const cml_GPUProfile* profile);
+// No profile, no pool and any program, what cml_bindModelGPU uses
+cml_GPUBindOptions cml_createGPUBindOptions();
+cml_GPUModel cml_bindModelGPUWithOptions(const cml_Model model, cml_GPU* gpu, const cml_GPUBindOptions options);
+// Another bound model sharing the weights and biases of boundModel on the same gpu, with activation
+// buffers and kernels of its own so both can predict at the same time. Its activation buffers come from the
+// same pool. Either can be unbound first without a pool, with one boundModel has to be unbound last since its
+// weights go back to the pool.
+// Returns a bound model with weights == NULL if a buffer or kernel can't be created
+cml_GPUModel cml_copyBoundModelGPU(const cml_GPUModel boundModel);
+// Does nothing for a bound model with weights == NULL, as a failed bind returns
+void cml_unbindModelGPU(cml_GPUModel* boundModel);
+
+// Same input and output layout as cml_predictCPU: model.scale rows of layerSizes[0] in and of the last layer size out
+// Returns false if an OpenCL call fails, out is not filled in that case
+bool cml_predictBoundModelGPU(const cml_GPUModel boundModel, const float* in, float* out);
+// Same as cml_predictBoundModelGPU without waiting, every command goes on commands (a queue of boundModel.gpu's
+// context) and outputRead is signaled once out is filled. in and out stay in use and the caller can't predict
+// with boundModel again until then, lock is not taken. outputRead is to release with clReleaseEvent.
+// Returns false if an OpenCL call fails, outputRead is NULL and nothing is left running in that case
+bool cml_enqueuePredictBoundModelGPU(const cml_GPUModel boundModel, cl_command_queue commands, const float* in, float* out,
+                                     cl_event* outputRead);
+
+#endif // CML_GPU_MODEL_H
@@ -0,0 +1,21 @@
+#ifndef CML_GPU_PROGRAM_CACHE_H
+#define CML_GPU_PROGRAM_CACHE_H
+
+#include <cml/device/GPU.h>
+
+#include <stddef.h>
+
+// Directory holding compiled program binaries, it has to exist. NULL, the default, builds every program from source.
+// A cached binary is keyed by device name, device and driver version, build options and a checksum of
+// the source, any change builds from source again and replaces the cached binary.
+extern const char* cml_gpuProgramCacheDirectory;
+
+// Builds source for the device of gpu, from the cached binary when there is a matching one.
+// The program is not added to gpu->programMap.
+// options may be NULL. Returns NULL if the program doesn't build
+cl_program cml_buildGPUProgram(cml_GPU* gpu, const char* source, const size_t size, const char* options);
+// The file the binary of source is cached in, to free after use. NULL when there is no cache or
+// the device can't be identified
+char* cml_getGPUProgramCachePath(cml_GPU* gpu, const char* source, const size_t size, const char* options);
+
+#endif // CML_GPU_PROGRAM_CACHE_H
@@ -0,0 +1,50 @@
+#ifndef CML_GPU_STREAM_H
+#define CML_GPU_STREAM_H
+
+#include <cml/GPUModel.h>
+#include <cml/device/GPU.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Slots of cml_createGPUStream when not asked for more, one uploading while the other computes
+#define CML_GPU_STREAM_DEFAULT_SLOTS 2
+
+// One batch in flight: a copy of the bound model on a queue of its own and the pinned host memory
+// its transfers go through
+typedef struct {
+    cml_GPUModel model; // shares the weights of the stream's bound model
+    cl_command_queue commands;
+    cl_mem pinnedInput;  // CL_MEM_ALLOC_HOST_PTR, mapped for the lifetime of the slot
+    cl_mem pinnedOutput;
+    float* input;  // model.scale rows of the first layer, pinnedInput mapped
+    float* output; // model.scale rows of the last layer, pinnedOutput mapped
+    cl_event outputRead; // NULL while the slot is free
+    size_t firstRow; // of the batch in the slot, counted in the rows of the predict
+    size_t rowCount;
+} cml_GPUStreamSlot;
+
+// Scores many batches with transfers overlapping compute. A cml_predictBoundModelGPU call uploads,
+// computes and downloads in sequence on gpu->commands, leaving the bus idle while the kernels run and
+// the kernels idle during transfers. A stream rotates the batches through its slots, each with an
+// in-order queue of its own, so the upload of batch k + 1 and the download of batch k - 1 can run
+// while batch k computes, and the host copies rows in and out of pinned memory for the next batches
+// in the meantime.
+// Not safe to use from several threads at once.
+typedef struct {
+    cml_GPU* gpu;
+    cml_GPUStreamSlot* slots;
+    size_t slotCount;
+} cml_GPUStream;
+
+// boundModel has to outlive the stream, it is not used for predicts itself. slotCount is at least 2.
+// Returns a stream with slots == NULL if a queue, buffer or kernel can't be created
+cml_GPUStream cml_createGPUStream(const cml_GPUModel boundModel, const size_t slotCount);
+void cml_deleteGPUStream(cml_GPUStream* stream);
+
+// Same layout as cml_predictCPU for any number of rows: rowCount rows of the first layer size in and of the
+// last layer size out. Rows are scored model.scale at a time, the last batch padded with zeros.
+// Returns false if an OpenCL call fails, out may be partly filled in that case
+bool cml_predictStreamGPU(cml_GPUStream* stream, const float* in, float* out, const size_t rowCount);
+
+#endif // CML_GPU_STREAM_H
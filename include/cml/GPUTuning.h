@@ -0,0 +1,53 @@
+#ifndef CML_GPU_TUNING_H
+#define CML_GPU_TUNING_H
+
+#include <cml/Model.h>
+#include <cml/device/GPU.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Fastest way found to run one layer shape, [rows x sharedDimension] * [sharedDimension x columns]
+typedef struct {
+    uint64 rows;
+    uint64 sharedDimension;
+    uint64 columns;
+    bool tiled; // matrixMultiplyTiled, otherwise matrixDense with localSize
+    size_t localSize[2]; // of matrixDense, {0, 0} leaves it to the driver
+} cml_GPUTuning;
+
+// The tunings of one device
+typedef struct {
+    char* deviceName;
+    cml_GPUTuning* tunings;
+    size_t tuningCount;
+} cml_GPUProfile;
+
+// A profile file holds the tunings of any number of devices, one line per layer shape:
+// <device name>\t<rows> <shared dimension> <columns> <tiled|dense> <local size 0> <local size 1>
+// Lines of other devices are kept when saving.
+
+// An empty profile for the device of gpu, deviceName == NULL if the device has no name
+cml_GPUProfile cml_createGPUProfile(cml_GPU* gpu);
+// Only the lines of gpu's device are read. A missing file gives an empty profile.
+// Returns a profile with deviceName == NULL if the device has no name or the file is malformed
+cml_GPUProfile cml_loadGPUProfile(const char* filename, cml_GPU* gpu);
+// Replaces the lines of profile.deviceName, written to a temporary file and renamed over filename
+bool cml_saveGPUProfile(const char* filename, const cml_GPUProfile profile);
+void cml_deleteGPUProfile(cml_GPUProfile* profile);
+
+// Returns NULL if the profile has no tuning for the shape
+const cml_GPUTuning* cml_findGPUTuning(const cml_GPUProfile profile, const uint64 rows, const uint64 sharedDimension, const uint64 columns);
+// Replaces the tuning of the same shape if there is one
+void cml_addGPUTuning(cml_GPUProfile* profile, const cml_GPUTuning tuning);
+
+// Times every work-group size of matrixDense the device allows and matrixMultiplyTiled if it can run,
+// repetitions launches each on zeroed buffers, on a profiling queue of its own.
+// Returns a tuning with rows == 0 if nothing could be timed
+cml_GPUTuning cml_tuneGPULayer(cml_GPU* gpu, const uint64 rows, const uint64 sharedDimension, const uint64 columns, const size_t repetitions);
+// Tunes every layer shape of model at model.scale rows that the profile doesn't have yet
+// Returns false if a layer could not be tuned
+bool cml_tuneModelGPU(cml_GPUProfile* profile, cml_GPU* gpu, const cml_Model model, const size_t repetitions);
+
+#endif // CML_GPU_TUNING_H
@@ -0,0 +1,41 @@
+#ifndef CML_HYBRID_PREDICTOR_H
+#define CML_HYBRID_PREDICTOR_H
+
+#include <cml/GPUModel.h>
+#include <cml/GPUStream.h>
+#include <cml/Model.h>
+#include <cml/util/Thread.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Scores large batches on the CPU and the device at once. Each predict gives the device the first rows
+// and the CPU the rest, in proportion to how fast each side went on the previous predicts, so both
+// finish together instead of one side idling. The device side runs through a cml_GPUStream, the CPU side
+// through cml_predictCPU model.scale rows at a time, each on a thread of its own.
+// Not safe to use from several threads at once.
+typedef struct {
+    cml_Model model; // the caller's, used by the CPU side
+    cml_GPUStream stream;
+    cml_ThreadPool* threads; // one per side
+    float* cpuInput;  // a batch of model.scale rows for the CPU side
+    float* cpuOutput;
+    // seconds per row of each side, smoothed with cml_updateSecondsPerRow, 0 until the side ran once
+    double cpuSecondsPerRow;
+    double gpuSecondsPerRow;
+} cml_HybridPredictor;
+
+// boundModel is a bind of model (see cml_bindModelGPU), both have to outlive the predictor.
+// Returns a predictor with threads == NULL if the stream can't be created
+cml_HybridPredictor cml_createHybridPredictor(const cml_Model model, const cml_GPUModel boundModel);
+void cml_deleteHybridPredictor(cml_HybridPredictor* predictor);
+
+// Same layout as cml_predictCPU for any number of rows: rowCount rows of the first layer size in and of the
+// last layer size out. Both sides are timed to update the split of the next predict.
+// Returns false if the device fails, out is only partly filled in that case
+bool cml_predictHybrid(cml_HybridPredictor* predictor, const float* in, float* out, const size_t rowCount);
+// Rows of rowCount the device gets on the next predict, a multiple of model.scale unless it gets them all.
+// Half of them until both sides have been timed.
+size_t cml_getHybridGPURows(const cml_HybridPredictor predictor, const size_t rowCount);
+
+#endif // CML_HYBRID_PREDICTOR_H
@@ -0,0 +1,25 @@
+#ifndef CML_KERNEL_SOURCES_H
+#define CML_KERNEL_SOURCES_H
+
+#include <stddef.h>
+
+// OpenCL programs compiled into the library. The makefile generates them from the .cl files in the
+// repository root with scripts/embed_kernels.c, so the library does not depend on the working directory.
+typedef struct {
+    const char* filename; // without directory, e.g. "matrix_multiply.cl"
+    const char* source;   // null-terminated
+    size_t size;          // without the terminator
+} cml_KernelSource;
+
+extern const cml_KernelSource cml_kernelSources[];
+extern const size_t cml_kernelSourceCount;
+
+// Directory to read the library's programs from instead of the embedded copies, to work on the kernels
+// without rebuilding. NULL, the default, uses the embedded copies.
+extern const char* cml_kernelSourceDirectory;
+
+// programFilename should be a null-terminated string
+// Returns NULL if no embedded program has that filename
+const cml_KernelSource* cml_findKernelSource(const char* programFilename);
+
+#endif // CML_KERNEL_SOURCES_H
@@ -4,21 +4,46 @@
 #include <cml/matrix/Matrix.h>
 #include <cml/util/String.h>
 #include <cml/util/ActivationFnMetadata.h>
+#include <cml/util/MappedFile.h>
+#include <cml/util/Thread.h>
 #include <cml/device/GPU.h>
 #include <intdefs.h>
 
+#include <stdbool.h>
 #include <stddef.h>
 
 // Assumption: system serializing has equal sizeof(float) as system deserializing
 
+// Checksum of a section the model uses in place, defined in Model.c
+typedef struct cml_ModelIntegrity cml_ModelIntegrity;
+
 typedef struct {
     float* data;
     uint64* layerSizes;
     size_t layerCount;
     size_t scale;
     cml_ActivationFnMetadata* activationFunctions; // array, count = layerCount - 1
+    cml_MappedFile mapping; // size is 0 unless data points into a mapped model file
+    cml_ModelIntegrity* integrity; // NULL unless checking the checksum was deferred, see cml_verifyModel
+    cml_Mutex* lock; // held by predict and cml_applyModelPatch, predicts share the activations in data
 } cml_Model;
 
+// When cml_mapModelWithVerification checks the checksums of version 2 files.
+// Sections that are copied or decoded are always checked, their bytes get read anyway.
+enum cml_ModelVerification {
+    CML_VERIFY_EAGER = 0, // at load time, what cml_mapModel does
+    CML_VERIFY_LAZY = 1,  // the data section, if used in place, on its first use or cml_verifyModel
+    CML_VERIFY_NONE = 2
+};
+
+// Choices for the version 2 format, encodings are cml_ModelSectionEncoding values (see ModelFormat.h)
+typedef struct {
+    bool weightsOnly;       // leave the activations out, see cml_serializeModelWeights
+    uint32 dataEncoding;    // data section, unless weightsOnly
+    uint32 weightsEncoding; // weight sections, when weightsOnly
+    uint32 biasesEncoding;  // bias sections, when weightsOnly
+} cml_ModelSerializeOptions;
+
 typedef struct {
     cml_Matrix* activationInputs;
     cml_Matrix* activationOutputs;
@@ -31,13 +56,73 @@ cml_Model cml_createModel(const size_t numOfLayers, const uint64* layerSizes, co
 // Scales the layers by the scale, weight matrices remain the same size
 // ActivationFnMetadata array uses original data
 cml_Model cml_createScaledModel(const size_t numOfLayers, const uint64* layerSizes, const size_t scale, const cml_ActivationFnMetadata* activationFunctions);
+// The model failed loads return, data == NULL and no layers. Not for cml_deleteModel, it owns nothing
+cml_Model cml_createEmptyModel();
 // Does not delete activationFunctions
 void cml_deleteModel(cml_Model* model);
+// Bytes in model.data: activations of every layer (scaled) plus weights and biases
+size_t cml_getModelDataSize(const cml_Model model);
+// Copies weights and biases into a model of a different scale, activations start out zeroed
+cml_Model cml_copyModelWithScale(const cml_Model model, const size_t scale);
 
+// Serializes to the version 2 format, see ModelFormat.h
 cml_String cml_serializeModel(const cml_Model model);
+// Only stores weights and biases, activations are transient and left out.
+// The scale of the model is kept as the default for loading.
+cml_String cml_serializeModelWeights(const cml_Model model);
+// Raw sections holding the whole data block, what cml_serializeModel uses
+cml_ModelSerializeOptions cml_createModelSerializeOptions();
+cml_String cml_serializeModelWithOptions(const cml_Model model, const cml_ModelSerializeOptions options);
+// Reads both the version 1 and version 2 formats, encoded sections are decoded
+// Returns a model with data == NULL if the header is malformed or a section does not decode
+// or does not match its checksum
 cml_Model cml_deserializeModel(const char* serializedModel);
+// Same as cml_deserializeModel for a buffer of known size, a header claiming more is rejected
+cml_Model cml_deserializeModelFromBuffer(const char* serializedModel, const size_t size);
+// Same as cml_deserializeModel but the loaded model gets the given scale (batch capacity)
+// instead of the one it was serialized with
+cml_Model cml_deserializeScaledModel(const char* serializedModel, const size_t scale);
+// Maps a serialized model file and points data straight into the mapping instead of copying it.
+// Weights and biases are only read so they stay shared with the page cache and every other process
+// mapping the same file, activation pages are privately copied the first time predict writes them.
+// Falls back to copying out of the mapping when the data block is not float aligned in the file,
+// for weights only files (cml_serializeModelWeights), which have no activations to map, and for
+// encoded sections, which are decoded out of the mapping.
+// filename should be a null-terminated string
+// Returns a model with data == NULL if the file could not be mapped, is truncated or corrupt
+cml_Model cml_mapModel(const char* filename);
+// verification is a cml_ModelVerification value. With CML_VERIFY_LAZY large models map without reading
+// the data section up front. When it is used in place its whole checksum is computed in one pass on the first
+// predict, bind, patch, cml_loadModelNpz or cml_verifyModel, every other section is still checked at load time.
+cml_Model cml_mapModelWithVerification(const char* filename, const uint32 verification);
+// Checks a deferred checksum once and remembers the result, true if there is none.
+// Predicting with a model that fails the check fills out with NaN.
+bool cml_verifyModel(const cml_Model model);
+// What cml_mapModelWithVerification does once the file is mapped, for mappings made elsewhere.
+// The model takes file over when it uses it in place, file is emptied then,
+// otherwise the caller still has to unmap it.
+cml_Model cml_createModelFromMapping(cml_MappedFile* file, const uint32 verification);
+// Size of the pieces raw sections are split into by the parallel loader
+#define CML_MODEL_LOAD_CHUNK_SIZE 0x40000
+// Same as cml_deserializeModelFromBuffer with the copying, decoding and checksums of the sections
+// spread over the threads of pool. Each thread is the first to write the pages it loads, so on NUMA
+// systems they end up on the node of the core that loaded them. Version 1 models load on the caller.
+cml_Model cml_deserializeModelParallel(const char* serializedModel, const size_t size, cml_ThreadPool* pool);
+// Maps the file and loads it with cml_deserializeModelParallel, so reading the file is spread over
+// the threads as well. The model gets its own memory and does not keep the mapping.
+cml_Model cml_loadModelParallel(const char* filename, cml_ThreadPool* pool);
+// Rewrites a model file of any supported version in the current format
+// filenames should be null-terminated strings, they may name the same file. The new file is written
+// to outputFilename with ".tmp" appended and renamed over it, outputFilename stays as it was if that fails
+bool cml_upgradeModelFile(const char* inputFilename, const char* outputFilename);
 
 void cml_predictCPU(const cml_Model model, float* in, float* out);
+// Binds the model for this call only (see cml_bindModelGPU), the whole layer chain runs on the device
+// and only the output is read back, but the weights are uploaded every time.
+// gpu is not changed, the layers run the matrixMultiply, matrixAddRow and matrixRelu of the programs it has
+// loaded, as cml_simpleSetupGPU loads them, so no call builds a builtin program. Custom activations are built
+// on the first call for gpu's context, see cml_releaseGPUPrograms.
+// out is NaN if the model is corrupt, has no device activation, gpu lacks one of the kernels or the device fails
 void cml_predictGPU(const cml_Model model, float* in, float* out, const cml_GPU gpu);
 
 // cml_ModelMatrices is heap allocated and needs to be deleted after use
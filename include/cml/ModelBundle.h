@@ -0,0 +1,63 @@
+#ifndef CML_MODEL_BUNDLE_H
+#define CML_MODEL_BUNDLE_H
+
+#include <cml/Model.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Many serialized models packed into one file behind a name index, so a service
+// opens a single file and loads or maps only the models it needs.
+// Every integer is a fixed width little-endian field.
+//
+// bytes: [8][4][4][8][8][index][padding]
+// map  : [magic "CMLBUNDL"][version][flags][headerSize][modelCount][index][zeros up to headerSize]
+// followed by the models in the version 2 format (see ModelFormat.h), each starting at a multiple
+// of CML_MODEL_SECTION_ALIGNMENT so their sections stay aligned within the bundle.
+//
+// Index entry, sorted by name:
+// bytes: [8][nameSize][8][8]
+// map  : [nameSize][name][offset][size]
+
+#define CML_BUNDLE_MAGIC "CMLBUNDL"
+#define CML_BUNDLE_MAGIC_SIZE 8
+#define CML_BUNDLE_FORMAT_VERSION 1
+#define CML_BUNDLE_HEADER_PREFIX_SIZE 32
+
+typedef struct {
+    char* name;    // null-terminated
+    uint64 offset; // from the start of the bundle file
+    uint64 size;
+} cml_ModelBundleEntry;
+
+// Index of an opened bundle, the models themselves are only read when loaded
+typedef struct {
+    char* filename;
+    cml_ModelBundleEntry* entries; // sorted by name
+    size_t entryCount;
+} cml_ModelBundle;
+
+// names are null-terminated and unique, names[i] is stored for models[i]
+// Returns false if a name is repeated or a write fails, the file is incomplete in that case
+bool cml_writeModelBundle(const char* filename, const char* const* names, const cml_Model* models, const size_t count);
+
+// Only reads the index
+// Returns a bundle with filename == NULL if the file can't be read or is not a bundle
+cml_ModelBundle cml_openModelBundle(const char* filename);
+void cml_closeModelBundle(cml_ModelBundle* bundle);
+
+// Returns NULL if the bundle has no model of that name
+const cml_ModelBundleEntry* cml_findBundleEntry(const cml_ModelBundle bundle, const char* name);
+// Copies the model out of the bundle, see cml_deserializeModel
+// Returns a model with data == NULL if there is no such model or it is corrupt
+cml_Model cml_loadBundleModel(const cml_ModelBundle bundle, const char* name);
+// Maps only the pages of that model, see cml_mapModelWithVerification
+// Returns a model with data == NULL if there is no such model or it is corrupt
+cml_Model cml_mapBundleModel(const cml_ModelBundle bundle, const char* name, const uint32 verification);
+// Maps every model of the bundle, models[i] is the model of bundle.entries[i].
+// The models are spread over the threads of pool, NULL maps them on the calling thread.
+// Returns false if any model fails, none are left loaded in that case
+bool cml_mapBundleModels(const cml_ModelBundle bundle, const uint32 verification, cml_ThreadPool* pool, cml_Model* models);
+
+#endif // CML_MODEL_BUNDLE_H
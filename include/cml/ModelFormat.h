@@ -0,0 +1,133 @@
+#ifndef CML_MODEL_FORMAT_H
+#define CML_MODEL_FORMAT_H
+
+#include <cml/Model.h>
+#include <cml/util/ActivationFnMetadata.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Version 2 model file format. Every integer is a fixed width little-endian field.
+// Section contents are stored in the host float format, which is assumed to be
+// little-endian IEEE 754 (same assumption as sizeof(float) in Model.h).
+//
+// bytes: [8][4][4][8][8][8][8][8 * layerCount][48 * sectionCount][metadata][padding]
+// map  : [magic "CMLMODEL"][version][flags][headerSize][layerCount][scale][sectionCount]
+//        [layerSizes][section table][activation metadata][zeros up to headerSize]
+// followed by the sections, each starting at a multiple of CML_MODEL_SECTION_ALIGNMENT.
+//
+// Activation metadata, one per layer after the first:
+// bytes: [8][gpuProgramFilename.size][8][gpuKernelName.size][1]
+// map  : [gpuProgramFilename.size][gpuProgramFilename][gpuKernelName.size][gpuKernelName][activationID]
+//
+// Section table entry:
+// bytes: [4][4][8][8][8][8][8]
+// map  : [type][encoding][layer][offset][size][rawSize][checksum]
+//
+// With CML_MODEL_FLAG_CHECKSUMS set, checksum is the CRC32C of the section's stored bytes.
+//
+// The original format (version 1) has no magic, it starts with a single sizeof(size_t) byte:
+// bytes: [1][sizeof(size_t)][sizeof(size_t)][8 * layerCount][metadata][data block]
+// map  : [sizeof(size_t)][layerCount][scale][layerSizes][activation metadata][model.data]
+// with the metadata lengths sizeof(size_t) bytes wide, every integer in the byte order of the writer.
+
+#define CML_MODEL_MAGIC "CMLMODEL"
+#define CML_MODEL_MAGIC_SIZE 8
+#define CML_MODEL_FORMAT_VERSION 2
+// headerSize sits inside this many bytes, read this much first when streaming
+#define CML_MODEL_HEADER_PREFIX_SIZE 48
+#define CML_MODEL_SECTION_ENTRY_SIZE 48
+// Large enough for cache lines and any SIMD load width
+#define CML_MODEL_SECTION_ALIGNMENT 64
+
+// Header flags
+#define CML_MODEL_FLAG_CHECKSUMS 0x1 // every section has a CRC32C checksum
+
+enum cml_ModelSectionType {
+    CML_SECTION_DATA = 1,    // whole model.data block, see cml_getModelDataSize
+    CML_SECTION_WEIGHTS = 2, // weights between layer and layer + 1
+    CML_SECTION_BIASES = 3   // biases of layer + 1
+};
+
+enum cml_ModelSectionEncoding {
+    CML_ENCODING_RAW = 0,
+    CML_ENCODING_SHUFFLE_LZ = 1 // float byte shuffle + LZ77, see util/Compression.h
+};
+
+typedef struct {
+    uint32 type;     // cml_ModelSectionType
+    uint32 encoding; // cml_ModelSectionEncoding
+    uint64 layer;    // layer the section belongs to, 0 for whole model sections
+    uint64 offset;   // from the start of the file
+    uint64 size;     // bytes stored in the file
+    uint64 rawSize;  // bytes once decoded, equal to size for CML_ENCODING_RAW
+    uint64 checksum; // see CML_MODEL_FLAG_CHECKSUMS, 0 when not present
+} cml_ModelSection;
+
+typedef struct {
+    uint32 version;
+    uint32 flags;
+    uint64 headerSize; // bytes before the first section, multiple of CML_MODEL_SECTION_ALIGNMENT
+    uint64 layerCount;
+    uint64 scale;
+    uint64* layerSizes;
+    cml_ActivationFnMetadata* activationFunctions; // count = layerCount - 1
+    uint64 sectionCount;
+    cml_ModelSection* sections;
+} cml_ModelHeader;
+
+// Sections describing a model before layout, sources[i] points at the bytes to store for sections[i],
+// either inside model.data or, for encoded sections, at an encoded copy owned by the list
+typedef struct {
+    cml_ModelSection* sections;
+    const char** sources;
+    char** encoded; // NULL for raw sections
+    size_t count;
+} cml_ModelSectionList;
+
+// Returns CML_MODEL_FORMAT_VERSION for files starting with CML_MODEL_MAGIC, otherwise 1
+uint32 cml_getModelFormatVersion(const char* serializedModel, const size_t size);
+
+// The header borrows layerSizes and activationFunctions from the model and sections from the caller,
+// do not call cml_deleteModelHeader on it. Section offsets are assigned by cml_layoutModelSections.
+// The sections are expected to have checksums, as cml_createModelSectionList gives them.
+cml_ModelHeader cml_createModelHeader(const cml_Model model, cml_ModelSection* sections, const size_t sectionCount);
+// Sets headerSize and gives every section an aligned offset in table order
+// Returns the total size of the file
+size_t cml_layoutModelSections(cml_ModelHeader* header);
+
+cml_ModelSection cml_createRawSection(const uint32 type, const uint64 layer, const size_t size);
+// Either a single CML_SECTION_DATA section or, when options.weightsOnly, 
+// CML_SECTION_WEIGHTS and CML_SECTION_BIASES for each layer after the first.
+// Sections with an encoding other than raw are encoded here, every section gets its checksum.
+cml_ModelSectionList cml_createModelSectionList(const cml_Model model, const cml_ModelSerializeOptions options);
+void cml_deleteModelSectionList(cml_ModelSectionList* sectionList);
+
+// True if the section decodes to expectedRawSize bytes and its stored bytes fit in size bytes of file
+bool cml_isModelSectionUsable(const cml_ModelSection section, const size_t expectedRawSize, const size_t size);
+// stored points at section.size bytes as found in the file
+// Returns false if the header has checksums and the stored bytes don't match it
+bool cml_verifyModelSection(const cml_ModelHeader header, const cml_ModelSection section, const char* stored);
+// stored points at section.size bytes as found in the file, destination gets section.rawSize bytes
+// Returns false if the encoding is unknown or the stored bytes are corrupt
+bool cml_decodeModelSection(const cml_ModelSection section, const char* stored, char* destination);
+
+// Writes header.headerSize bytes, padding included
+void cml_writeModelHeader(const cml_ModelHeader header, char* out);
+// size is the number of readable bytes, which only needs to cover the header itself
+// Returns false if the header is malformed or truncated. Allocates, delete with cml_deleteModelHeader
+bool cml_readModelHeader(const char* serializedModel, const size_t size, cml_ModelHeader* header);
+// A version 1 integer, sizeofSize_t bytes in the byte order of the host that wrote it
+uint64 cml_readModelSizeV1(const char* serializedModel, const size_t sizeofSize_t);
+// Version 1 counterpart of cml_readModelHeader, reads no further than size. headerSize is set to the offset
+// of the data block, which follows the header unaligned, and the header has no sections.
+// Returns false if the header is malformed or truncated. Allocates, delete with cml_deleteModelHeader
+bool cml_readModelHeaderV1(const char* serializedModel, const size_t size, cml_ModelHeader* header);
+// Only for headers filled in by cml_readModelHeader or cml_readModelHeaderV1
+void cml_deleteModelHeader(cml_ModelHeader* header);
+
+// Returns NULL if there is no section of that type for that layer
+const cml_ModelSection* cml_findModelSection(const cml_ModelHeader header, const uint32 type, const uint64 layer);
+
+#endif // CML_MODEL_FORMAT_H
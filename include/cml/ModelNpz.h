@@ -0,0 +1,32 @@
+#ifndef CML_MODEL_NPZ_H
+#define CML_MODEL_NPZ_H
+
+#include <cml/Model.h>
+
+#include <stdbool.h>
+
+// Weights and biases exchanged with NumPy as an .npz archive, e.g. from
+// np.savez("model.npz", weights_0=W0, biases_0=b0, weights_1=W1, biases_1=b1)
+// Member names follow the layer numbering of cml_getModelMatrices: weights_<i>.npy holds a
+// layerSizes[i] x layerSizes[i+1] array, biases_<i>.npy a layerSizes[i+1] array.
+//
+// Members have to be stored, np.savez_compressed archives are rejected since there is no
+// inflate implementation in this library. Zip64 archives are read but never written,
+// cml_saveModelNpz fails for models over 4 GiB.
+
+// filename should be a null-terminated string
+// Reads every weight and bias array straight into model.data, converting float64 and transposing
+// Fortran order arrays (such as PyTorch's weight.T) on the way. Takes model.lock, a lazily
+// verified model is checked first like cml_applyModelPatch.
+// Returns false if a member is missing, has another shape or can't be read, the model may be
+// partially updated when a read fails
+bool cml_loadModelNpz(const cml_Model model, const char* filename);
+// Returns false if a write fails, the file is incomplete in that case
+bool cml_saveModelNpz(const cml_Model model, const char* filename);
+
+// Runs cml_predictCPU over every row of an .npy array of inputs, model.scale rows at a time,
+// and streams the outputs into a new .npy array with one row per input row
+// Returns false if the inputs don't have layerSizes[0] columns or a read or write fails
+bool cml_predictCPUNpy(const cml_Model model, const char* inputsFilename, const char* outputsFilename);
+
+#endif // CML_MODEL_NPZ_H
@@ -0,0 +1,67 @@
+#ifndef CML_MODEL_PATCH_H
+#define CML_MODEL_PATCH_H
+
+#include <cml/Model.h>
+#include <cml/util/String.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Changes to the weights and biases of a model, small enough to ship instead of the whole model.
+// Integers are fixed width little-endian fields, values are floats in the host format
+// (same assumption as ModelFormat.h).
+//
+// bytes: [8][4][4][8][8 * layerCount][8][entries]
+// map  : [magic "CMLPATCH"][version][flags][layerCount][layerSizes][entryCount][entries]
+//
+// Entry, dense entries replace count floats starting at offset,
+// sparse entries replace the floats at each index:
+// bytes: [4][4][8][8][8][4 * count, sparse only][4 * count]
+// map  : [section type][encoding][layer][offset][count][indices][values]
+// section type is CML_SECTION_WEIGHTS or CML_SECTION_BIASES, offsets and indices count floats.
+
+#define CML_PATCH_MAGIC "CMLPATCH"
+#define CML_PATCH_MAGIC_SIZE 8
+#define CML_PATCH_FORMAT_VERSION 1
+
+enum cml_ModelPatchEncoding {
+    CML_PATCH_DENSE = 0,
+    CML_PATCH_SPARSE = 1
+};
+
+typedef struct {
+    uint32 sectionType; // cml_ModelSectionType, weights or biases
+    uint32 encoding;    // cml_ModelPatchEncoding
+    uint64 layer;       // same numbering as cml_getModelMatrices
+    uint64 offset;      // first float replaced by a dense entry, 0 for sparse entries
+    uint64 count;
+    uint32* indices;    // NULL for dense entries
+    float* values;
+} cml_ModelPatchEntry;
+
+typedef struct {
+    uint64 layerCount;
+    uint64* layerSizes; // shape the patch applies to
+    cml_ModelPatchEntry* entries;
+    size_t entryCount;
+} cml_ModelPatch;
+
+// Everything in target's weights and biases that differs from base, bit for bit.
+// Runs of changes become dense entries, scattered changes one sparse entry per matrix.
+// Returns a patch with layerSizes == NULL if the models don't have the same layer sizes
+cml_ModelPatch cml_diffModels(const cml_Model base, const cml_Model target);
+void cml_deleteModelPatch(cml_ModelPatch* patch);
+
+cml_String cml_serializeModelPatch(const cml_ModelPatch patch);
+// size is the number of bytes in serializedPatch
+// Returns a patch with layerSizes == NULL if it is malformed or truncated
+cml_ModelPatch cml_deserializeModelPatch(const char* serializedPatch, const size_t size);
+
+// Updates the weights and biases of a live model in place. Takes model.lock, so a predict
+// running on another thread sees the model either entirely before or entirely after the patch.
+// A lazily verified model is checked first, the patched model is not verified again.
+// Returns false without changing anything if the patch does not fit the model or it is corrupt
+bool cml_applyModelPatch(const cml_Model model, const cml_ModelPatch patch);
+
+#endif // CML_MODEL_PATCH_H
@@ -0,0 +1,53 @@
+#ifndef CML_MODEL_STREAM_H
+#define CML_MODEL_STREAM_H
+
+#include <cml/Model.h>
+#include <cml/ModelFormat.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Streaming counterparts of cml_serializeModel / cml_serializeModelWeights.
+// Only the header is built in memory, its size is computed up front, and the sections
+// are written straight out of model.data. The file descriptor is left open.
+// Returns false if a write fails, the file is incomplete in that case
+bool cml_writeModel(const cml_Model model, const int fd);
+bool cml_writeModelWeights(const cml_Model model, const int fd);
+// Encoded sections are compressed up front and held in memory until written
+bool cml_writeModelWithOptions(const cml_Model model, const cml_ModelSerializeOptions options, const int fd);
+
+// Size of each read once the header is in, sections are read straight into the model
+#define CML_MODEL_READ_CHUNK_SIZE 0x100000
+// Headers larger than this are taken for corrupt ones
+#define CML_MODEL_MAX_HEADER_SIZE (CML_MODEL_READ_CHUNK_SIZE * 64)
+
+// Source of bytes for the streaming loader, e.g. a pipe or a decompression stream.
+// read should fill up to size bytes and return how many it did, 0 on end of stream or error.
+// Short reads are fine, the loader keeps asking.
+typedef struct {
+    size_t (*read)(void* context, char* buffer, size_t size);
+    void* context;
+} cml_ModelReader;
+
+// Streaming counterparts of cml_deserializeModel for the version 2 format.
+// The header is read and the model allocated first, then each section is read in
+// CML_MODEL_READ_CHUNK_SIZE chunks straight into its final place in model.data,
+// so peak memory is the size of the model plus its header. Encoded sections are
+// read whole and decoded, adding the stored size of the largest one.
+// The input is only read forward, sections are expected in file order.
+// Neither the file nor the file descriptor are closed.
+// Every section that is read is checked against its checksum.
+// Returns a model with data == NULL on a malformed, truncated, corrupt or version 1 input
+cml_Model cml_readModel(FILE* file);
+cml_Model cml_readModelFd(const int fd);
+cml_Model cml_readModelFromReader(const cml_ModelReader reader);
+
+// Reads the header and nothing past it, for looking at a model without reading its sections.
+// The input is left at header.headerSize, the start of the section area, or for version 1 files, whose
+// header has no sections, of the data block (see cml_readModelHeaderV1).
+// Returns false on a malformed or truncated input. Delete with cml_deleteModelHeader
+bool cml_readModelHeaderFromReader(const cml_ModelReader reader, cml_ModelHeader* header);
+bool cml_readModelHeaderFromFile(FILE* file, cml_ModelHeader* header);
+
+#endif // CML_MODEL_STREAM_H
@@ -0,0 +1,53 @@
+#ifndef CML_MULTI_GPU_H
+#define CML_MULTI_GPU_H
+
+#include <cml/GPUModel.h>
+#include <cml/GPUStream.h>
+#include <cml/Model.h>
+#include <cml/device/GPU.h>
+#include <cml/util/Thread.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Platforms searched for devices by cml_createMultiGPUExecutor
+#define CML_MULTI_GPU_MAX_PLATFORMS 8
+
+// One device of an executor, with its own context and queue and a replica of the model's weights
+typedef struct {
+    cml_GPU gpu; // set up like cml_setupGPU
+    cml_GPUModel boundModel;
+    cml_GPUStream stream;
+    double secondsPerRow; // see cml_updateSecondsPerRow, 0 until the device ran once
+} cml_MultiGPUDevice;
+
+// Scores large batches on every device at once. Each predict splits the rows in shards of whole batches,
+// in proportion to how fast each device went on the previous predicts so they finish together, runs
+// every shard through the stream of its device on a thread of its own and gathers the results into
+// the caller's output.
+// Not safe to use from several threads at once.
+typedef struct {
+    cml_MultiGPUDevice* devices; // bound models point at their gpu, the array is never moved
+    size_t deviceCount;
+    size_t scale;
+    size_t inputSize;  // columns of a row in and out
+    size_t outputSize;
+    cml_ThreadPool* threads; // one per device
+} cml_MultiGPUExecutor;
+
+// Binds model on up to maxDevices devices of cml_getGPUsWithCUDASupport, model can be deleted afterwards.
+// Devices that fail to set up or bind are left out.
+// Returns an executor with deviceCount == 0 if no device is usable
+cml_MultiGPUExecutor cml_createMultiGPUExecutor(const cml_Model model, const uint8 maxDevices);
+void cml_deleteMultiGPUExecutor(cml_MultiGPUExecutor* executor);
+
+// Same layout as cml_predictCPU for any number of rows: rowCount rows of the first layer size in and of the
+// last layer size out. Every device is timed to update the split of the next predict.
+// Returns false if a device fails, out is only partly filled in that case
+bool cml_predictMultiGPU(cml_MultiGPUExecutor* executor, const float* in, float* out, const size_t rowCount);
+// Rows of rowCount each device gets on the next predict, into rows[deviceCount]. Shards are whole batches
+// of scale rows except for the one holding the last row, devices not timed yet count as the average.
+void cml_getMultiGPUShards(const cml_MultiGPUExecutor executor, const size_t rowCount, size_t* rows);
+
+#endif // CML_MULTI_GPU_H
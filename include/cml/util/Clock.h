@@ -0,0 +1,16 @@
+#ifndef CML_CLOCK_H
+#define CML_CLOCK_H
+
+#include <stddef.h>
+
+// Seconds on a monotonic clock with an arbitrary start, only differences between two calls mean anything
+double cml_getSeconds();
+
+// Weight of the newest measurement in a smoothed per-row time, the rest is the previous estimate
+#define CML_TIMING_SMOOTHING 0.3
+
+// Folds seconds spent on rows rows into *secondsPerRow, which is 0 until the first measurement.
+// Nothing is measured when rows is 0
+void cml_updateSecondsPerRow(double* secondsPerRow, const double seconds, const size_t rows);
+
+#endif // CML_CLOCK_H
@@ -0,0 +1,30 @@
+#ifndef CML_COMPRESSION_H
+#define CML_COMPRESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Lossless compression tuned for arrays of floats, no external dependencies.
+// The bytes of each float are first split into 4 planes (byte shuffle) so the
+// sign/exponent bytes of neighbouring weights end up next to each other, then
+// the shuffled bytes are LZ77 compressed.
+//
+// Compressed stream, repeated until the input ends:
+// bytes: [1][0+][literalCount][2][0+]
+// map  : [token][literal length ext][literals][match offset][match length ext]
+// token is (literal length << 4 | (match length - 4)), a nibble of 15 continues in
+// extension bytes which are added up until one is below 255. The last sequence has
+// no match, the stream ends right after its literals.
+
+// Worst case output size of cml_compressFloats for size input bytes
+size_t cml_getMaxCompressedSize(const size_t size);
+
+// destination must hold cml_getMaxCompressedSize(size) bytes
+// Returns the number of bytes written to destination
+size_t cml_compressFloats(const char* source, const size_t size, char* destination);
+
+// size is the uncompressed size, destination must hold that many bytes
+// Returns false if the compressed stream is corrupt or does not decode to exactly size bytes
+bool cml_decompressFloats(const char* source, const size_t compressedSize, char* destination, const size_t size);
+
+#endif // CML_COMPRESSION_H
@@ -0,0 +1,16 @@
+#ifndef CML_CRC32C_H
+#define CML_CRC32C_H
+
+#include <intdefs.h>
+
+#include <stddef.h>
+
+// CRC32C (Castagnoli), the checksum stored in model file sections.
+// Uses the SSE4.2 crc32 instruction when the CPU has it, a lookup table otherwise.
+// crc is the result of a previous call to continue a checksum over split data, 0 to start
+uint32 cml_crc32c(const uint32 crc, const char* data, const size_t size);
+// Checksum of A followed by B from the checksums of A and B, sizeB is the length of B.
+// Lets pieces of a buffer be checksummed on different threads.
+uint32 cml_crc32cCombine(const uint32 crcA, const uint32 crcB, size_t sizeB);
+
+#endif // CML_CRC32C_H
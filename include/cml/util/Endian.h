@@ -0,0 +1,16 @@
+#ifndef CML_ENDIAN_H
+#define CML_ENDIAN_H
+
+#include <intdefs.h>
+
+// Fixed width little-endian reads and writes, independent of the host byte order.
+// Pointers do not need to be aligned.
+
+void cml_writeUint16LE(char* destination, const uint16 value);
+void cml_writeUint32LE(char* destination, const uint32 value);
+void cml_writeUint64LE(char* destination, const uint64 value);
+uint16 cml_readUint16LE(const char* source);
+uint32 cml_readUint32LE(const char* source);
+uint64 cml_readUint64LE(const char* source);
+
+#endif // CML_ENDIAN_H
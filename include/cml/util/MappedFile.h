@@ -0,0 +1,23 @@
+#ifndef CML_MAPPED_FILE_H
+#define CML_MAPPED_FILE_H
+
+#include <stddef.h>
+
+// Private (copy-on-write) mapping of a whole file. Pages that are only read stay
+// shared with the page cache, pages that are written get copied for this process only
+// and are never written back to the file.
+typedef struct {
+    char* data;
+    size_t size;
+    size_t offset; // bytes mapped in front of data to start on a page boundary, see cml_mapFileRange
+} cml_MappedFile;
+
+// filename should be a null-terminated string
+// Returns a cml_MappedFile with data == NULL if the file could not be mapped
+cml_MappedFile cml_mapFile(const char* filename);
+// Same as cml_mapFile for size bytes starting at offset, which does not need to be page aligned
+// Returns a cml_MappedFile with data == NULL if the range is empty or does not fit in the file
+cml_MappedFile cml_mapFileRange(const char* filename, const size_t offset, const size_t size);
+void cml_unmapFile(cml_MappedFile* file);
+
+#endif // CML_MAPPED_FILE_H
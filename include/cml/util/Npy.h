@@ -0,0 +1,80 @@
+#ifndef CML_NPY_H
+#define CML_NPY_H
+
+#include <cml/matrix/Matrix.h>
+#include <intdefs.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// NumPy .npy arrays of up to 2 dimensions, see numpy.lib.format.
+// bytes: [6][1][1][2 or 4][headerSize][data]
+// map  : [magic "\x93NUMPY"][major][minor][headerSize][header dict][data]
+//
+// float32 arrays in C order are read and written straight between the file and the
+// destination without a copy. Big-endian float32 is swapped in place, float64 is
+// converted through a small buffer and Fortran order arrays are transposed on read.
+
+#define CML_NPY_MAGIC "\x93NUMPY"
+#define CML_NPY_MAGIC_SIZE 6
+// Header written by cml_createNpyWriter, data starts aligned right after it
+#define CML_NPY_WRITE_HEADER_SIZE 128
+
+enum cml_NpyType {
+    CML_NPY_FLOAT32 = 0,
+    CML_NPY_FLOAT64 = 1
+};
+
+// Array opened for reading, file is positioned at the next row
+typedef struct {
+    FILE* file;
+    bool ownsFile;     // opened by cml_openNpy, closed by cml_closeNpy
+    uint32 type;       // cml_NpyType
+    bool bigEndian;
+    bool fortranOrder;
+    size_t rows;       // 1 for one dimensional arrays
+    size_t cols;       // 1 for zero dimensional arrays
+    size_t rowsRead;
+} cml_NpyReader;
+
+// filename should be a null-terminated string
+// Returns a reader with file == NULL if the file can't be opened or is not a supported array
+cml_NpyReader cml_openNpy(const char* filename);
+// Same as cml_openNpy for an array starting at the current position of file, e.g. inside an .npz.
+// The file is left open by cml_closeNpy.
+cml_NpyReader cml_openNpyAt(FILE* file);
+void cml_closeNpy(cml_NpyReader* reader);
+
+// Streams up to rowCount rows of cols floats into destination, for feeding inputs in batches.
+// Not for Fortran order arrays, their rows are not contiguous in the file.
+// Returns the number of rows read, fewer than rowCount at the end of the array or on error
+size_t cml_readNpyRows(cml_NpyReader* reader, float* destination, const size_t rowCount);
+// Reads the whole array into matrix, which must have the same number of rows and cols.
+// A one dimensional array fits a matrix with a single row (biases).
+// Returns false on a shape mismatch or a short read
+bool cml_readNpyMatrix(cml_NpyReader* reader, cml_Matrix matrix);
+
+// Array of float32 rows written as they come in, the shape is filled in by cml_closeNpyWriter
+typedef struct {
+    FILE* file;
+    size_t cols;
+    size_t rows;
+    bool success; // false once a write failed
+} cml_NpyWriter;
+
+// filename should be a null-terminated string
+// Returns a writer with file == NULL if the file can't be created
+cml_NpyWriter cml_createNpyWriter(const char* filename, const size_t cols);
+bool cml_writeNpyRows(cml_NpyWriter* writer, const float* rows, const size_t rowCount);
+// Returns false if any write failed, the file is incomplete in that case
+bool cml_closeNpyWriter(cml_NpyWriter* writer);
+
+// Header of CML_NPY_WRITE_HEADER_SIZE bytes for a C order float32 array in the host byte order,
+// written by cml_createNpyWriter and for .npz members. oneDimensional writes the shape (cols,)
+void cml_writeNpyHeader(char* out, const size_t rows, const size_t cols, const bool oneDimensional);
+// Writes matrix as a two dimensional array, rows of 1 are still written as two dimensions
+bool cml_saveNpyMatrix(const char* filename, const cml_Matrix matrix);
+bool cml_loadNpyMatrix(const char* filename, cml_Matrix matrix);
+
+#endif // CML_NPY_H
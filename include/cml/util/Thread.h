@@ -0,0 +1,32 @@
+#ifndef CML_THREAD_H
+#define CML_THREAD_H
+
+#include <stddef.h>
+
+// Thin wrapper over pthreads and the Windows threading API
+typedef struct cml_Mutex cml_Mutex;
+
+// Heap allocated so structs holding one can still be passed by value
+cml_Mutex* cml_createMutex();
+void cml_deleteMutex(cml_Mutex* mutex);
+void cml_lockMutex(cml_Mutex* mutex);
+void cml_unlockMutex(cml_Mutex* mutex);
+
+// Fixed set of worker threads that run batches of independent tasks
+typedef struct cml_ThreadPool cml_ThreadPool;
+// index is the task number within the batch, in [0, count)
+typedef void (*cml_Task)(void* context, const size_t index);
+
+// Logical processors available to the process
+size_t cml_getProcessorCount();
+// threadCount of 0 uses cml_getProcessorCount, the calling thread works too so one less is started
+cml_ThreadPool* cml_createThreadPool(const size_t threadCount);
+void cml_deleteThreadPool(cml_ThreadPool* pool);
+// Threads working on a batch, the caller included
+size_t cml_getThreadPoolSize(const cml_ThreadPool* pool);
+// Runs task(context, i) for every i in [0, count) and returns once all of them finished.
+// Tasks are handed out one at a time so uneven tasks still balance out.
+// One batch at a time, do not call it from several threads on the same pool.
+void cml_runTasks(cml_ThreadPool* pool, cml_Task task, void* context, const size_t count);
+
+#endif // CML_THREAD_H
@@ -0,0 +1,26 @@
+/* matrix_add_row_broadcast.cl
+ * Matrix + Row: C = A[M x N] + B[1 x N], one work-item per element.
+ * Device code.
+ */
+
+// OpenCL Kernel
+// Launched with M * N / 4 work-items if N is a multiple of 4, each adding a float4, M * N otherwise.
+// The branch is the same for every work-item.
+__kernel void
+matrixAddRowBroadcast(__global const float* matrix,
+                      __global const float* row,
+                      __global float* out,
+                      int columns)
+{
+    int i = get_global_id(0);
+
+    if (columns % 4 == 0)
+    {
+        int column = (i * 4) % columns;
+        vstore4(vload4(i, matrix) + vload4(0, row + column), i, out);
+    }
+    else
+    {
+        out[i] = matrix[i] + row[i % columns];
+    }
+}
@@ -0,0 +1,37 @@
+/* matrix_dense.cl
+ * Dense layer: C = activation(A * B + row), one launch per layer.
+ * Device code.
+ */
+
+#define LINEAR(x) (x)
+#define RELU(x) ((x) > 0 ? (x) : 0)
+
+// One work-item per element of C, launched as {bCols, rows} so neighbouring work-items read
+// neighbouring columns of B. The launch may be rounded up to whole work-groups, the extra
+// work-items do nothing. Every activation gets its own kernel, the epilogue is resolved
+// when the program is built.
+#define DENSE_KERNEL(name, activation)                                   \
+__kernel void                                                            \
+name(__global float* C,                                                  \
+     __global const float* A,                                            \
+     __global const float* B,                                            \
+     __global const float* row,                                          \
+     int rows, int sharedDimension, int bCols)                           \
+{                                                                        \
+    int globalColumn = get_global_id(0);                                 \
+    int globalRow = get_global_id(1);                                    \
+    if (globalColumn >= bCols || globalRow >= rows)                      \
+    {                                                                    \
+        return;                                                          \
+    }                                                                    \
+                                                                         \
+    float value = row[globalColumn];                                     \
+    for (int k = 0; k < sharedDimension; ++k)                            \
+    {                                                                    \
+        value += A[globalRow * sharedDimension + k] * B[k * bCols + globalColumn]; \
+    }                                                                    \
+    C[globalRow * bCols + globalColumn] = activation(value);             \
+}
+
+DENSE_KERNEL(matrixDenseLinear, LINEAR)
+DENSE_KERNEL(matrixDenseRelu, RELU)
@@ -0,0 +1,59 @@
+/* matrix_multiply_tiled.cl
+ * Matrix multiplication: C = A * B, tiled through local memory.
+ * Device code.
+ */
+
+// Must match CML_MULTIPLY_TILE_ROWS and CML_MULTIPLY_TILE_COLUMNS in GPUKernels.h
+#define TILE_ROWS 16
+#define TILE_SHARED 16
+#define TILE_COLUMNS 64
+#define WIDTH 4
+
+// A work-group of TILE_ROWS x TILE_COLUMNS / WIDTH work-items computes a TILE_ROWS x TILE_COLUMNS
+// block of C, every work-item WIDTH adjacent columns of one row. bCols has to be a multiple of WIDTH.
+// If row is not NULL it is added to every row of C before the result is stored, C = A * B + row.
+__kernel __attribute__((reqd_work_group_size(TILE_ROWS, TILE_COLUMNS / WIDTH, 1))) void
+matrixMultiplyTiled(__global float* C,
+                    __global const float* A,
+                    __global const float4* B,
+                    __global const float* row,
+                    int rows, int sharedDimension, int bCols)
+{
+    int localRow = get_local_id(0);
+    int localColumn = get_local_id(1);
+    int globalRow = get_global_id(0);
+    int globalColumn = get_global_id(1) * WIDTH;
+    int vectorColumns = bCols / WIDTH;
+
+    __local float tileA[TILE_ROWS][TILE_SHARED];
+    __local float4 tileB[TILE_SHARED][TILE_COLUMNS / WIDTH];
+
+    float4 value = (float4)(0.0f);
+    for (int tile = 0; tile < sharedDimension; tile += TILE_SHARED)
+    {
+        // every work-item loads one element of A and one float4 of B,
+        // out of range elements are zero so they add nothing
+        int columnA = tile + localColumn;
+        tileA[localRow][localColumn] = globalRow < rows && columnA < sharedDimension
+            ? A[globalRow * sharedDimension + columnA] : 0.0f;
+        int rowB = tile + localRow;
+        tileB[localRow][localColumn] = rowB < sharedDimension && globalColumn < bCols
+            ? B[rowB * vectorColumns + globalColumn / WIDTH] : (float4)(0.0f);
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TILE_SHARED; ++k)
+        {
+            value += tileA[localRow][k] * tileB[k][localColumn];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (globalRow < rows && globalColumn < bCols)
+    {
+        if (row != 0)
+        {
+            value += vload4(0, row + globalColumn);
+        }
+        vstore4(value, 0, C + globalRow * bCols + globalColumn);
+    }
+}
@@ -0,0 +1,84 @@
+// Build step of the makefile: writes a C source defining cml_kernelSources (see include/cml/KernelSources.h)
+// with the contents of every given OpenCL file as a string constant.
+// usage: embed_kernels output.c kernel.cl...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes per line of the generated arrays
+#define EMBED_LINE_LENGTH 16
+
+static const char* getFilename(const char* path) {
+    const char* filename = path;
+    for(const char* c = path; *c != '\0'; c++) {
+        if(*c == '/' || *c == '\\') {
+            filename = c + 1;
+        }
+    }
+    return filename;
+}
+
+// Writes the file as a null-terminated char array named cml_kernelSource<index>
+// Returns the size of the file, -1 if it can't be read
+static long embedFile(FILE* out, const char* path, const int index) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) {
+        return -1;
+    }
+    fprintf(out, "// %s\nstatic const char cml_kernelSource%d[] = {", getFilename(path), index);
+    long size = 0;
+    int c;
+    while((c = fgetc(file)) != EOF) {
+        fprintf(out, "%s0x%02x,", size % EMBED_LINE_LENGTH == 0 ? "\n    " : " ", (unsigned int)c);
+        size++;
+    }
+    fprintf(out, "\n    0x00\n};\n\n");
+    int failed = ferror(file);
+    fclose(file);
+    return failed ? -1 : size;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s output.c kernel.cl...\n", argv[0]);
+        return 1;
+    }
+
+    FILE* out = fopen(argv[1], "wb");
+    if(out == NULL) {
+        fprintf(stderr, "can't write %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(out, "// Generated by scripts/embed_kernels.c, do not edit\n#include <cml/KernelSources.h>\n\n");
+
+    int kernelCount = argc - 2;
+    long* sizes = (long*)malloc(sizeof(long) * (kernelCount + 1));
+    for(int i = 0; i < kernelCount; i++) {
+        sizes[i] = embedFile(out, argv[i+2], i);
+        if(sizes[i] < 0) {
+            fprintf(stderr, "can't read %s\n", argv[i+2]);
+            fclose(out);
+            remove(argv[1]);
+            free(sizes);
+            return 1;
+        }
+    }
+
+    // an empty initializer list is not valid C, the count keeps the placeholder out of reach
+    fprintf(out, "const cml_KernelSource cml_kernelSources[] = {\n");
+    for(int i = 0; i < kernelCount; i++) {
+        fprintf(out, "    {\"%s\", cml_kernelSource%d, %ld},\n", getFilename(argv[i+2]), i, sizes[i]);
+    }
+    if(kernelCount == 0) {
+        fprintf(out, "    {\"\", \"\", 0}\n");
+    }
+    fprintf(out, "};\nconst size_t cml_kernelSourceCount = %d;\n", kernelCount);
+    free(sizes);
+
+    if(fclose(out) != 0) {
+        remove(argv[1]);
+        return 1;
+    }
+    return 0;
+}
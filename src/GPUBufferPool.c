@@ -0,0 +1,168 @@
+#include <cml/GPUBufferPool.h>
+#include <cml/util/Thread.h>
+#include <intdefs.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// CML_GPU_BUFFER_MIN_SIZE, then four classes per power of two up to 2^63
+#define CML_GPU_BUFFER_CLASS_COUNT (1 + 4 * 64)
+
+typedef struct {
+    cl_mem* buffers;
+    size_t count;
+    size_t capacity;
+} cml_PooledBuffers;
+
+struct cml_GPUBufferPool {
+    cl_context context;
+    size_t limit;
+    cml_Mutex* lock;
+    cml_GPUBufferPoolStats stats;
+    cml_PooledBuffers classes[CML_GPU_BUFFER_CLASS_COUNT];
+};
+
+static unsigned int cml_log2(size_t value) {
+    unsigned int result = 0;
+    while(value >>= 1) {
+        result++;
+    }
+    return result;
+}
+
+// Index of the size class of size, which cml_getGPUBufferSizeClass(size) is the size of
+static size_t cml_getSizeClassIndex(const size_t size) {
+    if(size <= CML_GPU_BUFFER_MIN_SIZE) {
+        return 0;
+    }
+    // size is in (2^power, 2^(power + 1)], split in four steps
+    unsigned int power = cml_log2(size - 1);
+    size_t step = (size_t)1 << (power - 2);
+    size_t quarter = (size + step - 1) / step - 4;
+    return (power - cml_log2(CML_GPU_BUFFER_MIN_SIZE)) * 4 + quarter;
+}
+
+size_t cml_getGPUBufferSizeClass(const size_t size) {
+    size_t index = cml_getSizeClassIndex(size);
+    if(index == 0) {
+        return CML_GPU_BUFFER_MIN_SIZE;
+    }
+    unsigned int power = (unsigned int)((index - 1) / 4) + cml_log2(CML_GPU_BUFFER_MIN_SIZE);
+    size_t quarter = (index - 1) % 4 + 1;
+    return (4 + quarter) * ((size_t)1 << (power - 2));
+}
+
+cml_GPUBufferPool* cml_createGPUBufferPool(cml_GPU* gpu, const size_t limit) {
+    assert(gpu != NULL);
+
+    cml_GPUBufferPool* pool = (cml_GPUBufferPool*)calloc(1, sizeof(cml_GPUBufferPool));
+    pool->context = gpu->context;
+    pool->limit = limit;
+    pool->lock = cml_createMutex();
+    return pool;
+}
+
+void cml_deleteGPUBufferPool(cml_GPUBufferPool* pool) {
+    assert(pool != NULL);
+
+    cml_trimGPUBufferPool(pool);
+    for(size_t i = 0; i < CML_GPU_BUFFER_CLASS_COUNT; i++) {
+        free(pool->classes[i].buffers);
+    }
+    cml_deleteMutex(pool->lock);
+    free(pool);
+}
+
+cl_mem cml_acquireGPUBuffer(cml_GPUBufferPool* pool, const size_t size) {
+    assert(pool != NULL);
+    assert(size <= ((size_t)1 << 62));
+
+    size_t index = cml_getSizeClassIndex(size);
+    size_t classSize = cml_getGPUBufferSizeClass(size);
+    cl_mem buffer = NULL;
+    cml_lockMutex(pool->lock);
+    pool->stats.requests++;
+    cml_PooledBuffers* pooled = &pool->classes[index];
+    if(pooled->count > 0) {
+        buffer = pooled->buffers[--pooled->count];
+        pool->stats.hits++;
+        pool->stats.bytesPooled -= classSize;
+        pool->stats.bytesInUse += classSize;
+    }
+    cml_unlockMutex(pool->lock);
+    if(buffer != NULL) {
+        return buffer;
+    }
+
+    // created outside of the lock, the driver may take a while
+    cl_int error;
+    buffer = clCreateBuffer(pool->context, CL_MEM_READ_WRITE, classSize, NULL, &error);
+    if(error != CL_SUCCESS) {
+        return NULL;
+    }
+    cml_lockMutex(pool->lock);
+    pool->stats.bytesInUse += classSize;
+    if(pool->stats.bytesInUse + pool->stats.bytesPooled > pool->stats.peakBytes) {
+        pool->stats.peakBytes = pool->stats.bytesInUse + pool->stats.bytesPooled;
+    }
+    cml_unlockMutex(pool->lock);
+    return buffer;
+}
+
+void cml_releaseGPUBuffer(cml_GPUBufferPool* pool, cl_mem buffer) {
+    assert(pool != NULL);
+    assert(buffer != NULL);
+
+    size_t size;
+    if(clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(size), &size, NULL) != CL_SUCCESS) {
+        clReleaseMemObject(buffer);
+        return;
+    }
+    size_t index = cml_getSizeClassIndex(size);
+    assert(cml_getGPUBufferSizeClass(size) == size);
+
+    cml_lockMutex(pool->lock);
+    pool->stats.bytesInUse -= size;
+    bool keep = pool->limit == 0 || pool->stats.bytesPooled + size <= pool->limit;
+    if(keep) {
+        cml_PooledBuffers* pooled = &pool->classes[index];
+        if(pooled->count == pooled->capacity) {
+            pooled->capacity = pooled->capacity == 0 ? 4 : pooled->capacity * 2;
+            pooled->buffers = (cl_mem*)realloc(pooled->buffers, sizeof(cl_mem) * pooled->capacity);
+        }
+        pooled->buffers[pooled->count++] = buffer;
+        pool->stats.bytesPooled += size;
+    }
+    cml_unlockMutex(pool->lock);
+    if(!keep) {
+        clReleaseMemObject(buffer);
+    }
+}
+
+size_t cml_trimGPUBufferPool(cml_GPUBufferPool* pool) {
+    assert(pool != NULL);
+
+    cml_lockMutex(pool->lock);
+    size_t freed = (size_t)pool->stats.bytesPooled;
+    for(size_t i = 0; i < CML_GPU_BUFFER_CLASS_COUNT; i++) {
+        cml_PooledBuffers* pooled = &pool->classes[i];
+        for(size_t j = 0; j < pooled->count; j++) {
+            clReleaseMemObject(pooled->buffers[j]);
+        }
+        pooled->count = 0;
+    }
+    pool->stats.bytesPooled = 0;
+    cml_unlockMutex(pool->lock);
+    return freed;
+}
+
+cml_GPUBufferPoolStats cml_getGPUBufferPoolStats(cml_GPUBufferPool* pool) {
+    assert(pool != NULL);
+
+    cml_lockMutex(pool->lock);
+    cml_GPUBufferPoolStats stats = pool->stats;
+    cml_unlockMutex(pool->lock);
+    return stats;
+}
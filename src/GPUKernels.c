@@ -0,0 +1,248 @@
+#include <cml/GPUKernels.h>
+#include <cml/GPUProgramCache.h>
+#include <cml/KernelSources.h>
+#include <cml/util/DynamicArray.h>
+#include <cml/util/Kernel.h>
+#include <cml/util/MappedFile.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A program cml_createGPUKernelFromProgram built, the table holds one reference to it
+typedef struct {
+    cl_context context;
+    char* programFilename;
+    cl_program program;
+} cml_ContextProgram;
+
+static cml_ContextProgram* cml_contextPrograms = NULL;
+static size_t cml_contextProgramCount = 0;
+
+// Returns NULL if the context has no program of that filename yet
+static cl_program cml_findContextProgram(cl_context context, const char* programFilename) {
+    for(size_t i = 0; i < cml_contextProgramCount; i++) {
+        if(cml_contextPrograms[i].context == context && strcmp(cml_contextPrograms[i].programFilename, programFilename) == 0) {
+            return cml_contextPrograms[i].program;
+        }
+    }
+    return NULL;
+}
+
+static void cml_addContextProgram(cl_context context, const char* programFilename, cl_program program) {
+    cml_contextPrograms = (cml_ContextProgram*)realloc(cml_contextPrograms, sizeof(cml_ContextProgram) * (cml_contextProgramCount + 1));
+    cml_ContextProgram* entry = &cml_contextPrograms[cml_contextProgramCount++];
+    entry->context = context;
+    entry->programFilename = (char*)malloc(strlen(programFilename) + 1);
+    strcpy(entry->programFilename, programFilename);
+    entry->program = program;
+}
+
+// Returns NULL if gpu->kernelMap has no kernel of that name
+static cl_kernel cml_findGPUKernel(cml_GPU* gpu, const char* kernelName) {
+    for(size_t i = 0; i < gpu->kernelMap.size; i++) {
+        cml_KernelMapEntry* entry = (cml_KernelMapEntry*)cml_dynamicArrayGet(&gpu->kernelMap, i);
+        if(entry->kernalName != NULL && strcmp(entry->kernalName, kernelName) == 0) {
+            return entry->kernel;
+        }
+    }
+    return NULL;
+}
+
+// Builds the embedded copy of the program, or the file from cml_kernelSourceDirectory when that is set.
+// Programs that aren't embedded are read from programFilename as it is.
+static cl_program cml_buildGPUProgramFile(cml_GPU* gpu, const char* programFilename) {
+    const cml_KernelSource* embedded = cml_findKernelSource(programFilename);
+    if(embedded != NULL && cml_kernelSourceDirectory == NULL) {
+        return cml_buildGPUProgram(gpu, embedded->source, embedded->size, NULL);
+    }
+
+    char* path = NULL;
+    if(embedded != NULL) {
+        size_t pathSize = strlen(cml_kernelSourceDirectory) + strlen(programFilename) + 2;
+        path = (char*)malloc(pathSize);
+        snprintf(path, pathSize, "%s/%s", cml_kernelSourceDirectory, programFilename);
+    }
+    cml_MappedFile file = cml_mapFile(path != NULL ? path : programFilename);
+    free(path);
+    if(file.data == NULL) {
+        return NULL;
+    }
+    cl_program program = cml_buildGPUProgram(gpu, file.data, file.size, NULL);
+    cml_unmapFile(&file);
+    return program;
+}
+
+// Builds the program through the program cache into gpu->programMap
+// Returns NULL if the program can't be read or built
+static cl_program cml_loadGPUProgramFile(cml_GPU* gpu, const char* programFilename) {
+    cl_program loadedProgram = cml_buildGPUProgramFile(gpu, programFilename);
+    if(loadedProgram != NULL) {
+        // gpu->programMap owns the program, cml_deleteGPU releases it
+        cml_dynamicArrayPush(&gpu->programMap, &loadedProgram);
+    }
+    return loadedProgram;
+}
+
+// Loads the program and adds its kernel to gpu->kernelMap, kernelName has to outlive gpu
+// Returns false if the program can't be read or built
+static bool cml_loadGPUKernel(cml_GPU* gpu, const char* programFilename, const char* kernelName) {
+    cl_program loadedProgram = cml_loadGPUProgramFile(gpu, programFilename);
+    if(loadedProgram == NULL) {
+        return false;
+    }
+    cml_createGPUKernel(gpu, cml_createKernel(kernelName, loadedProgram));
+    return true;
+}
+
+// Creates the kernel from the first loaded program that has it, NULL if none does
+static cl_kernel cml_createKernelFromLoadedPrograms(cml_GPU* gpu, const char* kernelName) {
+    for(size_t i = 0; i < gpu->programMap.size; i++) {
+        cl_program program = *(cl_program*)cml_dynamicArrayGet(&gpu->programMap, i);
+        cl_int error;
+        cl_kernel instance = clCreateKernel(program, kernelName, &error);
+        if(error == CL_SUCCESS) {
+            return instance;
+        }
+    }
+    return NULL;
+}
+
+cl_kernel cml_createLoadedGPUKernelInstance(cml_GPU* gpu, const char* kernelName) {
+    assert(gpu != NULL);
+    assert(kernelName != NULL);
+
+    // kernels of the programs loaded by a setup are found by name, without trying every program
+    cl_kernel kernel = cml_findGPUKernel(gpu, kernelName);
+    if(kernel == NULL) {
+        // another kernel of the program may have loaded it already
+        return cml_createKernelFromLoadedPrograms(gpu, kernelName);
+    }
+    cl_program program;
+    if(clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(program), &program, NULL) != CL_SUCCESS) {
+        return NULL;
+    }
+    cl_int error;
+    cl_kernel instance = clCreateKernel(program, kernelName, &error);
+    return error == CL_SUCCESS ? instance : NULL;
+}
+
+cl_kernel cml_createGPUKernelInstance(cml_GPU* gpu, const char* programFilename, const char* kernelName) {
+    assert(gpu != NULL);
+    assert(programFilename != NULL);
+    assert(kernelName != NULL);
+
+    cl_kernel instance = cml_createLoadedGPUKernelInstance(gpu, kernelName);
+    if(instance == NULL && cml_loadGPUProgramFile(gpu, programFilename) != NULL) {
+        instance = cml_createKernelFromLoadedPrograms(gpu, kernelName);
+    }
+    return instance;
+}
+
+cl_kernel cml_createGPUKernelFromProgram(cml_GPU* gpu, const char* programFilename, const char* kernelName) {
+    assert(gpu != NULL);
+    assert(programFilename != NULL);
+    assert(kernelName != NULL);
+
+    cl_program program = cml_findContextProgram(gpu->context, programFilename);
+    if(program == NULL) {
+        program = cml_buildGPUProgramFile(gpu, programFilename);
+        if(program == NULL) {
+            return NULL;
+        }
+        cml_addContextProgram(gpu->context, programFilename, program);
+    }
+    cl_int error;
+    cl_kernel kernel = clCreateKernel(program, kernelName, &error);
+    return error == CL_SUCCESS ? kernel : NULL;
+}
+
+void cml_releaseGPUPrograms(cml_GPU* gpu) {
+    assert(gpu != NULL);
+
+    // the programs of other contexts move down over the released ones
+    size_t kept = 0;
+    for(size_t i = 0; i < cml_contextProgramCount; i++) {
+        if(cml_contextPrograms[i].context == gpu->context) {
+            clReleaseProgram(cml_contextPrograms[i].program);
+            free(cml_contextPrograms[i].programFilename);
+        } else {
+            cml_contextPrograms[kept++] = cml_contextPrograms[i];
+        }
+    }
+    cml_contextProgramCount = kept;
+    if(kept == 0) {
+        free(cml_contextPrograms);
+        cml_contextPrograms = NULL;
+    }
+}
+
+cml_GPU cml_setupGPUForDevice(cl_device_id device) {
+    // every program of the library with one of its kernels
+    static const char* const programs[][2] = {
+        {CML_MATRIX_MULTIPLY_PROGRAM, "matrixMultiply"},
+        {CML_MATRIX_ADD_ROW_PROGRAM, "matrixAddRow"},
+        {CML_MATRIX_RELU_PROGRAM, "matrixRelu"},
+        {CML_MATRIX_MULTIPLY_TILED_PROGRAM, "matrixMultiplyTiled"},
+        {CML_MATRIX_ADD_ROW_BROADCAST_PROGRAM, "matrixAddRowBroadcast"},
+        {CML_MATRIX_DENSE_PROGRAM, "matrixDenseLinear"}
+    };
+
+    cml_GPU gpu = cml_createGPU(device);
+    if(gpu.context != NULL) {
+        for(size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+            cml_loadGPUKernel(&gpu, programs[i][0], programs[i][1]);
+        }
+    }
+    return gpu;
+}
+
+cml_GPU cml_setupGPU() {
+    cml_GPU gpu;
+    memset(&gpu, 0, sizeof(gpu));
+    cml_DeviceArray devices = cml_getGPUsWithCUDASupport(1, 1);
+    if(devices.count > 0) {
+        gpu = cml_setupGPUForDevice(devices.deviceIds[0]);
+    }
+    cml_deleteDeviceArray(&devices);
+    return gpu;
+}
+
+bool cml_useTiledMatrixMultiply(const size_t rows, const size_t sharedDimension, const size_t columns) {
+    return columns % CML_MULTIPLY_TILE_WIDTH == 0 &&
+        columns >= CML_MULTIPLY_TILE_COLUMNS &&
+        rows >= CML_MULTIPLY_TILE_ROWS / 2 &&
+        sharedDimension >= CML_MULTIPLY_TILE_WIDTH;
+}
+
+bool cml_canRunTiledMatrixMultiply(cml_GPU* gpu, cl_kernel tiledKernel) {
+    assert(gpu != NULL);
+    assert(tiledKernel != NULL);
+
+    size_t workGroupSize;
+    if(clGetKernelWorkGroupInfo(tiledKernel, gpu->gpu, CL_KERNEL_WORK_GROUP_SIZE, sizeof(workGroupSize), &workGroupSize, NULL) != CL_SUCCESS) {
+        return false;
+    }
+    return workGroupSize >= CML_MULTIPLY_TILE_ROWS * (CML_MULTIPLY_TILE_COLUMNS / CML_MULTIPLY_TILE_WIDTH);
+}
+
+void cml_getTiledMatrixMultiplyWorkSize(const size_t rows, const size_t columns, size_t* globalSize, size_t* localSize) {
+    size_t tileRows = CML_MULTIPLY_TILE_ROWS;
+    size_t tileColumns = CML_MULTIPLY_TILE_COLUMNS;
+    // every work-item covers CML_MULTIPLY_TILE_WIDTH columns
+    globalSize[0] = (rows + tileRows - 1) / tileRows * tileRows;
+    globalSize[1] = (columns + tileColumns - 1) / tileColumns * tileColumns / CML_MULTIPLY_TILE_WIDTH;
+    localSize[0] = tileRows;
+    localSize[1] = tileColumns / CML_MULTIPLY_TILE_WIDTH;
+}
+
+void cml_getDenseWorkSize(const size_t rows, const size_t columns, const size_t* localSize, size_t* globalSize) {
+    // columns first so neighbouring work-items read neighbouring weights
+    globalSize[0] = columns;
+    globalSize[1] = rows;
+    if(localSize != NULL && localSize[0] != 0 && localSize[1] != 0) {
+        globalSize[0] = (columns + localSize[0] - 1) / localSize[0] * localSize[0];
+        globalSize[1] = (rows + localSize[1] - 1) / localSize[1] * localSize[1];
+    }
+}
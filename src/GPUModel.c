@@ -0,0 +1,494 @@
+#include <cml/GPUModel.h>
+#include <cml/GPUKernels.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cml_GPUModel cml_emptyGPUModel() {
+    cml_GPUModel boundModel;
+    memset(&boundModel, 0, sizeof(boundModel));
+    return boundModel;
+}
+
+// From the pool of the model if it has one, flags only apply to buffers created for the model
+static cl_mem cml_createDeviceBuffer(cml_GPUModel* boundModel, const cl_mem_flags flags, const size_t size, const float* data) {
+    cl_int error;
+    if(boundModel->pool == NULL) {
+        cl_mem buffer = clCreateBuffer(boundModel->gpu->context, data != NULL ? flags | CL_MEM_COPY_HOST_PTR : flags, size, (void*)data, &error);
+        return error == CL_SUCCESS ? buffer : NULL;
+    }
+
+    cl_mem buffer = cml_acquireGPUBuffer(boundModel->pool, size);
+    if(buffer != NULL && data != NULL &&
+       clEnqueueWriteBuffer(boundModel->gpu->commands, buffer, CL_TRUE, 0, size, data, 0, NULL, NULL) != CL_SUCCESS) {
+        cml_releaseGPUBuffer(boundModel->pool, buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+// Sets every argument of kernel, arguments[i] points at sizes[i] bytes
+static bool cml_setKernelArguments(cl_kernel kernel, const void** arguments, const size_t* sizes, const cl_uint count) {
+    for(cl_uint i = 0; i < count; i++) {
+        if(clSetKernelArg(kernel, i, sizes[i], arguments[i]) != CL_SUCCESS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Custom activations run the kernel their metadata names
+static bool cml_hasDeviceActivation(const cml_ActivationFnMetadata activation) {
+    return activation.activationID == CML_LINEAR || activation.activationID == CML_RELU ||
+        (activation.activationID == CML_CUSTOM && activation.gpuProgramFilename.size > 0 && activation.gpuKernelName.size > 0);
+}
+
+// Custom activations may read other elements than their own, so only builtin ones run in place
+static bool cml_activatesInPlace(const enum cml_ActivationID activationID) {
+    return activationID != CML_CUSTOM;
+}
+
+// Metadata strings aren't null-terminated once deserialized
+static char* cml_copyMetadataString(const cml_String string) {
+    char* copy = (char*)malloc(string.size + 1);
+    memcpy(copy, string.data, string.size);
+    copy[string.size] = '\0';
+    return copy;
+}
+
+// The kernel the metadata of custom layer i names, from the program it names, built once per context
+static cl_kernel cml_createCustomActivationKernel(cml_GPUModel* boundModel, const cml_Model model, const size_t i) {
+    char* programFilename = cml_copyMetadataString(model.activationFunctions[i].gpuProgramFilename);
+    char* kernelName = cml_copyMetadataString(model.activationFunctions[i].gpuKernelName);
+    cl_kernel kernel = cml_createGPUKernelFromProgram(boundModel->gpu, programFilename, kernelName);
+    free(programFilename);
+    free(kernelName);
+    return kernel;
+}
+
+// An instance of a builtin kernel, from the programs gpu has loaded only if the model is bound that way
+static cl_kernel cml_createBuiltinKernel(cml_GPUModel* boundModel, const char* programFilename, const char* kernelName) {
+    return boundModel->loadedKernelsOnly
+        ? cml_createLoadedGPUKernelInstance(boundModel->gpu, kernelName)
+        : cml_createGPUKernelInstance(boundModel->gpu, programFilename, kernelName);
+}
+
+// Another instance of kernel from the same program, without its arguments
+static cl_kernel cml_cloneKernel(cl_kernel kernel) {
+    cl_program program;
+    size_t nameSize;
+    if(clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(program), &program, NULL) != CL_SUCCESS ||
+       clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, NULL, &nameSize) != CL_SUCCESS) {
+        return NULL;
+    }
+    char* name = (char*)malloc(nameSize);
+    cl_int error = clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, nameSize, name, NULL);
+    cl_kernel clone = error == CL_SUCCESS ? clCreateKernel(program, name, &error) : NULL;
+    free(name);
+    return error == CL_SUCCESS ? clone : NULL;
+}
+
+// Tiled multiply kernel for layer i + 1 if the tuning, or without one the shape, picks it and the device can run it
+// Returns NULL otherwise
+static cl_kernel cml_createTiledMultiplyKernel(cml_GPUModel* boundModel, const size_t i, const cml_GPUTuning* tuning) {
+    // profiles are edited by hand, the float4 loads of the tiled kernel still need whole vectors per row
+    bool tiled = tuning != NULL
+        ? tuning->tiled && boundModel->layerSizes[i+1] % CML_MULTIPLY_TILE_WIDTH == 0
+        : cml_useTiledMatrixMultiply(boundModel->scale, boundModel->layerSizes[i], boundModel->layerSizes[i+1]);
+    if(!tiled) {
+        return NULL;
+    }
+    cl_kernel kernel = cml_createGPUKernelInstance(boundModel->gpu, CML_MATRIX_MULTIPLY_TILED_PROGRAM, "matrixMultiplyTiled");
+    if(kernel != NULL && !cml_canRunTiledMatrixMultiply(boundModel->gpu, kernel)) {
+        clReleaseKernel(kernel);
+        return NULL;
+    }
+    return kernel;
+}
+
+static const char* cml_getDenseKernelName(const enum cml_ActivationID activationID) {
+    return activationID == CML_RELU ? "matrixDenseRelu" : "matrixDenseLinear";
+}
+
+// A new instance of the multiply kernel layerKernels[i] names
+static cl_kernel cml_createMultiplyKernelOfKind(cml_GPUModel* boundModel, const size_t i) {
+    switch(boundModel->layerKernels[i]) {
+        case CML_GPU_LAYER_TILED:
+            return cml_createGPUKernelInstance(boundModel->gpu, CML_MATRIX_MULTIPLY_TILED_PROGRAM, "matrixMultiplyTiled");
+        case CML_GPU_LAYER_DENSE:
+            return cml_createGPUKernelInstance(boundModel->gpu, CML_MATRIX_DENSE_PROGRAM, cml_getDenseKernelName(boundModel->activationIDs[i]));
+        default:
+            return cml_createBuiltinKernel(boundModel, CML_MATRIX_MULTIPLY_PROGRAM, "matrixMultiply");
+    }
+}
+
+// The multiply kernel of layer i + 1, the tiled one for wide layers and the fused dense one for
+// the rest, as tuned if profile has the layer's shape. matrixMultiply is left for when neither
+// program can be loaded, or for every layer when only loaded programs are used.
+static void cml_createMultiplyKernel(cml_GPUModel* boundModel, const size_t i, const cml_GPUProfile* profile) {
+    if(boundModel->loadedKernelsOnly) {
+        boundModel->layerKernels[i] = CML_GPU_LAYER_SEPARATE;
+        boundModel->multiplyKernels[i] = cml_createMultiplyKernelOfKind(boundModel, i);
+        return;
+    }
+    const cml_GPUTuning* tuning = profile != NULL
+        ? cml_findGPUTuning(*profile, boundModel->scale, boundModel->layerSizes[i], boundModel->layerSizes[i+1])
+        : NULL;
+    boundModel->multiplyKernels[i] = cml_createTiledMultiplyKernel(boundModel, i, tuning);
+    boundModel->layerKernels[i] = CML_GPU_LAYER_TILED;
+    if(boundModel->multiplyKernels[i] == NULL) {
+        boundModel->layerKernels[i] = CML_GPU_LAYER_DENSE;
+        boundModel->multiplyKernels[i] = cml_createMultiplyKernelOfKind(boundModel, i);
+        if(tuning != NULL && !tuning->tiled) {
+            boundModel->localSizes[2*i] = tuning->localSize[0];
+            boundModel->localSizes[2*i+1] = tuning->localSize[1];
+        }
+    }
+    if(boundModel->multiplyKernels[i] == NULL) {
+        boundModel->layerKernels[i] = CML_GPU_LAYER_SEPARATE;
+        boundModel->multiplyKernels[i] = cml_createMultiplyKernelOfKind(boundModel, i);
+    }
+}
+
+// Binds the multiply kernel of layer i + 1 to its buffers and creates the other kernels of the layer,
+// but for the kernel of a custom activation, which the caller creates.
+// Only separate layers have an add row kernel and dense layers only have one for custom activations.
+static bool cml_createLayerKernels(cml_GPUModel* boundModel, const size_t i) {
+    if(boundModel->multiplyKernels[i] == NULL) {
+        return false;
+    }
+
+    cl_mem* input = i == 0 ? &boundModel->activationInputs[0] : &boundModel->activationOutputs[i-1];
+    cl_mem* output = &boundModel->activationInputs[i+1];
+    cl_int rows = (cl_int)boundModel->scale;
+    cl_int sharedDimension = (cl_int)boundModel->layerSizes[i];
+    cl_int columns = (cl_int)boundModel->layerSizes[i+1];
+
+    if(boundModel->layerKernels[i] == CML_GPU_LAYER_DENSE) {
+        const void* denseArguments[] = {output, input, &boundModel->weights[i], &boundModel->biases[i], &rows, &sharedDimension, &columns};
+        const size_t denseSizes[] = {sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_int), sizeof(cl_int), sizeof(cl_int)};
+        if(!cml_setKernelArguments(boundModel->multiplyKernels[i], denseArguments, denseSizes, 7)) {
+            return false;
+        }
+    }
+    else if(boundModel->layerKernels[i] == CML_GPU_LAYER_TILED) {
+        const void* tiledArguments[] = {output, input, &boundModel->weights[i], &boundModel->biases[i], &rows, &sharedDimension, &columns};
+        const size_t tiledSizes[] = {sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_int), sizeof(cl_int), sizeof(cl_int)};
+        if(!cml_setKernelArguments(boundModel->multiplyKernels[i], tiledArguments, tiledSizes, 7)) {
+            return false;
+        }
+    }
+    else {
+        // C = A * B, then the biases are added in place
+        boundModel->addRowKernels[i] = boundModel->loadedKernelsOnly
+            ? cml_createLoadedGPUKernelInstance(boundModel->gpu, "matrixAddRow")
+            : cml_createGPUKernelInstance(boundModel->gpu, CML_MATRIX_ADD_ROW_BROADCAST_PROGRAM, "matrixAddRowBroadcast");
+        const void* multiplyArguments[] = {output, input, &boundModel->weights[i], &sharedDimension, &columns};
+        const size_t multiplySizes[] = {sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_int), sizeof(cl_int)};
+        const void* addRowArguments[] = {output, &boundModel->biases[i], output, &columns};
+        const size_t addRowSizes[] = {sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_mem), sizeof(cl_int)};
+        if(boundModel->addRowKernels[i] == NULL ||
+           !cml_setKernelArguments(boundModel->multiplyKernels[i], multiplyArguments, multiplySizes, 5) ||
+           !cml_setKernelArguments(boundModel->addRowKernels[i], addRowArguments, addRowSizes, 4)) {
+            return false;
+        }
+    }
+    bool fusedActivation = boundModel->layerKernels[i] == CML_GPU_LAYER_DENSE && boundModel->activationIDs[i] != CML_CUSTOM;
+    if(boundModel->activationIDs[i] == CML_LINEAR || fusedActivation) {
+        return true;
+    }
+
+    // relu runs in place, where output is also the activation output, custom activations write a buffer of their own
+    if(boundModel->activationIDs[i] == CML_RELU) {
+        boundModel->activationKernels[i] = cml_createBuiltinKernel(boundModel, CML_MATRIX_RELU_PROGRAM, "matrixRelu");
+    }
+    const void* activationArguments[] = {output, &boundModel->activationOutputs[i]};
+    const size_t activationSizes[] = {sizeof(cl_mem), sizeof(cl_mem)};
+    return boundModel->activationKernels[i] != NULL &&
+        cml_setKernelArguments(boundModel->activationKernels[i], activationArguments, activationSizes, 2);
+}
+
+static bool cml_createActivationBuffers(cml_GPUModel* boundModel) {
+    for(size_t i = 0; i < boundModel->layerCount; i++) {
+        size_t activationSize = sizeof(float) * boundModel->scale * boundModel->layerSizes[i];
+        boundModel->activationInputs[i] = cml_createDeviceBuffer(boundModel, CL_MEM_READ_WRITE, activationSize, NULL);
+        if(boundModel->activationInputs[i] == NULL) {
+            return false;
+        }
+        if(i == 0) {
+            continue;
+        }
+        if(cml_activatesInPlace(boundModel->activationIDs[i-1])) {
+            // linear and relu work in place, the activation output is the same buffer as its input
+            clRetainMemObject(boundModel->activationInputs[i]);
+            boundModel->activationOutputs[i-1] = boundModel->activationInputs[i];
+        } else {
+            boundModel->activationOutputs[i-1] = cml_createDeviceBuffer(boundModel, CL_MEM_READ_WRITE, activationSize, NULL);
+            if(boundModel->activationOutputs[i-1] == NULL) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Uploads the weights and biases and creates the activation buffers and kernels, model.lock is held
+static bool cml_uploadModel(const cml_Model model, cml_GPUModel* boundModel, const cml_GPUProfile* profile) {
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    bool success = cml_createActivationBuffers(boundModel);
+    for(size_t i = 0; i < model.layerCount-1 && success; i++) {
+        boundModel->weights[i] = cml_createDeviceBuffer(boundModel, CL_MEM_READ_ONLY,
+            sizeof(float) * model.layerSizes[i] * model.layerSizes[i+1], modelMatrices.weights[i].data);
+        boundModel->biases[i] = cml_createDeviceBuffer(boundModel, CL_MEM_READ_ONLY,
+            sizeof(float) * model.layerSizes[i+1], modelMatrices.biases[i].data);
+        success = boundModel->weights[i] != NULL && boundModel->biases[i] != NULL;
+    }
+    cml_deleteModelMatrices(modelMatrices);
+
+    for(size_t i = 0; i < model.layerCount-1 && success; i++) {
+        if(boundModel->activationIDs[i] == CML_CUSTOM) {
+            boundModel->activationKernels[i] = cml_createCustomActivationKernel(boundModel, model, i);
+        }
+        cml_createMultiplyKernel(boundModel, i, profile);
+        success = cml_createLayerKernels(boundModel, i);
+    }
+    return success;
+}
+
+// Allocates the arrays of a bound model with layerCount layers, activationIDs are left to fill in
+static cml_GPUModel cml_createGPUModel(cml_GPU* gpu, const size_t layerCount, const size_t scale, const uint64* layerSizes) {
+    cml_GPUModel boundModel = cml_emptyGPUModel();
+    boundModel.gpu = gpu;
+    boundModel.layerCount = layerCount;
+    boundModel.scale = scale;
+    boundModel.layerSizes = (uint64*)malloc(sizeof(uint64) * layerCount);
+    memcpy(boundModel.layerSizes, layerSizes, sizeof(uint64) * layerCount);
+
+    // calloc so a failed bind only releases what was created
+    boundModel.activationIDs = (enum cml_ActivationID*)malloc(sizeof(enum cml_ActivationID) * layerCount);
+    boundModel.weights = (cl_mem*)calloc(layerCount, sizeof(cl_mem));
+    boundModel.biases = (cl_mem*)calloc(layerCount, sizeof(cl_mem));
+    boundModel.activationInputs = (cl_mem*)calloc(layerCount, sizeof(cl_mem));
+    boundModel.activationOutputs = (cl_mem*)calloc(layerCount, sizeof(cl_mem));
+    boundModel.multiplyKernels = (cl_kernel*)calloc(layerCount, sizeof(cl_kernel));
+    boundModel.layerKernels = (enum cml_GPULayerKernels*)calloc(layerCount, sizeof(enum cml_GPULayerKernels));
+    boundModel.localSizes = (size_t*)calloc(2 * layerCount, sizeof(size_t));
+    boundModel.addRowKernels = (cl_kernel*)calloc(layerCount, sizeof(cl_kernel));
+    boundModel.activationKernels = (cl_kernel*)calloc(layerCount, sizeof(cl_kernel));
+    boundModel.lock = cml_createMutex();
+    return boundModel;
+}
+
+cml_GPUModel cml_bindModelGPU(const cml_Model model, cml_GPU* gpu) {
+    return cml_bindModelGPUWithOptions(model, gpu, cml_createGPUBindOptions());
+}
+
+cml_GPUModel cml_bindTunedModelGPU(const cml_Model model, cml_GPU* gpu, const cml_GPUProfile* profile) {
+    cml_GPUBindOptions options = cml_createGPUBindOptions();
+    options.profile = profile;
+    return cml_bindModelGPUWithOptions(model, gpu, options);
+}
+
+cml_GPUBindOptions cml_createGPUBindOptions() {
+    cml_GPUBindOptions options;
+    options.profile = NULL;
+    options.pool = NULL;
+    options.loadedKernelsOnly = false;
+    return options;
+}
+
+cml_GPUModel cml_bindModelGPUWithOptions(const cml_Model model, cml_GPU* gpu, const cml_GPUBindOptions options) {
+    assert(model.data != NULL);
+    assert(gpu != NULL);
+
+    for(size_t i = 0; i < model.layerCount-1; i++) {
+        if(!cml_hasDeviceActivation(model.activationFunctions[i])) {
+            return cml_emptyGPUModel();
+        }
+    }
+    if(!cml_verifyModel(model)) {
+        return cml_emptyGPUModel();
+    }
+
+    cml_GPUModel boundModel = cml_createGPUModel(gpu, model.layerCount, model.scale, model.layerSizes);
+    boundModel.pool = options.pool;
+    boundModel.loadedKernelsOnly = options.loadedKernelsOnly;
+    for(size_t i = 0; i < model.layerCount-1; i++) {
+        boundModel.activationIDs[i] = model.activationFunctions[i].activationID;
+    }
+
+    cml_lockMutex(model.lock);
+    bool success = cml_uploadModel(model, &boundModel, options.profile);
+    cml_unlockMutex(model.lock);
+
+    if(!success) {
+        cml_unbindModelGPU(&boundModel);
+    }
+    return boundModel;
+}
+
+cml_GPUModel cml_copyBoundModelGPU(const cml_GPUModel boundModel) {
+    assert(boundModel.weights != NULL);
+
+    cml_GPUModel copy = cml_createGPUModel(boundModel.gpu, boundModel.layerCount, boundModel.scale, boundModel.layerSizes);
+    size_t layerCount = boundModel.layerCount-1;
+    memcpy(copy.activationIDs, boundModel.activationIDs, sizeof(enum cml_ActivationID) * layerCount);
+    memcpy(copy.layerKernels, boundModel.layerKernels, sizeof(enum cml_GPULayerKernels) * layerCount);
+    memcpy(copy.localSizes, boundModel.localSizes, sizeof(size_t) * 2 * layerCount);
+    copy.pool = boundModel.pool;
+    copy.sharesWeights = true;
+    copy.loadedKernelsOnly = boundModel.loadedKernelsOnly;
+    for(size_t i = 0; i < layerCount; i++) {
+        clRetainMemObject(boundModel.weights[i]);
+        copy.weights[i] = boundModel.weights[i];
+        clRetainMemObject(boundModel.biases[i]);
+        copy.biases[i] = boundModel.biases[i];
+    }
+
+    bool success = cml_createActivationBuffers(&copy);
+    for(size_t i = 0; i < layerCount && success; i++) {
+        if(copy.activationIDs[i] == CML_CUSTOM) {
+            copy.activationKernels[i] = cml_cloneKernel(boundModel.activationKernels[i]);
+        }
+        copy.multiplyKernels[i] = cml_createMultiplyKernelOfKind(&copy, i);
+        success = cml_createLayerKernels(&copy, i);
+    }
+    if(!success) {
+        cml_unbindModelGPU(&copy);
+    }
+    return copy;
+}
+
+// Buffers the model owns go back to its pool, if it has one, the rest only lose a reference
+static void cml_releaseDeviceBuffer(const cml_GPUModel* boundModel, cl_mem buffer, const bool owned) {
+    if(buffer == NULL) {
+        return;
+    }
+    if(owned && boundModel->pool != NULL) {
+        cml_releaseGPUBuffer(boundModel->pool, buffer);
+    } else {
+        clReleaseMemObject(buffer);
+    }
+}
+
+static void cml_releaseKernels(cl_kernel* kernels, const size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        if(kernels[i] != NULL) {
+            clReleaseKernel(kernels[i]);
+        }
+    }
+    free(kernels);
+}
+
+void cml_unbindModelGPU(cml_GPUModel* boundModel) {
+    assert(boundModel != NULL);
+
+    // the empty model of a failed bind
+    if(boundModel->weights == NULL) {
+        return;
+    }
+    size_t layerCount = boundModel->layerCount-1;
+    cml_releaseKernels(boundModel->multiplyKernels, layerCount);
+    free(boundModel->layerKernels);
+    free(boundModel->localSizes);
+    cml_releaseKernels(boundModel->addRowKernels, layerCount);
+    cml_releaseKernels(boundModel->activationKernels, layerCount);
+    for(size_t i = 0; i < layerCount; i++) {
+        cml_releaseDeviceBuffer(boundModel, boundModel->weights[i], !boundModel->sharesWeights);
+        cml_releaseDeviceBuffer(boundModel, boundModel->biases[i], !boundModel->sharesWeights);
+        // in place activations hold a second reference to their input
+        bool inPlace = boundModel->activationOutputs[i] == boundModel->activationInputs[i+1];
+        cml_releaseDeviceBuffer(boundModel, boundModel->activationOutputs[i], !inPlace);
+    }
+    for(size_t i = 0; i < boundModel->layerCount; i++) {
+        cml_releaseDeviceBuffer(boundModel, boundModel->activationInputs[i], true);
+    }
+    free(boundModel->weights);
+    free(boundModel->biases);
+    free(boundModel->activationInputs);
+    free(boundModel->activationOutputs);
+    free(boundModel->layerSizes);
+    free(boundModel->activationIDs);
+    cml_deleteMutex(boundModel->lock);
+    *boundModel = cml_emptyGPUModel();
+}
+
+static void cml_getMultiplyWorkSize(const cml_GPUModel boundModel, const size_t i, size_t* globalSize, size_t* localSize) {
+    size_t rows = boundModel.scale;
+    size_t columns = boundModel.layerSizes[i+1];
+    switch(boundModel.layerKernels[i]) {
+        case CML_GPU_LAYER_TILED:
+            cml_getTiledMatrixMultiplyWorkSize(rows, columns, globalSize, localSize);
+            break;
+        case CML_GPU_LAYER_DENSE:
+            localSize[0] = boundModel.localSizes[2*i];
+            localSize[1] = boundModel.localSizes[2*i+1];
+            cml_getDenseWorkSize(rows, columns, localSize, globalSize);
+            break;
+        default:
+            globalSize[0] = rows;
+            globalSize[1] = columns;
+            localSize[0] = 0;
+            localSize[1] = 0;
+    }
+}
+
+// Enqueues the whole predict on commands, the output read signals outputRead if it isn't NULL
+static bool cml_enqueuePredict(const cml_GPUModel boundModel, cl_command_queue commands, const float* in, float* out,
+                               const cl_bool blocking, cl_event* outputRead) {
+    // the queue runs in order, so nothing waits until the output is read back and in
+    // stays untouched until then
+    bool success = clEnqueueWriteBuffer(commands, boundModel.activationInputs[0], CL_FALSE, 0,
+        sizeof(float) * boundModel.scale * boundModel.layerSizes[0], in, 0, NULL, NULL) == CL_SUCCESS;
+
+    for(size_t i = 0; i < boundModel.layerCount-1 && success; i++) {
+        size_t multiplySize[2];
+        size_t multiplyLocalSize[2];
+        cml_getMultiplyWorkSize(boundModel, i, multiplySize, multiplyLocalSize);
+        // a float4 per work-item when the rows are made of whole float4s, matrixAddRow takes a row per work-item
+        size_t activationSize[] = {boundModel.scale * boundModel.layerSizes[i+1]};
+        size_t addRowSize[] = {boundModel.layerSizes[i+1] % 4 == 0 ? activationSize[0] / 4 : activationSize[0]};
+        if(boundModel.loadedKernelsOnly) {
+            addRowSize[0] = boundModel.scale;
+        }
+        success = clEnqueueNDRangeKernel(commands, boundModel.multiplyKernels[i], 2, NULL, multiplySize,
+                multiplyLocalSize[0] != 0 ? multiplyLocalSize : NULL, 0, NULL, NULL) == CL_SUCCESS &&
+            (boundModel.addRowKernels[i] == NULL ||
+             clEnqueueNDRangeKernel(commands, boundModel.addRowKernels[i], 1, NULL, addRowSize, NULL, 0, NULL, NULL) == CL_SUCCESS) &&
+            (boundModel.activationKernels[i] == NULL ||
+             clEnqueueNDRangeKernel(commands, boundModel.activationKernels[i], 1, NULL, activationSize, NULL, 0, NULL, NULL) == CL_SUCCESS);
+    }
+
+    size_t lastLayer = boundModel.layerCount-1;
+    success = success && clEnqueueReadBuffer(commands, boundModel.activationOutputs[lastLayer-1], blocking, 0,
+        sizeof(float) * boundModel.scale * boundModel.layerSizes[lastLayer], out, 0, NULL, outputRead) == CL_SUCCESS;
+    // a failed enqueue may leave earlier commands reading from in
+    if(!success) {
+        clFinish(commands);
+    }
+    return success;
+}
+
+bool cml_predictBoundModelGPU(const cml_GPUModel boundModel, const float* in, float* out) {
+    assert(boundModel.weights != NULL);
+    assert(in != NULL);
+    assert(out != NULL);
+
+    cml_lockMutex(boundModel.lock);
+    bool success = cml_enqueuePredict(boundModel, boundModel.gpu->commands, in, out, CL_TRUE, NULL);
+    cml_unlockMutex(boundModel.lock);
+    return success;
+}
+
+bool cml_enqueuePredictBoundModelGPU(const cml_GPUModel boundModel, cl_command_queue commands, const float* in, float* out,
+                                     cl_event* outputRead) {
+    assert(boundModel.weights != NULL);
+    assert(commands != NULL);
+    assert(in != NULL);
+    assert(out != NULL);
+    assert(outputRead != NULL);
+
+    *outputRead = NULL;
+    return cml_enqueuePredict(boundModel, commands, in, out, CL_FALSE, outputRead);
+}
@@ -0,0 +1,185 @@
+#include <cml/GPUProgramCache.h>
+#include <cml/util/Crc32c.h>
+#include <cml/util/Endian.h>
+#include <intdefs.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CML_PROGRAM_CACHE_MAGIC "CMLCLBIN"
+#define CML_PROGRAM_CACHE_MAGIC_SIZE 8
+// magic, key size, source checksum, binary size and binary checksum, followed by the key and the binary
+#define CML_PROGRAM_CACHE_HEADER_SIZE (CML_PROGRAM_CACHE_MAGIC_SIZE + 4 + 4 + 8 + 4)
+#define CML_PROGRAM_CACHE_MAX_KEY_SIZE 1024
+#define CML_PROGRAM_CACHE_MAX_DEVICE_INFO_SIZE 256
+// Sanity limit when loading, a corrupt size should not turn into a huge allocation
+#define CML_PROGRAM_CACHE_MAX_BINARY_SIZE 0x10000000
+
+const char* cml_gpuProgramCacheDirectory = NULL;
+
+// Everything but the source a binary depends on, one line each
+// Returns false if the device doesn't report it or it doesn't fit in key
+static bool cml_getProgramCacheKey(cml_GPU* gpu, const char* options, char* key) {
+    const cl_device_info infos[] = {CL_DEVICE_NAME, CL_DEVICE_VERSION, CL_DRIVER_VERSION};
+    char values[3][CML_PROGRAM_CACHE_MAX_DEVICE_INFO_SIZE];
+    for(size_t i = 0; i < 3; i++) {
+        if(clGetDeviceInfo(gpu->gpu, infos[i], sizeof(values[i]), values[i], NULL) != CL_SUCCESS) {
+            return false;
+        }
+        values[i][sizeof(values[i]) - 1] = '\0';
+    }
+    int size = snprintf(key, CML_PROGRAM_CACHE_MAX_KEY_SIZE, "%s\n%s\n%s\n%s", values[0], values[1], values[2], options);
+    return size > 0 && size < CML_PROGRAM_CACHE_MAX_KEY_SIZE;
+}
+
+// One file per key and source, the checksums keep the name short and the file header has the rest
+static char* cml_getProgramCachePath(const char* key, const uint32 sourceChecksum) {
+    uint32 keyChecksum = cml_crc32c(0, key, strlen(key));
+    size_t size = strlen(cml_gpuProgramCacheDirectory) + 32;
+    char* path = (char*)malloc(size);
+    snprintf(path, size, "%s/%08x%08x.clbin", cml_gpuProgramCacheDirectory, (unsigned int)keyChecksum, (unsigned int)sourceChecksum);
+    return path;
+}
+
+static cl_program cml_buildProgramFromBinary(cml_GPU* gpu, const unsigned char* binary, const size_t size, const char* options) {
+    cl_int binaryStatus;
+    cl_int error;
+    cl_program program = clCreateProgramWithBinary(gpu->context, 1, &gpu->gpu, &size, &binary, &binaryStatus, &error);
+    if(error != CL_SUCCESS || binaryStatus != CL_SUCCESS) {
+        return NULL;
+    }
+    if(clBuildProgram(program, 1, &gpu->gpu, options, NULL, NULL) != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+// Returns NULL if there is no cached binary for key and source or the driver rejects it
+static cl_program cml_loadCachedProgram(cml_GPU* gpu, const char* path, const char* key, const uint32 sourceChecksum, const char* options) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) {
+        return NULL;
+    }
+
+    char header[CML_PROGRAM_CACHE_HEADER_SIZE];
+    size_t keySize = strlen(key);
+    char storedKey[CML_PROGRAM_CACHE_MAX_KEY_SIZE];
+    unsigned char* binary = NULL;
+    size_t binarySize = 0;
+    bool valid = fread(header, 1, sizeof(header), file) == sizeof(header) &&
+        memcmp(header, CML_PROGRAM_CACHE_MAGIC, CML_PROGRAM_CACHE_MAGIC_SIZE) == 0 &&
+        cml_readUint32LE(header + 8) == keySize &&
+        cml_readUint32LE(header + 12) == sourceChecksum &&
+        fread(storedKey, 1, keySize, file) == keySize &&
+        memcmp(storedKey, key, keySize) == 0;
+    if(valid) {
+        uint64 storedSize = cml_readUint64LE(header + 16);
+        valid = storedSize > 0 && storedSize <= CML_PROGRAM_CACHE_MAX_BINARY_SIZE;
+        binarySize = valid ? (size_t)storedSize : 0;
+    }
+    if(valid) {
+        // a torn write from another process fails the checksum
+        binary = (unsigned char*)malloc(binarySize);
+        valid = fread(binary, 1, binarySize, file) == binarySize &&
+            cml_crc32c(0, (const char*)binary, binarySize) == cml_readUint32LE(header + 24);
+    }
+    fclose(file);
+
+    cl_program program = valid ? cml_buildProgramFromBinary(gpu, binary, binarySize, options) : NULL;
+    free(binary);
+    return program;
+}
+
+static bool cml_writeCachedProgram(FILE* file, const char* key, const uint32 sourceChecksum, const unsigned char* binary, const size_t binarySize) {
+    char header[CML_PROGRAM_CACHE_HEADER_SIZE];
+    memcpy(header, CML_PROGRAM_CACHE_MAGIC, CML_PROGRAM_CACHE_MAGIC_SIZE);
+    cml_writeUint32LE(header + 8, (uint32)strlen(key));
+    cml_writeUint32LE(header + 12, sourceChecksum);
+    cml_writeUint64LE(header + 16, (uint64)binarySize);
+    cml_writeUint32LE(header + 24, cml_crc32c(0, (const char*)binary, binarySize));
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+        fwrite(key, 1, strlen(key), file) == strlen(key) &&
+        fwrite(binary, 1, binarySize, file) == binarySize;
+}
+
+// Failing to store only costs the next process a build, so errors are ignored
+static void cml_storeCachedProgram(cl_program program, const char* path, const char* key, const uint32 sourceChecksum) {
+    size_t binarySize;
+    if(clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(binarySize), &binarySize, NULL) != CL_SUCCESS ||
+       binarySize == 0 || binarySize > CML_PROGRAM_CACHE_MAX_BINARY_SIZE) {
+        return;
+    }
+    unsigned char* binary = (unsigned char*)malloc(binarySize);
+    if(clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL) != CL_SUCCESS) {
+        free(binary);
+        return;
+    }
+
+    // written next to the cached file and renamed, so readers never see half a binary
+    size_t temporarySize = strlen(path) + 5;
+    char* temporaryPath = (char*)malloc(temporarySize);
+    snprintf(temporaryPath, temporarySize, "%s.tmp", path);
+    FILE* file = fopen(temporaryPath, "wb");
+    if(file != NULL) {
+        bool written = cml_writeCachedProgram(file, key, sourceChecksum, binary, binarySize);
+        written = fclose(file) == 0 && written;
+        // rename does not replace an existing file everywhere
+        remove(path);
+        if(!written || rename(temporaryPath, path) != 0) {
+            remove(temporaryPath);
+        }
+    }
+    free(temporaryPath);
+    free(binary);
+}
+
+static cl_program cml_buildProgramFromSource(cml_GPU* gpu, const char* source, const size_t size, const char* options) {
+    cl_int error;
+    cl_program program = clCreateProgramWithSource(gpu->context, 1, &source, &size, &error);
+    if(error != CL_SUCCESS) {
+        return NULL;
+    }
+    if(clBuildProgram(program, 1, &gpu->gpu, options, NULL, NULL) != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+cl_program cml_buildGPUProgram(cml_GPU* gpu, const char* source, const size_t size, const char* options) {
+    assert(gpu != NULL);
+    assert(source != NULL);
+
+    options = options != NULL ? options : "";
+    char key[CML_PROGRAM_CACHE_MAX_KEY_SIZE];
+    if(cml_gpuProgramCacheDirectory == NULL || !cml_getProgramCacheKey(gpu, options, key)) {
+        return cml_buildProgramFromSource(gpu, source, size, options);
+    }
+
+    uint32 sourceChecksum = cml_crc32c(0, source, size);
+    char* path = cml_getProgramCachePath(key, sourceChecksum);
+    cl_program program = cml_loadCachedProgram(gpu, path, key, sourceChecksum, options);
+    if(program == NULL) {
+        program = cml_buildProgramFromSource(gpu, source, size, options);
+        if(program != NULL) {
+            cml_storeCachedProgram(program, path, key, sourceChecksum);
+        }
+    }
+    free(path);
+    return program;
+}
+
+char* cml_getGPUProgramCachePath(cml_GPU* gpu, const char* source, const size_t size, const char* options) {
+    assert(gpu != NULL);
+    assert(source != NULL);
+
+    char key[CML_PROGRAM_CACHE_MAX_KEY_SIZE];
+    if(cml_gpuProgramCacheDirectory == NULL || !cml_getProgramCacheKey(gpu, options != NULL ? options : "", key)) {
+        return NULL;
+    }
+    return cml_getProgramCachePath(key, cml_crc32c(0, source, size));
+}
@@ -0,0 +1,155 @@
+#include <cml/GPUStream.h>
+#include <intdefs.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cml_GPUStream cml_emptyGPUStream() {
+    cml_GPUStream stream;
+    memset(&stream, 0, sizeof(stream));
+    return stream;
+}
+
+// A host visible buffer the driver can transfer from without staging, mapped for the host to fill or read
+static cl_mem cml_createPinnedBuffer(cml_GPU* gpu, cl_command_queue commands, const cl_map_flags mapFlags,
+                                     const size_t size, float** mapped) {
+    cl_int error;
+    cl_mem buffer = clCreateBuffer(gpu->context, CL_MEM_ALLOC_HOST_PTR, size, NULL, &error);
+    if(error != CL_SUCCESS) {
+        return NULL;
+    }
+    *mapped = (float*)clEnqueueMapBuffer(commands, buffer, CL_TRUE, mapFlags, 0, size, 0, NULL, NULL, &error);
+    if(error != CL_SUCCESS) {
+        clReleaseMemObject(buffer);
+        *mapped = NULL;
+        return NULL;
+    }
+    return buffer;
+}
+
+static bool cml_createStreamSlot(cml_GPUStreamSlot* slot, const cml_GPUModel boundModel) {
+    cml_GPU* gpu = boundModel.gpu;
+    cl_int error;
+    slot->commands = clCreateCommandQueue(gpu->context, gpu->gpu, 0, &error);
+    if(error != CL_SUCCESS) {
+        slot->commands = NULL;
+        return false;
+    }
+
+    slot->model = cml_copyBoundModelGPU(boundModel);
+    size_t lastLayer = boundModel.layerCount-1;
+    slot->pinnedInput = cml_createPinnedBuffer(gpu, slot->commands, CL_MAP_WRITE,
+        sizeof(float) * boundModel.scale * boundModel.layerSizes[0], &slot->input);
+    slot->pinnedOutput = cml_createPinnedBuffer(gpu, slot->commands, CL_MAP_READ,
+        sizeof(float) * boundModel.scale * boundModel.layerSizes[lastLayer], &slot->output);
+    return slot->model.weights != NULL && slot->pinnedInput != NULL && slot->pinnedOutput != NULL;
+}
+
+static void cml_deleteStreamSlot(cml_GPUStreamSlot* slot) {
+    if(slot->commands == NULL) {
+        return;
+    }
+    // a failed predict may still have commands queued
+    clFinish(slot->commands);
+    if(slot->outputRead != NULL) {
+        clReleaseEvent(slot->outputRead);
+    }
+    if(slot->pinnedInput != NULL) {
+        clEnqueueUnmapMemObject(slot->commands, slot->pinnedInput, slot->input, 0, NULL, NULL);
+    }
+    if(slot->pinnedOutput != NULL) {
+        clEnqueueUnmapMemObject(slot->commands, slot->pinnedOutput, slot->output, 0, NULL, NULL);
+    }
+    clFinish(slot->commands);
+    if(slot->pinnedInput != NULL) {
+        clReleaseMemObject(slot->pinnedInput);
+    }
+    if(slot->pinnedOutput != NULL) {
+        clReleaseMemObject(slot->pinnedOutput);
+    }
+    cml_unbindModelGPU(&slot->model);
+    clReleaseCommandQueue(slot->commands);
+    memset(slot, 0, sizeof(*slot));
+}
+
+cml_GPUStream cml_createGPUStream(const cml_GPUModel boundModel, const size_t slotCount) {
+    assert(boundModel.weights != NULL);
+    assert(slotCount >= 2);
+
+    cml_GPUStream stream = cml_emptyGPUStream();
+    stream.gpu = boundModel.gpu;
+    stream.slotCount = slotCount;
+    // calloc so a failed create only releases what was created
+    stream.slots = (cml_GPUStreamSlot*)calloc(slotCount, sizeof(cml_GPUStreamSlot));
+    bool success = true;
+    for(size_t i = 0; i < slotCount && success; i++) {
+        success = cml_createStreamSlot(&stream.slots[i], boundModel);
+    }
+    if(!success) {
+        cml_deleteGPUStream(&stream);
+    }
+    return stream;
+}
+
+void cml_deleteGPUStream(cml_GPUStream* stream) {
+    assert(stream != NULL);
+
+    for(size_t i = 0; i < stream->slotCount; i++) {
+        cml_deleteStreamSlot(&stream->slots[i]);
+    }
+    free(stream->slots);
+    *stream = cml_emptyGPUStream();
+}
+
+// Waits for the batch in slot, if there is one, and copies its rows to out
+static bool cml_finishStreamSlot(cml_GPUStreamSlot* slot, float* out) {
+    if(slot->outputRead == NULL) {
+        return true;
+    }
+    cl_int status;
+    bool success = clWaitForEvents(1, &slot->outputRead) == CL_SUCCESS &&
+        clGetEventInfo(slot->outputRead, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL) == CL_SUCCESS &&
+        status == CL_COMPLETE;
+    clReleaseEvent(slot->outputRead);
+    slot->outputRead = NULL;
+    if(success) {
+        size_t columns = slot->model.layerSizes[slot->model.layerCount-1];
+        memcpy(out + slot->firstRow * columns, slot->output, sizeof(float) * slot->rowCount * columns);
+    }
+    return success;
+}
+
+bool cml_predictStreamGPU(cml_GPUStream* stream, const float* in, float* out, const size_t rowCount) {
+    assert(stream != NULL);
+    assert(stream->slots != NULL);
+    assert(in != NULL);
+    assert(out != NULL);
+
+    size_t scale = stream->slots[0].model.scale;
+    size_t inputColumns = stream->slots[0].model.layerSizes[0];
+    bool success = true;
+    size_t slotIndex = 0;
+    for(size_t firstRow = 0; firstRow < rowCount && success; firstRow += scale) {
+        // the slot's previous batch is the oldest in flight, the others keep the device busy meanwhile
+        cml_GPUStreamSlot* slot = &stream->slots[slotIndex];
+        slotIndex = (slotIndex + 1) % stream->slotCount;
+        if(!cml_finishStreamSlot(slot, out)) {
+            success = false;
+            break;
+        }
+
+        slot->firstRow = firstRow;
+        slot->rowCount = rowCount - firstRow < scale ? rowCount - firstRow : scale;
+        memcpy(slot->input, in + firstRow * inputColumns, sizeof(float) * slot->rowCount * inputColumns);
+        memset(slot->input + slot->rowCount * inputColumns, 0, sizeof(float) * (scale - slot->rowCount) * inputColumns);
+        // flushed so the batch starts now, not when the slot is waited on
+        success = cml_enqueuePredictBoundModelGPU(slot->model, slot->commands, slot->input, slot->output, &slot->outputRead) &&
+            clFlush(slot->commands) == CL_SUCCESS;
+    }
+
+    for(size_t i = 0; i < stream->slotCount; i++) {
+        success = cml_finishStreamSlot(&stream->slots[i], out) && success;
+    }
+    return success;
+}
@@ -0,0 +1,340 @@
+#include <cml/GPUTuning.h>
+#include <cml/GPUKernels.h>
+#include <cml/util/MappedFile.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest profile line of the current device that is read, device names are far shorter
+#define CML_PROFILE_MAX_LINE_SIZE 1024
+
+// Work-group sizes of matrixDense tried by the tuner, {0, 0} leaves it to the driver
+static const size_t cml_denseLocalSizes[][2] = {
+    {0, 0}, {32, 1}, {64, 1}, {128, 1}, {256, 1}, {8, 8}, {16, 4}, {16, 8}, {16, 16}, {32, 4}, {32, 8}
+};
+
+static cml_GPUProfile cml_emptyGPUProfile() {
+    cml_GPUProfile profile;
+    profile.deviceName = NULL;
+    profile.tunings = NULL;
+    profile.tuningCount = 0;
+    return profile;
+}
+
+cml_GPUProfile cml_createGPUProfile(cml_GPU* gpu) {
+    assert(gpu != NULL);
+
+    cml_GPUProfile profile = cml_emptyGPUProfile();
+    size_t nameSize;
+    if(clGetDeviceInfo(gpu->gpu, CL_DEVICE_NAME, 0, NULL, &nameSize) != CL_SUCCESS || nameSize == 0) {
+        return profile;
+    }
+    profile.deviceName = (char*)malloc(nameSize);
+    if(clGetDeviceInfo(gpu->gpu, CL_DEVICE_NAME, nameSize, profile.deviceName, NULL) != CL_SUCCESS) {
+        free(profile.deviceName);
+        profile.deviceName = NULL;
+        return profile;
+    }
+    profile.deviceName[nameSize - 1] = '\0';
+    return profile;
+}
+
+// Whether line, which is not null-terminated, starts with deviceName followed by a tab
+static bool cml_isProfileLineOf(const char* line, const size_t size, const char* deviceName) {
+    size_t nameSize = strlen(deviceName);
+    return size > nameSize && memcmp(line, deviceName, nameSize) == 0 && line[nameSize] == '\t';
+}
+
+// Parses the fields after the tab of one line of the profile's device
+static bool cml_parseGPUTuning(const char* line, const size_t size, const size_t nameSize, cml_GPUTuning* tuning) {
+    char fields[CML_PROFILE_MAX_LINE_SIZE];
+    if(size - nameSize - 1 >= sizeof(fields)) {
+        return false;
+    }
+    memcpy(fields, line + nameSize + 1, size - nameSize - 1);
+    fields[size - nameSize - 1] = '\0';
+
+    unsigned long long values[5];
+    char kernel[8];
+    if(sscanf(fields, "%llu %llu %llu %7s %llu %llu", &values[0], &values[1], &values[2], kernel, &values[3], &values[4]) != 6) {
+        return false;
+    }
+    tuning->rows = values[0];
+    tuning->sharedDimension = values[1];
+    tuning->columns = values[2];
+    tuning->localSize[0] = (size_t)values[3];
+    tuning->localSize[1] = (size_t)values[4];
+    tuning->tiled = strcmp(kernel, "tiled") == 0;
+    return tuning->tiled || strcmp(kernel, "dense") == 0;
+}
+
+cml_GPUProfile cml_loadGPUProfile(const char* filename, cml_GPU* gpu) {
+    assert(filename != NULL);
+    assert(gpu != NULL);
+
+    cml_GPUProfile profile = cml_createGPUProfile(gpu);
+    if(profile.deviceName == NULL) {
+        return profile;
+    }
+    cml_MappedFile file = cml_mapFile(filename);
+    if(file.data == NULL) {
+        return profile;
+    }
+
+    size_t nameSize = strlen(profile.deviceName);
+    const char* end = file.data + file.size;
+    for(const char* line = file.data; line < end; ) {
+        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+        lineEnd = lineEnd != NULL ? lineEnd : end;
+        size_t size = lineEnd - line;
+        size = size > 0 && line[size - 1] == '\r' ? size - 1 : size;
+
+        cml_GPUTuning tuning;
+        if(cml_isProfileLineOf(line, size, profile.deviceName)) {
+            if(!cml_parseGPUTuning(line, size, nameSize, &tuning)) {
+                cml_deleteGPUProfile(&profile);
+                break;
+            }
+            cml_addGPUTuning(&profile, tuning);
+        }
+        line = lineEnd + 1;
+    }
+    cml_unmapFile(&file);
+    return profile;
+}
+
+bool cml_saveGPUProfile(const char* filename, const cml_GPUProfile profile) {
+    assert(filename != NULL);
+    assert(profile.deviceName != NULL);
+
+    size_t temporarySize = strlen(filename) + 5;
+    char* temporaryFilename = (char*)malloc(temporarySize);
+    snprintf(temporaryFilename, temporarySize, "%s.tmp", filename);
+    FILE* out = fopen(temporaryFilename, "wb");
+    if(out == NULL) {
+        free(temporaryFilename);
+        return false;
+    }
+
+    // the other devices' lines are copied as they are
+    bool success = true;
+    cml_MappedFile file = cml_mapFile(filename);
+    if(file.data != NULL) {
+        const char* end = file.data + file.size;
+        for(const char* line = file.data; line < end && success; ) {
+            const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+            lineEnd = lineEnd != NULL ? lineEnd : end;
+            size_t size = lineEnd - line;
+            if(size > 0 && !cml_isProfileLineOf(line, size, profile.deviceName)) {
+                success = fwrite(line, 1, size, out) == size && fputc('\n', out) != EOF;
+            }
+            line = lineEnd + 1;
+        }
+        cml_unmapFile(&file);
+    }
+
+    for(size_t i = 0; i < profile.tuningCount && success; i++) {
+        const cml_GPUTuning* tuning = &profile.tunings[i];
+        success = fprintf(out, "%s\t%llu %llu %llu %s %llu %llu\n", profile.deviceName,
+            (unsigned long long)tuning->rows, (unsigned long long)tuning->sharedDimension,
+            (unsigned long long)tuning->columns, tuning->tiled ? "tiled" : "dense",
+            (unsigned long long)tuning->localSize[0], (unsigned long long)tuning->localSize[1]) > 0;
+    }
+    success = fclose(out) == 0 && success;
+
+    // rename does not replace an existing file everywhere
+    if(success) {
+        remove(filename);
+        success = rename(temporaryFilename, filename) == 0;
+    }
+    if(!success) {
+        remove(temporaryFilename);
+    }
+    free(temporaryFilename);
+    return success;
+}
+
+void cml_deleteGPUProfile(cml_GPUProfile* profile) {
+    assert(profile != NULL);
+
+    free(profile->deviceName);
+    free(profile->tunings);
+    *profile = cml_emptyGPUProfile();
+}
+
+const cml_GPUTuning* cml_findGPUTuning(const cml_GPUProfile profile, const uint64 rows, const uint64 sharedDimension, const uint64 columns) {
+    for(size_t i = 0; i < profile.tuningCount; i++) {
+        const cml_GPUTuning* tuning = &profile.tunings[i];
+        if(tuning->rows == rows && tuning->sharedDimension == sharedDimension && tuning->columns == columns) {
+            return tuning;
+        }
+    }
+    return NULL;
+}
+
+void cml_addGPUTuning(cml_GPUProfile* profile, const cml_GPUTuning tuning) {
+    assert(profile != NULL);
+
+    cml_GPUTuning* existing = (cml_GPUTuning*)cml_findGPUTuning(*profile, tuning.rows, tuning.sharedDimension, tuning.columns);
+    if(existing != NULL) {
+        *existing = tuning;
+        return;
+    }
+    profile->tunings = (cml_GPUTuning*)realloc(profile->tunings, sizeof(cml_GPUTuning) * (profile->tuningCount + 1));
+    profile->tunings[profile->tuningCount++] = tuning;
+}
+
+// Device time of repetitions launches in nanoseconds, after one untimed launch
+// Returns a negative time if the launch fails, e.g. for a work-group size the device doesn't allow
+static double cml_timeKernel(cl_command_queue queue, cl_kernel kernel, const size_t* globalSize, const size_t* localSize, const size_t repetitions) {
+    if(clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSize, localSize, 0, NULL, NULL) != CL_SUCCESS ||
+       clFinish(queue) != CL_SUCCESS) {
+        return -1.0;
+    }
+
+    double time = 0.0;
+    for(size_t i = 0; i < repetitions; i++) {
+        cl_event event;
+        if(clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSize, localSize, 0, NULL, &event) != CL_SUCCESS) {
+            return -1.0;
+        }
+        cl_ulong start;
+        cl_ulong end;
+        bool timed = clWaitForEvents(1, &event) == CL_SUCCESS &&
+            clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS &&
+            clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS;
+        clReleaseEvent(event);
+        if(!timed) {
+            return -1.0;
+        }
+        time += (double)(end - start);
+    }
+    return time;
+}
+
+static cl_mem cml_createZeroedBuffer(cml_GPU* gpu, const float* zeros, const size_t count) {
+    cl_int error;
+    cl_mem buffer = clCreateBuffer(gpu->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, (void*)zeros, &error);
+    return error == CL_SUCCESS ? buffer : NULL;
+}
+
+cml_GPUTuning cml_tuneGPULayer(cml_GPU* gpu, const uint64 rows, const uint64 sharedDimension, const uint64 columns, const size_t repetitions) {
+    assert(gpu != NULL);
+    assert(rows > 0 && sharedDimension > 0 && columns > 0);
+    assert(repetitions > 0);
+
+    cml_GPUTuning tuning;
+    memset(&tuning, 0, sizeof(tuning));
+    cl_int error;
+    cl_command_queue queue = clCreateCommandQueue(gpu->context, gpu->gpu, CL_QUEUE_PROFILING_ENABLE, &error);
+    if(error != CL_SUCCESS) {
+        return tuning;
+    }
+
+    // output, input, weights and biases, zeros keep denormals and NaNs out of the timings
+    size_t counts[] = {rows * columns, rows * sharedDimension, sharedDimension * columns, columns};
+    size_t largestCount = 0;
+    for(size_t i = 0; i < 4; i++) {
+        largestCount = counts[i] > largestCount ? counts[i] : largestCount;
+    }
+    float* zeros = (float*)calloc(largestCount, sizeof(float));
+    cl_mem buffers[4];
+    bool success = true;
+    for(size_t i = 0; i < 4; i++) {
+        buffers[i] = cml_createZeroedBuffer(gpu, zeros, counts[i]);
+        success = success && buffers[i] != NULL;
+    }
+    free(zeros);
+
+    cl_int rowCount = (cl_int)rows;
+    cl_int sharedCount = (cl_int)sharedDimension;
+    cl_int columnCount = (cl_int)columns;
+    cl_kernel kernels[2] = {NULL, NULL};
+    if(success) {
+        kernels[0] = cml_createGPUKernelInstance(gpu, CML_MATRIX_DENSE_PROGRAM, "matrixDenseLinear");
+        if(columns % CML_MULTIPLY_TILE_WIDTH == 0) {
+            kernels[1] = cml_createGPUKernelInstance(gpu, CML_MATRIX_MULTIPLY_TILED_PROGRAM, "matrixMultiplyTiled");
+        }
+    }
+    // both kernels take (C, A, B, row, rows, sharedDimension, bCols)
+    for(size_t k = 0; k < 2; k++) {
+        if(kernels[k] == NULL) {
+            continue;
+        }
+        for(cl_uint i = 0; i < 4; i++) {
+            clSetKernelArg(kernels[k], i, sizeof(cl_mem), &buffers[i]);
+        }
+        clSetKernelArg(kernels[k], 4, sizeof(cl_int), &rowCount);
+        clSetKernelArg(kernels[k], 5, sizeof(cl_int), &sharedCount);
+        clSetKernelArg(kernels[k], 6, sizeof(cl_int), &columnCount);
+    }
+
+    double bestTime = -1.0;
+    size_t maxWorkGroupSize = 0;
+    if(kernels[0] != NULL &&
+       clGetKernelWorkGroupInfo(kernels[0], gpu->gpu, CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxWorkGroupSize), &maxWorkGroupSize, NULL) == CL_SUCCESS) {
+        for(size_t i = 0; i < sizeof(cml_denseLocalSizes) / sizeof(cml_denseLocalSizes[0]); i++) {
+            const size_t* localSize = cml_denseLocalSizes[i];
+            if(localSize[0] * localSize[1] > maxWorkGroupSize) {
+                continue;
+            }
+            size_t globalSize[2];
+            cml_getDenseWorkSize(rows, columns, localSize, globalSize);
+            double time = cml_timeKernel(queue, kernels[0], globalSize, localSize[0] != 0 ? localSize : NULL, repetitions);
+            if(time >= 0.0 && (bestTime < 0.0 || time < bestTime)) {
+                bestTime = time;
+                tuning.localSize[0] = localSize[0];
+                tuning.localSize[1] = localSize[1];
+            }
+        }
+    }
+    if(kernels[1] != NULL && cml_canRunTiledMatrixMultiply(gpu, kernels[1])) {
+        size_t globalSize[2];
+        size_t localSize[2];
+        cml_getTiledMatrixMultiplyWorkSize(rows, columns, globalSize, localSize);
+        double time = cml_timeKernel(queue, kernels[1], globalSize, localSize, repetitions);
+        if(time >= 0.0 && (bestTime < 0.0 || time < bestTime)) {
+            bestTime = time;
+            tuning.tiled = true;
+            tuning.localSize[0] = 0;
+            tuning.localSize[1] = 0;
+        }
+    }
+    if(bestTime >= 0.0) {
+        tuning.rows = rows;
+        tuning.sharedDimension = sharedDimension;
+        tuning.columns = columns;
+    }
+
+    for(size_t k = 0; k < 2; k++) {
+        if(kernels[k] != NULL) {
+            clReleaseKernel(kernels[k]);
+        }
+    }
+    for(size_t i = 0; i < 4; i++) {
+        if(buffers[i] != NULL) {
+            clReleaseMemObject(buffers[i]);
+        }
+    }
+    clReleaseCommandQueue(queue);
+    return tuning;
+}
+
+bool cml_tuneModelGPU(cml_GPUProfile* profile, cml_GPU* gpu, const cml_Model model, const size_t repetitions) {
+    assert(profile != NULL);
+    assert(gpu != NULL);
+
+    for(size_t i = 0; i < model.layerCount-1; i++) {
+        if(cml_findGPUTuning(*profile, model.scale, model.layerSizes[i], model.layerSizes[i+1]) != NULL) {
+            continue;
+        }
+        cml_GPUTuning tuning = cml_tuneGPULayer(gpu, model.scale, model.layerSizes[i], model.layerSizes[i+1], repetitions);
+        if(tuning.rows == 0) {
+            return false;
+        }
+        cml_addGPUTuning(profile, tuning);
+    }
+    return true;
+}
@@ -0,0 +1,122 @@
+#include <cml/HybridPredictor.h>
+#include <cml/util/Clock.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cml_HybridPredictor cml_emptyHybridPredictor() {
+    cml_HybridPredictor predictor;
+    memset(&predictor, 0, sizeof(predictor));
+    return predictor;
+}
+
+cml_HybridPredictor cml_createHybridPredictor(const cml_Model model, const cml_GPUModel boundModel) {
+    assert(model.data != NULL);
+    assert(boundModel.weights != NULL);
+    assert(model.scale == boundModel.scale);
+
+    cml_HybridPredictor predictor = cml_emptyHybridPredictor();
+    predictor.stream = cml_createGPUStream(boundModel, CML_GPU_STREAM_DEFAULT_SLOTS);
+    if(predictor.stream.slots == NULL) {
+        return predictor;
+    }
+    predictor.model = model;
+    predictor.threads = cml_createThreadPool(2);
+    predictor.cpuInput = (float*)malloc(sizeof(float) * model.scale * model.layerSizes[0]);
+    predictor.cpuOutput = (float*)malloc(sizeof(float) * model.scale * model.layerSizes[model.layerCount-1]);
+    return predictor;
+}
+
+void cml_deleteHybridPredictor(cml_HybridPredictor* predictor) {
+    assert(predictor != NULL);
+
+    if(predictor->stream.slots != NULL) {
+        cml_deleteGPUStream(&predictor->stream);
+    }
+    cml_deleteThreadPool(predictor->threads);
+    free(predictor->cpuInput);
+    free(predictor->cpuOutput);
+    *predictor = cml_emptyHybridPredictor();
+}
+
+size_t cml_getHybridGPURows(const cml_HybridPredictor predictor, const size_t rowCount) {
+    // rows per second of each side are the inverse of the times, so the device's share of them is
+    // cpu / (cpu + gpu) and both sides take the same time
+    double gpuShare = 0.5;
+    if(predictor.cpuSecondsPerRow > 0 && predictor.gpuSecondsPerRow > 0) {
+        gpuShare = predictor.cpuSecondsPerRow / (predictor.cpuSecondsPerRow + predictor.gpuSecondsPerRow);
+    }
+    // whole batches, the device would pad a partial one anyway
+    size_t scale = predictor.model.scale;
+    size_t gpuRows = (size_t)(gpuShare * (double)rowCount / (double)scale + 0.5) * scale;
+    return gpuRows < rowCount ? gpuRows : rowCount;
+}
+
+// A predict split in two, task 0 runs the device side and task 1 the CPU side
+typedef struct {
+    cml_HybridPredictor* predictor;
+    const float* in;
+    float* out;
+    size_t rowCount;
+    size_t gpuRows;
+    bool gpuSuccess;
+    double gpuSeconds;
+    double cpuSeconds;
+} cml_HybridBatch;
+
+static void cml_predictCPURows(cml_HybridPredictor* predictor, const float* in, float* out, const size_t rowCount) {
+    cml_Model model = predictor->model;
+    size_t inputSize = model.layerSizes[0];
+    size_t outputSize = model.layerSizes[model.layerCount-1];
+    // a batch of model.scale rows in and out, the last one is padded with zeros
+    for(size_t firstRow = 0; firstRow < rowCount; firstRow += model.scale) {
+        size_t rows = rowCount - firstRow < model.scale ? rowCount - firstRow : model.scale;
+        memcpy(predictor->cpuInput, in + firstRow * inputSize, sizeof(float) * rows * inputSize);
+        memset(predictor->cpuInput + rows * inputSize, 0, sizeof(float) * (model.scale - rows) * inputSize);
+        cml_predictCPU(model, predictor->cpuInput, predictor->cpuOutput);
+        memcpy(out + firstRow * outputSize, predictor->cpuOutput, sizeof(float) * rows * outputSize);
+    }
+}
+
+static void cml_runHybridSide(void* context, const size_t index) {
+    cml_HybridBatch* batch = (cml_HybridBatch*)context;
+    cml_HybridPredictor* predictor = batch->predictor;
+    double start = cml_getSeconds();
+    if(index == 0) {
+        batch->gpuSuccess = batch->gpuRows == 0 ||
+            cml_predictStreamGPU(&predictor->stream, batch->in, batch->out, batch->gpuRows);
+        batch->gpuSeconds = cml_getSeconds() - start;
+    } else {
+        cml_Model model = predictor->model;
+        size_t cpuRows = batch->rowCount - batch->gpuRows;
+        cml_predictCPURows(predictor,
+            batch->in + batch->gpuRows * model.layerSizes[0],
+            batch->out + batch->gpuRows * model.layerSizes[model.layerCount-1],
+            cpuRows);
+        batch->cpuSeconds = cml_getSeconds() - start;
+    }
+}
+
+bool cml_predictHybrid(cml_HybridPredictor* predictor, const float* in, float* out, const size_t rowCount) {
+    assert(predictor != NULL);
+    assert(predictor->threads != NULL);
+    assert(in != NULL);
+    assert(out != NULL);
+
+    cml_HybridBatch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.predictor = predictor;
+    batch.in = in;
+    batch.out = out;
+    batch.rowCount = rowCount;
+    batch.gpuRows = cml_getHybridGPURows(*predictor, rowCount);
+    cml_runTasks(predictor->threads, cml_runHybridSide, &batch, 2);
+
+    // a failed device says nothing about its speed
+    if(batch.gpuSuccess) {
+        cml_updateSecondsPerRow(&predictor->gpuSecondsPerRow, batch.gpuSeconds, batch.gpuRows);
+    }
+    cml_updateSecondsPerRow(&predictor->cpuSecondsPerRow, batch.cpuSeconds, rowCount - batch.gpuRows);
+    return batch.gpuSuccess;
+}
@@ -0,0 +1,17 @@
+#include <cml/KernelSources.h>
+
+#include <assert.h>
+#include <string.h>
+
+const char* cml_kernelSourceDirectory = NULL;
+
+const cml_KernelSource* cml_findKernelSource(const char* programFilename) {
+    assert(programFilename != NULL);
+
+    for(size_t i = 0; i < cml_kernelSourceCount; i++) {
+        if(strcmp(cml_kernelSources[i].filename, programFilename) == 0) {
+            return &cml_kernelSources[i];
+        }
+    }
+    return NULL;
+}
@@ -1,12 +1,23 @@
 #include <cml/Model.h>
-#include <cml/matrix/MatrixMathGPU.h>
+#include <cml/ModelFormat.h>
+#include <cml/GPUModel.h>
 #include <cml/matrix/MatrixMath.h>
+#include <cml/util/Crc32c.h>
 
 #include <assert.h>
+#include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+struct cml_ModelIntegrity {
+    const char* stored; // section bytes inside the mapping
+    uint64 size;
+    uint32 checksum;
+    bool checked;
+    bool intact;
+};
+
 static size_t cml_getDataCellCount(const cml_Model model) {
     size_t cellCount = 0;
     for(size_t i = 0; i < model.layerCount; i++) {
@@ -26,23 +37,10 @@ static size_t cml_getDataCellCount(const cml_Model model) {
     return cellCount;
 }
 
-static size_t cml_getModelDataSize(const cml_Model model) {
+size_t cml_getModelDataSize(const cml_Model model) {
     return sizeof(float) * cml_getDataCellCount(model);
 }
 
-static size_t cml_getModelSize(const cml_Model model) {
-    size_t sizeBytes = 0;
-    sizeBytes += cml_getModelDataSize(model); //data
-    sizeBytes += sizeof(uint64) * model.layerCount; // layerSizes
-    sizeBytes += sizeof(model.layerCount); // layerCount
-    sizeBytes += sizeof(model.scale); // scale
-    for(size_t i = 0; i < model.layerCount-1; i++) {
-        sizeBytes += cml_getActivationFnMetadataSize(model.activationFunctions[i]);
-    }
-    
-    return sizeBytes;
-}
-
 cml_Model cml_createModel(
     const size_t numOfLayers, 
     const uint64* layerSizes, 
@@ -63,6 +61,11 @@ cml_Model cml_createScaledModel(
     cml_Model model;
     model.scale = scale;
     model.layerCount = numOfLayers;
+    model.mapping.data = NULL;
+    model.mapping.size = 0;
+    model.mapping.offset = 0;
+    model.integrity = NULL;
+    model.lock = cml_createMutex();
 
     size_t layerSizesSize = sizeof(uint64) * numOfLayers;
     model.layerSizes = (uint64*)malloc(layerSizesSize);
@@ -87,7 +90,14 @@ void cml_deleteModel(cml_Model* model) {
     assert(model->layerSizes != NULL);
     assert(model->activationFunctions != NULL);
 
-    free(model->data);
+    if(model->mapping.size != 0) {
+        cml_unmapFile(&model->mapping);
+    }
+    else {
+        free(model->data);
+    }
+    free(model->integrity);
+    cml_deleteMutex(model->lock);
     free(model->layerSizes);
     for(size_t i = 0; i < model->layerCount-1; i++) {
         cml_deleteActivationFnMetadata(&model->activationFunctions[i]);
@@ -95,78 +105,577 @@ void cml_deleteModel(cml_Model* model) {
     free(model->activationFunctions);
 
     model->data = NULL;
+    model->integrity = NULL;
+    model->lock = NULL;
     model->layerSizes = NULL;
     model->layerCount = 0;
     model->scale = 1;
     model->activationFunctions = NULL;
 }
 
-cml_String cml_serializeModel(const cml_Model model) {
-    size_t dataSizeBytes = cml_getModelDataSize(model);
-    size_t modelSizeBytes = cml_getModelSize(model);
-    // header will consist of sizeof size_t
-    size_t headerSizeBytes = 1;
-    char* serializedModel = (char*)malloc(headerSizeBytes + modelSizeBytes);
-
-    // need to know sizeof size_t since other data uses this type
-    // the PC architecture deserializing may not align with PC architecture that serialized it
-    serializedModel[0] = (unsigned char)sizeof(size_t);
-
-    size_t offset = 1;
-    memcpy(serializedModel + offset, &model.layerCount, sizeof(size_t));
-    offset += sizeof(size_t);
-    memcpy(serializedModel + offset, &model.scale, sizeof(size_t));
-    offset += sizeof(size_t);
-    memcpy(serializedModel + offset, model.layerSizes, model.layerCount * sizeof(uint64));
-    offset += model.layerCount * sizeof(uint64);
+cml_Model cml_createEmptyModel() {
+    cml_Model model;
+    model.data = NULL;
+    model.layerSizes = NULL;
+    model.layerCount = 0;
+    model.scale = 1;
+    model.activationFunctions = NULL;
+    model.mapping.data = NULL;
+    model.mapping.size = 0;
+    model.mapping.offset = 0;
+    model.integrity = NULL;
+    model.lock = NULL;
+    return model;
+}
+
+cml_Model cml_copyModelWithScale(const cml_Model model, const size_t scale) {
+    cml_Model scaledModel = cml_createScaledModel(model.layerCount, model.layerSizes, scale, model.activationFunctions);
+
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    cml_ModelMatrices scaledMatrices = cml_getModelMatrices(scaledModel);
     for(size_t i = 0; i < model.layerCount-1; i++) {
-        cml_String serializedActivationFn = cml_serializeActivationFnMetadata(model.activationFunctions[i]);
-        memcpy(serializedModel + offset, serializedActivationFn.data, serializedActivationFn.size);
-        offset += serializedActivationFn.size;
-        cml_deleteString(&serializedActivationFn);
+        memcpy(scaledMatrices.weights[i].data, modelMatrices.weights[i].data, sizeof(float) * model.layerSizes[i] * model.layerSizes[i+1]);
+        memcpy(scaledMatrices.biases[i].data, modelMatrices.biases[i].data, sizeof(float) * model.layerSizes[i+1]);
+    }
+    cml_deleteModelMatrices(modelMatrices);
+    cml_deleteModelMatrices(scaledMatrices);
+
+    return scaledModel;
+}
+
+// Lays out the sections after the header and copies everything into one buffer
+static cml_String cml_serializeModelSections(const cml_Model model, cml_ModelSectionList sectionList) {
+    cml_ModelHeader header = cml_createModelHeader(model, sectionList.sections, sectionList.count);
+    size_t fileSizeBytes = cml_layoutModelSections(&header);
+
+    cml_String serializedModel = cml_createNewString(fileSizeBytes);
+    cml_writeModelHeader(header, serializedModel.data);
+
+    // zero the padding in front of each aligned section
+    size_t paddingStart = header.headerSize;
+    for(size_t i = 0; i < sectionList.count; i++) {
+        const cml_ModelSection* section = &sectionList.sections[i];
+        memset(serializedModel.data + paddingStart, 0, section->offset - paddingStart);
+        memcpy(serializedModel.data + section->offset, sectionList.sources[i], section->size);
+        paddingStart = section->offset + section->size;
+    }
+
+    return serializedModel;
+}
+
+cml_ModelSerializeOptions cml_createModelSerializeOptions() {
+    cml_ModelSerializeOptions options;
+    options.weightsOnly = false;
+    options.dataEncoding = CML_ENCODING_RAW;
+    options.weightsEncoding = CML_ENCODING_RAW;
+    options.biasesEncoding = CML_ENCODING_RAW;
+    return options;
+}
+
+cml_String cml_serializeModelWithOptions(const cml_Model model, const cml_ModelSerializeOptions options) {
+    cml_ModelSectionList sectionList = cml_createModelSectionList(model, options);
+    cml_String serializedModel = cml_serializeModelSections(model, sectionList);
+    cml_deleteModelSectionList(&sectionList);
+    return serializedModel;
+}
+
+cml_String cml_serializeModel(const cml_Model model) {
+    return cml_serializeModelWithOptions(model, cml_createModelSerializeOptions());
+}
+
+cml_String cml_serializeModelWeights(const cml_Model model) {
+    cml_ModelSerializeOptions options = cml_createModelSerializeOptions();
+    options.weightsOnly = true;
+    return cml_serializeModelWithOptions(model, options);
+}
+
+// Moves layerSizes and activationFunctions out of the header into a model, model.data is left as NULL
+static cml_Model cml_createModelLayoutFromHeader(cml_ModelHeader* header) {
+    cml_Model model = cml_createEmptyModel();
+    model.lock = cml_createMutex();
+    model.layerCount = header->layerCount;
+    model.scale = header->scale;
+    model.layerSizes = header->layerSizes;
+    model.activationFunctions = header->activationFunctions;
+    header->layerSizes = NULL;
+    header->activationFunctions = NULL;
+    return model;
+}
+
+// Frees the layout of a model that never got its data
+static void cml_deleteModelLayout(cml_Model* model) {
+    cml_deleteMutex(model->lock);
+    free(model->layerSizes);
+    for(size_t i = 0; i < model->layerCount-1; i++) {
+        cml_deleteActivationFnMetadata(&model->activationFunctions[i]);
+    }
+    free(model->activationFunctions);
+    *model = cml_createEmptyModel();
+}
+
+// Returns NULL if the section is missing, does not decode to expectedRawSize bytes or does not fit
+static const cml_ModelSection* cml_findSection(
+    const cml_ModelHeader header, 
+    const uint32 type, 
+    const uint64 layer, 
+    const size_t expectedRawSize, 
+    const size_t size) {
+
+    const cml_ModelSection* section = cml_findModelSection(header, type, layer);
+    if(section == NULL || !cml_isModelSectionUsable(*section, expectedRawSize, size)) {
+        return NULL;
+    }
+    return section;
+}
+
+// Creates a model of the given scale and copies in the weights and biases of a version 2 model,
+// taken from its weight and bias sections or out of its data section.
+// size is the number of bytes available in serializedModel
+// Returns a model with data == NULL if a section is missing, does not fit, is corrupt or does not decode
+static cml_Model cml_createModelFromSections(
+    const cml_ModelHeader header, 
+    const char* serializedModel, 
+    const size_t size, 
+    const size_t scale) {
+
+    cml_Model model = cml_createScaledModel(header.layerCount, header.layerSizes, scale, header.activationFunctions);
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    bool success = true;
+
+    // view over the stored data section, if there is one
+    cml_Model storedLayout = model;
+    storedLayout.scale = header.scale;
+    const cml_ModelSection* dataSection = cml_findSection(header, CML_SECTION_DATA, 0, cml_getModelDataSize(storedLayout), size);
+    char* decodedData = NULL;
+    cml_ModelMatrices storedMatrices;
+    if(dataSection != NULL) {
+        const char* stored = serializedModel + dataSection->offset;
+        success = cml_verifyModelSection(header, *dataSection, stored);
+        if(dataSection->encoding == CML_ENCODING_RAW) {
+            storedLayout.data = (float*)stored;
+        }
+        else {
+            decodedData = (char*)malloc(dataSection->rawSize);
+            success = success && cml_decodeModelSection(*dataSection, stored, decodedData);
+            storedLayout.data = (float*)decodedData;
+        }
+        storedMatrices = cml_getModelMatrices(storedLayout);
+    }
+
+    for(size_t i = 0; i < model.layerCount-1 && success; i++) {
+        size_t weightsSize = sizeof(float) * model.layerSizes[i] * model.layerSizes[i+1];
+        size_t biasesSize = sizeof(float) * model.layerSizes[i+1];
+        if(dataSection != NULL) {
+            memcpy(modelMatrices.weights[i].data, storedMatrices.weights[i].data, weightsSize);
+            memcpy(modelMatrices.biases[i].data, storedMatrices.biases[i].data, biasesSize);
+            continue;
+        }
+
+        const cml_ModelSection* weights = cml_findSection(header, CML_SECTION_WEIGHTS, i, weightsSize, size);
+        const cml_ModelSection* biases = cml_findSection(header, CML_SECTION_BIASES, i, biasesSize, size);
+        success = weights != NULL && biases != NULL &&
+            cml_verifyModelSection(header, *weights, serializedModel + weights->offset) &&
+            cml_verifyModelSection(header, *biases, serializedModel + biases->offset) &&
+            cml_decodeModelSection(*weights, serializedModel + weights->offset, (char*)modelMatrices.weights[i].data) &&
+            cml_decodeModelSection(*biases, serializedModel + biases->offset, (char*)modelMatrices.biases[i].data);
+    }
+
+    cml_deleteModelMatrices(modelMatrices);
+    if(dataSection != NULL) {
+        cml_deleteModelMatrices(storedMatrices);
+    }
+    free(decodedData);
+    if(!success) {
+        cml_deleteModel(&model);
+        return cml_createEmptyModel();
+    }
+    return model;
+}
+
+// Loads a version 2 model out of size readable bytes, a scale of 0 keeps the stored scale.
+// If file is not NULL it is the mapping holding serializedModel: a raw data section of the
+// right scale is then used in place and the model takes the mapping over (file is emptied).
+// verification only matters for such a section, everything else is checked while copying.
+static cml_Model cml_deserializeModelV2(
+    const char* serializedModel, 
+    const size_t size, 
+    size_t scale, 
+    cml_MappedFile* file, 
+    const uint32 verification) {
+
+    cml_ModelHeader header;
+    if(!cml_readModelHeader(serializedModel, size, &header)) {
+        return cml_createEmptyModel();
+    }
+    if(scale == 0) {
+        scale = header.scale;
+    }
+
+    // weights only files and rescaling go through the individual matrices
+    const cml_ModelSection* dataSection = cml_findModelSection(header, CML_SECTION_DATA, 0);
+    if(dataSection == NULL || header.scale != scale) {
+        cml_Model model = cml_createModelFromSections(header, serializedModel, size, scale);
+        cml_deleteModelHeader(&header);
+        return model;
+    }
+
+    cml_Model model = cml_createModelLayoutFromHeader(&header);
+    size_t modelDataSizeBytes = cml_getModelDataSize(model);
+    const char* stored = serializedModel + dataSection->offset;
+    bool success = cml_isModelSectionUsable(*dataSection, modelDataSizeBytes, size);
+    if(success && file != NULL && dataSection->encoding == CML_ENCODING_RAW) {
+        if(verification == CML_VERIFY_EAGER) {
+            success = cml_verifyModelSection(header, *dataSection, stored);
+        }
+        else if(verification == CML_VERIFY_LAZY && (header.flags & CML_MODEL_FLAG_CHECKSUMS) != 0) {
+            model.integrity = (cml_ModelIntegrity*)malloc(sizeof(cml_ModelIntegrity));
+            model.integrity->stored = stored;
+            model.integrity->size = dataSection->size;
+            model.integrity->checksum = (uint32)dataSection->checksum;
+            model.integrity->checked = false;
+            model.integrity->intact = false;
+        }
+        if(success) {
+            // zero copy, sections are aligned so the floats can be used in place
+            model.data = (float*)stored;
+            model.mapping = *file;
+            file->data = NULL;
+            file->size = 0;
+            file->offset = 0;
+        }
+    }
+    else if(success) {
+        model.data = (float*)malloc(modelDataSizeBytes);
+        success = cml_verifyModelSection(header, *dataSection, stored) &&
+            cml_decodeModelSection(*dataSection, stored, (char*)model.data);
+        if(!success) {
+            free(model.data);
+        }
     }
-    memcpy(serializedModel + offset, model.data, dataSizeBytes);
 
-    cml_String string = cml_createString(serializedModel, headerSizeBytes + modelSizeBytes);
-    return string;
+    cml_deleteModelHeader(&header);
+    if(!success) {
+        cml_deleteModelLayout(&model);
+        return cml_createEmptyModel();
+    }
+    return model;
+}
+
+// Version 1 counterpart of cml_deserializeModelV2, zero copy when file is given and the data block is float aligned
+static cml_Model cml_deserializeModelV1(const char* serializedModel, const size_t size, cml_MappedFile* file) {
+    cml_ModelHeader header;
+    if(!cml_readModelHeaderV1(serializedModel, size, &header)) {
+        return cml_createEmptyModel();
+    }
+    size_t offset = header.headerSize;
+    cml_Model model = cml_createModelLayoutFromHeader(&header);
+    cml_deleteModelHeader(&header);
+    size_t modelDataSizeBytes = cml_getModelDataSize(model);
+    if(size - offset < modelDataSizeBytes) {
+        cml_deleteModelLayout(&model);
+        return cml_createEmptyModel();
+    }
+
+    if(file != NULL && (offset % sizeof(float)) == 0) {
+        // zero copy, the mapping now belongs to the model
+        model.data = (float*)(serializedModel + offset);
+        model.mapping = *file;
+        file->data = NULL;
+        file->size = 0;
+        file->offset = 0;
+    }
+    else {
+        // version 1 files put the data block wherever the header ends, unaligned floats
+        // can't be used in place so copy straight from the page cache instead
+        model.data = (float*)malloc(modelDataSizeBytes);
+        memcpy(model.data, serializedModel + offset, modelDataSizeBytes);
+    }
+
+    return model;
+}
+
+static cml_Model cml_loadModel(const char* serializedModel, const size_t size, cml_MappedFile* file, const uint32 verification) {
+    if(cml_getModelFormatVersion(serializedModel, size) == CML_MODEL_FORMAT_VERSION) {
+        return cml_deserializeModelV2(serializedModel, size, 0, file, verification);
+    }
+    return cml_deserializeModelV1(serializedModel, size, file);
 }
 
 cml_Model cml_deserializeModel(const char* serializedModel) {
-    size_t layerCount;
-    uint64* layerSizes = NULL;
-    size_t scale;
-    cml_ActivationFnMetadata* activationFunctions = NULL;
-
-    uint8 sizeofSize_t = serializedModel[0];
-
-    size_t offset = 1;
-    memcpy(&layerCount, serializedModel + offset, sizeofSize_t);
-    offset += sizeofSize_t;
-    memcpy(&scale, serializedModel + offset, sizeofSize_t);
-    offset += sizeofSize_t;
-    size_t layerSizesBytes = sizeof(uint64) * layerCount;
-    layerSizes = (uint64*)malloc(layerSizesBytes);
-    memcpy(layerSizes, serializedModel + offset, layerSizesBytes);
-    offset += layerSizesBytes;
-    size_t activationFunctionsSizeBytes = sizeof(cml_ActivationFnMetadata) * layerCount-1;
-    activationFunctions = (cml_ActivationFnMetadata*)malloc(activationFunctionsSizeBytes);
-    for(size_t i = 0; i < layerCount-1; i++) {
-        activationFunctions[i] = cml_deserializeActivationFnMetadata(serializedModel + offset, sizeofSize_t);
-        offset += cml_getActivationFnMetadataSize(activationFunctions[i]);
-    }
-
-    cml_Model model = cml_createScaledModel(layerCount, layerSizes, scale, activationFunctions);
+    assert(serializedModel != NULL);
+
+    // the size of the blob is unknown, trust the header
+    return cml_loadModel(serializedModel, (size_t)-1, NULL, CML_VERIFY_EAGER);
+}
+
+cml_Model cml_deserializeModelFromBuffer(const char* serializedModel, const size_t size) {
+    assert(serializedModel != NULL);
+
+    return cml_loadModel(serializedModel, size, NULL, CML_VERIFY_EAGER);
+}
+
+cml_Model cml_deserializeScaledModel(const char* serializedModel, const size_t scale) {
+    assert(serializedModel != NULL);
+    assert(scale > 0);
+
+    if(cml_getModelFormatVersion(serializedModel, CML_MODEL_HEADER_PREFIX_SIZE) == CML_MODEL_FORMAT_VERSION) {
+        return cml_deserializeModelV2(serializedModel, (size_t)-1, scale, NULL, CML_VERIFY_EAGER);
+    }
+
+    cml_Model model = cml_deserializeModel(serializedModel);
+    if(model.scale != scale) {
+        cml_Model scaledModel = cml_copyModelWithScale(model, scale);
+        cml_deleteModel(&model);
+        return scaledModel;
+    }
+    return model;
+}
+
+cml_Model cml_createModelFromMapping(cml_MappedFile* file, const uint32 verification) {
+    assert(file != NULL);
+
+    if(file->data == NULL) {
+        return cml_createEmptyModel();
+    }
+    return cml_loadModel(file->data, file->size, file, verification);
+}
+
+cml_Model cml_mapModel(const char* filename) {
+    return cml_mapModelWithVerification(filename, CML_VERIFY_EAGER);
+}
+
+cml_Model cml_mapModelWithVerification(const char* filename, const uint32 verification) {
+    assert(filename != NULL);
+
+    cml_MappedFile file = cml_mapFile(filename);
+    cml_Model model = cml_createModelFromMapping(&file, verification);
+    // no-op if the model took the mapping over
+    cml_unmapFile(&file);
+    return model;
+}
+
+// Part of a section loaded by one task. Raw sections are split into pieces of
+// CML_MODEL_LOAD_CHUNK_SIZE bytes, encoded sections can only be decoded whole.
+typedef struct {
+    cml_ModelSection section;
+    const char* stored; // bytes of this piece in the file
+    char* destination;
+    size_t size;        // stored bytes in this piece
+    bool checksummed;   // the file has checksums
+    uint32 checksum;    // of the stored bytes, set by the task
+    bool decoded;       // set by the task
+} cml_ModelLoadPiece;
+
+static void cml_loadModelPiece(void* context, const size_t index) {
+    cml_ModelLoadPiece* piece = &((cml_ModelLoadPiece*)context)[index];
+    if(piece->checksummed) {
+        piece->checksum = cml_crc32c(0, piece->stored, piece->size);
+    }
+    if(piece->section.encoding == CML_ENCODING_RAW) {
+        // the first write to these pages comes from this thread, which places them on its node
+        memcpy(piece->destination, piece->stored, piece->size);
+        piece->decoded = true;
+    }
+    else {
+        piece->decoded = cml_decodeModelSection(piece->section, piece->stored, piece->destination);
+    }
+}
+
+// Returns the number of pieces added
+static size_t cml_addModelLoadPieces(
+    cml_ModelLoadPiece* pieces, 
+    const cml_ModelHeader header, 
+    const cml_ModelSection section, 
+    const char* serializedModel, 
+    char* destination) {
+
+    size_t pieceSize = section.encoding == CML_ENCODING_RAW ? CML_MODEL_LOAD_CHUNK_SIZE : section.size;
+    size_t count = 0;
+    size_t offset = 0;
+    do {
+        cml_ModelLoadPiece* piece = &pieces[count++];
+        piece->section = section;
+        piece->stored = serializedModel + section.offset + offset;
+        piece->destination = destination + offset;
+        piece->size = section.size - offset < pieceSize ? section.size - offset : pieceSize;
+        piece->checksummed = (header.flags & CML_MODEL_FLAG_CHECKSUMS) != 0;
+        piece->checksum = 0;
+        piece->decoded = false;
+        offset += piece->size;
+    } while(offset < section.size);
+    return count;
+}
+
+static size_t cml_getModelLoadPieceCount(const cml_ModelSection section) {
+    if(section.encoding != CML_ENCODING_RAW || section.size == 0) {
+        return 1;
+    }
+    return (section.size + CML_MODEL_LOAD_CHUNK_SIZE - 1) / CML_MODEL_LOAD_CHUNK_SIZE;
+}
+
+cml_Model cml_deserializeModelParallel(const char* serializedModel, const size_t size, cml_ThreadPool* pool) {
+    assert(serializedModel != NULL);
+    assert(pool != NULL);
+
+    if(cml_getModelFormatVersion(serializedModel, size) != CML_MODEL_FORMAT_VERSION) {
+        // a single block and no checksums, nothing to split
+        return cml_deserializeModelFromBuffer(serializedModel, size);
+    }
+
+    cml_ModelHeader header;
+    if(!cml_readModelHeader(serializedModel, size, &header)) {
+        return cml_createEmptyModel();
+    }
+    cml_Model model = cml_createModelLayoutFromHeader(&header);
     size_t modelDataSizeBytes = cml_getModelDataSize(model);
-    memcpy(model.data, serializedModel + offset, modelDataSizeBytes);
+    // left untouched here, the tasks are the first to write each page
+    model.data = (float*)malloc(modelDataSizeBytes);
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+
+    // the data section, or the weight and bias sections of every layer
+    size_t sectionCount = 0;
+    const cml_ModelSection** sections = (const cml_ModelSection**)malloc(sizeof(cml_ModelSection*) * 2 * model.layerCount);
+    char** destinations = (char**)malloc(sizeof(char*) * 2 * model.layerCount);
+    bool success = true;
+    const cml_ModelSection* dataSection = cml_findSection(header, CML_SECTION_DATA, 0, modelDataSizeBytes, size);
+    if(dataSection != NULL) {
+        sections[sectionCount] = dataSection;
+        destinations[sectionCount++] = (char*)model.data;
+    }
+    for(size_t i = 0; i < model.layerCount-1 && dataSection == NULL && success; i++) {
+        // weights only, activations start out zeroed like in cml_createScaledModel
+        memset(modelMatrices.activationInputs[i+1].data, 0, sizeof(float) * model.scale * model.layerSizes[i+1]);
+        memset(modelMatrices.activationOutputs[i].data, 0, sizeof(float) * model.scale * model.layerSizes[i+1]);
+
+        size_t weightsSize = sizeof(float) * model.layerSizes[i] * model.layerSizes[i+1];
+        size_t biasesSize = sizeof(float) * model.layerSizes[i+1];
+        sections[sectionCount] = cml_findSection(header, CML_SECTION_WEIGHTS, i, weightsSize, size);
+        destinations[sectionCount++] = (char*)modelMatrices.weights[i].data;
+        sections[sectionCount] = cml_findSection(header, CML_SECTION_BIASES, i, biasesSize, size);
+        destinations[sectionCount++] = (char*)modelMatrices.biases[i].data;
+        success = sections[sectionCount-2] != NULL && sections[sectionCount-1] != NULL;
+    }
+    if(dataSection == NULL) {
+        memset(modelMatrices.activationInputs[0].data, 0, sizeof(float) * model.scale * model.layerSizes[0]);
+    }
+
+    size_t pieceCount = 0;
+    for(size_t i = 0; i < sectionCount && success; i++) {
+        pieceCount += cml_getModelLoadPieceCount(*sections[i]);
+    }
+    cml_ModelLoadPiece* pieces = (cml_ModelLoadPiece*)malloc(sizeof(cml_ModelLoadPiece) * (pieceCount > 0 ? pieceCount : 1));
+    if(success) {
+        size_t pieceOffset = 0;
+        for(size_t i = 0; i < sectionCount; i++) {
+            pieceOffset += cml_addModelLoadPieces(pieces + pieceOffset, header, *sections[i], serializedModel, destinations[i]);
+        }
+        cml_runTasks(pool, cml_loadModelPiece, pieces, pieceCount);
+    }
+
+    // stitch the checksums of the pieces of each section back together
+    size_t pieceIndex = 0;
+    for(size_t i = 0; i < sectionCount && success; i++) {
+        uint32 checksum = 0;
+        size_t sectionPieceCount = cml_getModelLoadPieceCount(*sections[i]);
+        for(size_t j = 0; j < sectionPieceCount; j++, pieceIndex++) {
+            checksum = cml_crc32cCombine(checksum, pieces[pieceIndex].checksum, pieces[pieceIndex].size);
+            success = success && pieces[pieceIndex].decoded;
+        }
+        success = success && ((header.flags & CML_MODEL_FLAG_CHECKSUMS) == 0 || checksum == sections[i]->checksum);
+    }
+
+    free(pieces);
+    free(sections);
+    free(destinations);
+    cml_deleteModelMatrices(modelMatrices);
+    cml_deleteModelHeader(&header);
+    if(!success) {
+        cml_deleteModel(&model);
+        return cml_createEmptyModel();
+    }
+    return model;
+}
+
+cml_Model cml_loadModelParallel(const char* filename, cml_ThreadPool* pool) {
+    assert(filename != NULL);
 
+    cml_MappedFile file = cml_mapFile(filename);
+    if(file.data == NULL) {
+        return cml_createEmptyModel();
+    }
+    cml_Model model = cml_deserializeModelParallel(file.data, file.size, pool);
+    cml_unmapFile(&file);
     return model;
 }
 
+bool cml_upgradeModelFile(const char* inputFilename, const char* outputFilename) {
+    assert(inputFilename != NULL);
+    assert(outputFilename != NULL);
+
+    cml_Model model = cml_mapModel(inputFilename);
+    if(model.data == NULL) {
+        return false;
+    }
+    cml_String serializedModel = cml_serializeModel(model);
+    // unmap before writing, input and output are allowed to be the same file
+    cml_deleteModel(&model);
+
+    // written next to the output and renamed over it, so a failed write never costs the only copy of the model
+    size_t temporarySize = strlen(outputFilename) + 5;
+    char* temporaryFilename = (char*)malloc(temporarySize);
+    snprintf(temporaryFilename, temporarySize, "%s.tmp", outputFilename);
+    FILE* file = fopen(temporaryFilename, "wb");
+    bool success = file != NULL;
+    if(success) {
+        success = fwrite(serializedModel.data, 1, serializedModel.size, file) == serializedModel.size;
+        success = fclose(file) == 0 && success;
+    }
+    cml_deleteString(&serializedModel);
+
+    if(success && rename(temporaryFilename, outputFilename) != 0) {
+        // rename does not replace an existing file everywhere
+        remove(outputFilename);
+        success = rename(temporaryFilename, outputFilename) == 0;
+    }
+    if(!success) {
+        remove(temporaryFilename);
+    }
+    free(temporaryFilename);
+    return success;
+}
+
+// cml_verifyModel for callers already holding model.lock
+static bool cml_verifyModelLocked(const cml_Model model) {
+    cml_ModelIntegrity* integrity = model.integrity;
+    if(integrity == NULL) {
+        return true;
+    }
+    if(!integrity->checked) {
+        integrity->intact = cml_crc32c(0, integrity->stored, integrity->size) == integrity->checksum;
+        integrity->checked = true;
+    }
+    return integrity->intact;
+}
+
+bool cml_verifyModel(const cml_Model model) {
+    cml_lockMutex(model.lock);
+    bool intact = cml_verifyModelLocked(model);
+    cml_unlockMutex(model.lock);
+    return intact;
+}
+
+// Poisons the output so a corrupt model never yields plausible predictions
+static void cml_predictCorruptOutput(const cml_Model model, float* out) {
+    size_t outputCellCount = model.layerSizes[model.layerCount-1] * model.scale;
+    for(size_t i = 0; i < outputCellCount; i++) {
+        out[i] = NAN;
+    }
+}
+
 static void cml_predictCopyInput(const cml_Model model, float* in) {
     // Copy over the input
     size_t inputCellCount = model.layerSizes[0] * model.scale;
     memcpy(model.data, in, inputCellCount * sizeof(float));
-    printf("input to model: %g %g %g\n", model.data[0], model.data[1], model.data[2]);
 }
 
 static void cml_predictCopyOutput(const cml_Model model, float* out) {
@@ -178,6 +687,13 @@ static void cml_predictCopyOutput(const cml_Model model, float* out) {
 }
 
 void cml_predictCPU(const cml_Model model, float* in, float* out) {
+    cml_lockMutex(model.lock);
+    if(!cml_verifyModelLocked(model)) {
+        cml_predictCorruptOutput(model, out);
+        cml_unlockMutex(model.lock);
+        return;
+    }
+
     // Copy over the input
     cml_predictCopyInput(model, in);
 
@@ -187,9 +703,7 @@ void cml_predictCPU(const cml_Model model, float* in, float* out) {
     for(size_t i = 0; i < model.layerCount-1; i++) {
         cml_Matrix* layerInputMatrix = (i == 0)? &modelMatrices.activationInputs[i] : &modelMatrices.activationOutputs[i-1];
         cml_matrixMultiply(*layerInputMatrix, modelMatrices.weights[i], &modelMatrices.activationInputs[i+1]);
-        printf("layer 2 pre bias: %g %g\n", modelMatrices.activationInputs[i+1].data[0], modelMatrices.activationInputs[i+1].data[1]);
         cml_matrixAddRow(modelMatrices.activationInputs[i+1], modelMatrices.biases[i], &modelMatrices.activationInputs[i+1]);
-        printf("layer 2 post bias: %g %g\n", modelMatrices.activationInputs[i+1].data[0], modelMatrices.activationInputs[i+1].data[1]);
         cml_ActivationFunction activation = cml_getActivation(model.activationFunctions[i].activationID);
         activation.function(&modelMatrices.activationInputs[i+1], &modelMatrices.activationOutputs[i]);
     }
@@ -199,45 +713,19 @@ void cml_predictCPU(const cml_Model model, float* in, float* out) {
 
     // Copy over the output
     cml_predictCopyOutput(model, out);
+    cml_unlockMutex(model.lock);
 }
 
-
-void _printMatrix(const cml_Matrix* matrix) {
-    for(size_t row = 0; row < matrix->rows; row++) {
-        for(size_t col = 0; col < matrix->cols; col++) {
-            printf("%0.4f ", matrix->data[row * matrix->cols + col]);
-        }
-        printf("\n");
-    }
-    printf("\n");
-}
 void cml_predictGPU(const cml_Model model, float* in, float* out, const cml_GPU gpu) {
-    // Copy over the input
-    cml_predictCopyInput(model, in);
-
-    // Run model calculation
-    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
-
-    for(size_t i = 0; i < model.layerCount-1; i++) {
-        cml_Matrix* layerInputMatrix = (i == 0)? &modelMatrices.activationInputs[i] : &modelMatrices.activationOutputs[i-1];
-        printf("pre cml_matrixMultiplyGPU\n");
-        _printMatrix(layerInputMatrix);
-        _printMatrix(&modelMatrices.weights[i]);
-        _printMatrix(&modelMatrices.activationInputs[i+1]);
-        cml_matrixMultiplyGPU(&gpu, layerInputMatrix, &modelMatrices.weights[i], &modelMatrices.activationInputs[i+1]);
-        _printMatrix(&modelMatrices.activationInputs[i+1]);
-        printf("layer 2 pre bias: %g %g\n", modelMatrices.activationInputs[i+1].data[0], modelMatrices.activationInputs[i+1].data[1]);
-        cml_matrixAddRowGPU(&gpu, modelMatrices.activationInputs[i+1], modelMatrices.biases[i], &modelMatrices.activationInputs[i+1]);
-        printf("layer 2 post bias: %g %g\n", modelMatrices.activationInputs[i+1].data[0], modelMatrices.activationInputs[i+1].data[1]);
-        cml_ActivationFunction activation = cml_getActivation(model.activationFunctions[i].activationID);
-        activation.function(&modelMatrices.activationInputs[i+1], &modelMatrices.activationOutputs[i]);
+    // kernels only come from the programs gpu has loaded, so the copy is never added to and no call builds one
+    cml_GPU deviceGPU = gpu;
+    cml_GPUBindOptions options = cml_createGPUBindOptions();
+    options.loadedKernelsOnly = true;
+    cml_GPUModel boundModel = cml_bindModelGPUWithOptions(model, &deviceGPU, options);
+    if(boundModel.weights == NULL || !cml_predictBoundModelGPU(boundModel, in, out)) {
+        cml_predictCorruptOutput(model, out);
     }
-
-    // Clean up modelMatrices pointers
-    cml_deleteModelMatrices(modelMatrices);
-
-    // Copy over the output
-    cml_predictCopyOutput(model, out);
+    cml_unbindModelGPU(&boundModel);
 }
 
 // TODO Refactor to treat layer 1 as outputs instead of inputs, will affect cml_predict
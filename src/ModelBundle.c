@@ -0,0 +1,273 @@
+#include <cml/ModelBundle.h>
+#include <cml/ModelFormat.h>
+#include <cml/util/Endian.h>
+#include <cml/util/MappedFile.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sanity limit when opening, a corrupt headerSize should not turn into a huge allocation
+#define CML_BUNDLE_MAX_HEADER_SIZE 0x4000000
+// nameSize, offset and size
+#define CML_BUNDLE_ENTRY_FIXED_SIZE 24
+
+static const char cml_bundlePadding[CML_MODEL_SECTION_ALIGNMENT] = {0};
+
+typedef struct {
+    const char* name;
+    size_t index; // into the models given to cml_writeModelBundle
+} cml_BundleItem;
+
+static int cml_compareBundleItems(const void* a, const void* b) {
+    return strcmp(((const cml_BundleItem*)a)->name, ((const cml_BundleItem*)b)->name);
+}
+
+static int cml_compareBundleEntries(const void* name, const void* entry) {
+    return strcmp((const char*)name, ((const cml_ModelBundleEntry*)entry)->name);
+}
+
+static size_t cml_alignBundleOffset(const size_t offset) {
+    return (offset + CML_MODEL_SECTION_ALIGNMENT - 1) / CML_MODEL_SECTION_ALIGNMENT * CML_MODEL_SECTION_ALIGNMENT;
+}
+
+static cml_ModelBundle cml_emptyModelBundle() {
+    cml_ModelBundle bundle;
+    bundle.filename = NULL;
+    bundle.entries = NULL;
+    bundle.entryCount = 0;
+    return bundle;
+}
+
+bool cml_writeModelBundle(const char* filename, const char* const* names, const cml_Model* models, const size_t count) {
+    assert(filename != NULL);
+    assert(names != NULL || count == 0);
+    assert(models != NULL || count == 0);
+
+    cml_BundleItem* items = (cml_BundleItem*)malloc(sizeof(cml_BundleItem) * (count > 0 ? count : 1));
+    size_t unpaddedHeaderSize = CML_BUNDLE_HEADER_PREFIX_SIZE;
+    for(size_t i = 0; i < count; i++) {
+        items[i].name = names[i];
+        items[i].index = i;
+        unpaddedHeaderSize += CML_BUNDLE_ENTRY_FIXED_SIZE + strlen(names[i]);
+    }
+    qsort(items, count, sizeof(cml_BundleItem), cml_compareBundleItems);
+    for(size_t i = 1; i < count; i++) {
+        if(strcmp(items[i-1].name, items[i].name) == 0) {
+            free(items);
+            return false;
+        }
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if(file == NULL) {
+        free(items);
+        return false;
+    }
+
+    // the index is written last, once every offset is known
+    size_t headerSize = cml_alignBundleOffset(unpaddedHeaderSize);
+    char* header = (char*)calloc(headerSize, 1);
+    bool success = fwrite(header, 1, headerSize, file) == headerSize;
+
+    memcpy(header, CML_BUNDLE_MAGIC, CML_BUNDLE_MAGIC_SIZE);
+    cml_writeUint32LE(header + 8, CML_BUNDLE_FORMAT_VERSION);
+    cml_writeUint32LE(header + 12, 0);
+    cml_writeUint64LE(header + 16, headerSize);
+    cml_writeUint64LE(header + 24, count);
+
+    // one serialized model in memory at a time
+    size_t offset = headerSize;
+    size_t indexOffset = CML_BUNDLE_HEADER_PREFIX_SIZE;
+    for(size_t i = 0; i < count && success; i++) {
+        cml_String serializedModel = cml_serializeModel(models[items[i].index]);
+        size_t paddingSize = cml_alignBundleOffset(serializedModel.size) - serializedModel.size;
+        success = fwrite(serializedModel.data, 1, serializedModel.size, file) == serializedModel.size &&
+            fwrite(cml_bundlePadding, 1, paddingSize, file) == paddingSize;
+
+        size_t nameSize = strlen(items[i].name);
+        cml_writeUint64LE(header + indexOffset, nameSize);
+        memcpy(header + indexOffset + 8, items[i].name, nameSize);
+        cml_writeUint64LE(header + indexOffset + 8 + nameSize, offset);
+        cml_writeUint64LE(header + indexOffset + 16 + nameSize, serializedModel.size);
+        indexOffset += CML_BUNDLE_ENTRY_FIXED_SIZE + nameSize;
+        offset += serializedModel.size + paddingSize;
+
+        cml_deleteString(&serializedModel);
+    }
+
+    success = success && fseek(file, 0, SEEK_SET) == 0 && fwrite(header, 1, headerSize, file) == headerSize;
+    success = fclose(file) == 0 && success;
+
+    free(header);
+    free(items);
+    return success;
+}
+
+// Fills in the entries from the index part of the header
+// Returns false if an entry runs past the header or the names are not sorted and unique
+static bool cml_readBundleIndex(const char* header, const size_t headerSize, cml_ModelBundle* bundle) {
+    size_t offset = CML_BUNDLE_HEADER_PREFIX_SIZE;
+    for(size_t i = 0; i < bundle->entryCount; i++) {
+        if(headerSize - offset < CML_BUNDLE_ENTRY_FIXED_SIZE) {
+            return false;
+        }
+        uint64 nameSize = cml_readUint64LE(header + offset);
+        if(nameSize > headerSize - offset - CML_BUNDLE_ENTRY_FIXED_SIZE) {
+            return false;
+        }
+
+        cml_ModelBundleEntry* entry = &bundle->entries[i];
+        entry->name = (char*)malloc(nameSize + 1);
+        memcpy(entry->name, header + offset + 8, nameSize);
+        entry->name[nameSize] = '\0';
+        entry->offset = cml_readUint64LE(header + offset + 8 + nameSize);
+        entry->size = cml_readUint64LE(header + offset + 16 + nameSize);
+        offset += CML_BUNDLE_ENTRY_FIXED_SIZE + nameSize;
+
+        if(i > 0 && strcmp(bundle->entries[i-1].name, entry->name) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+cml_ModelBundle cml_openModelBundle(const char* filename) {
+    assert(filename != NULL);
+
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        return cml_emptyModelBundle();
+    }
+
+    char prefix[CML_BUNDLE_HEADER_PREFIX_SIZE];
+    if(fread(prefix, 1, sizeof(prefix), file) != sizeof(prefix) ||
+       memcmp(prefix, CML_BUNDLE_MAGIC, CML_BUNDLE_MAGIC_SIZE) != 0 ||
+       cml_readUint32LE(prefix + 8) != CML_BUNDLE_FORMAT_VERSION) {
+        fclose(file);
+        return cml_emptyModelBundle();
+    }
+
+    uint64 headerSize = cml_readUint64LE(prefix + 16);
+    uint64 entryCount = cml_readUint64LE(prefix + 24);
+    if(headerSize < CML_BUNDLE_HEADER_PREFIX_SIZE || headerSize > CML_BUNDLE_MAX_HEADER_SIZE ||
+       entryCount > (headerSize - CML_BUNDLE_HEADER_PREFIX_SIZE) / CML_BUNDLE_ENTRY_FIXED_SIZE) {
+        fclose(file);
+        return cml_emptyModelBundle();
+    }
+
+    char* header = (char*)malloc(headerSize);
+    memcpy(header, prefix, sizeof(prefix));
+    size_t remainingSize = headerSize - sizeof(prefix);
+    bool success = fread(header + sizeof(prefix), 1, remainingSize, file) == remainingSize;
+    fclose(file);
+
+    cml_ModelBundle bundle = cml_emptyModelBundle();
+    bundle.entryCount = entryCount;
+    bundle.entries = (cml_ModelBundleEntry*)calloc(entryCount > 0 ? entryCount : 1, sizeof(cml_ModelBundleEntry));
+    success = success && cml_readBundleIndex(header, headerSize, &bundle);
+    free(header);
+
+    size_t filenameSize = strlen(filename) + 1;
+    bundle.filename = (char*)malloc(filenameSize);
+    memcpy(bundle.filename, filename, filenameSize);
+    if(!success) {
+        cml_closeModelBundle(&bundle);
+    }
+    return bundle;
+}
+
+void cml_closeModelBundle(cml_ModelBundle* bundle) {
+    assert(bundle != NULL);
+
+    // entries that were never read have a NULL name
+    for(size_t i = 0; i < bundle->entryCount; i++) {
+        free(bundle->entries[i].name);
+    }
+    free(bundle->entries);
+    free(bundle->filename);
+    *bundle = cml_emptyModelBundle();
+}
+
+const cml_ModelBundleEntry* cml_findBundleEntry(const cml_ModelBundle bundle, const char* name) {
+    assert(name != NULL);
+
+    if(bundle.entryCount == 0) {
+        return NULL;
+    }
+    return (const cml_ModelBundleEntry*)bsearch(name, bundle.entries, bundle.entryCount, sizeof(cml_ModelBundleEntry), cml_compareBundleEntries);
+}
+
+cml_Model cml_loadBundleModel(const cml_ModelBundle bundle, const char* name) {
+    assert(bundle.filename != NULL);
+
+    const cml_ModelBundleEntry* entry = cml_findBundleEntry(bundle, name);
+    if(entry == NULL) {
+        return cml_createEmptyModel();
+    }
+
+    // copy straight out of the page cache instead of reading into a buffer first
+    cml_MappedFile file = cml_mapFileRange(bundle.filename, entry->offset, entry->size);
+    if(file.data == NULL) {
+        return cml_createEmptyModel();
+    }
+    cml_Model model = cml_deserializeModelFromBuffer(file.data, file.size);
+    cml_unmapFile(&file);
+    return model;
+}
+
+cml_Model cml_mapBundleModel(const cml_ModelBundle bundle, const char* name, const uint32 verification) {
+    assert(bundle.filename != NULL);
+
+    const cml_ModelBundleEntry* entry = cml_findBundleEntry(bundle, name);
+    if(entry == NULL) {
+        return cml_createEmptyModel();
+    }
+
+    cml_MappedFile file = cml_mapFileRange(bundle.filename, entry->offset, entry->size);
+    cml_Model model = cml_createModelFromMapping(&file, verification);
+    // no-op if the model took the mapping over
+    cml_unmapFile(&file);
+    return model;
+}
+
+typedef struct {
+    const cml_ModelBundle* bundle;
+    uint32 verification;
+    cml_Model* models;
+} cml_BundleMapTasks;
+
+static void cml_mapBundleModelTask(void* context, const size_t index) {
+    cml_BundleMapTasks* tasks = (cml_BundleMapTasks*)context;
+    tasks->models[index] = cml_mapBundleModel(*tasks->bundle, tasks->bundle->entries[index].name, tasks->verification);
+}
+
+bool cml_mapBundleModels(const cml_ModelBundle bundle, const uint32 verification, cml_ThreadPool* pool, cml_Model* models) {
+    assert(bundle.filename != NULL);
+    assert(models != NULL || bundle.entryCount == 0);
+
+    cml_BundleMapTasks tasks;
+    tasks.bundle = &bundle;
+    tasks.verification = verification;
+    tasks.models = models;
+    if(pool != NULL) {
+        cml_runTasks(pool, cml_mapBundleModelTask, &tasks, bundle.entryCount);
+    }
+    else {
+        for(size_t i = 0; i < bundle.entryCount; i++) {
+            cml_mapBundleModelTask(&tasks, i);
+        }
+    }
+
+    bool success = true;
+    for(size_t i = 0; i < bundle.entryCount; i++) {
+        success = success && models[i].data != NULL;
+    }
+    for(size_t i = 0; i < bundle.entryCount && !success; i++) {
+        if(models[i].data != NULL) {
+            cml_deleteModel(&models[i]);
+        }
+    }
+    return success;
+}
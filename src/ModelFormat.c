@@ -0,0 +1,401 @@
+#include <cml/ModelFormat.h>
+#include <cml/util/Compression.h>
+#include <cml/util/Crc32c.h>
+#include <cml/util/Endian.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t cml_alignSectionOffset(const size_t offset) {
+    return (offset + CML_MODEL_SECTION_ALIGNMENT - 1) / CML_MODEL_SECTION_ALIGNMENT * CML_MODEL_SECTION_ALIGNMENT;
+}
+
+static size_t cml_getSerializedMetadataSize(const cml_ActivationFnMetadata metadata) {
+    return 8 + metadata.gpuProgramFilename.size + 8 + metadata.gpuKernelName.size + 1;
+}
+
+// Size of everything in the header except the padding
+static size_t cml_getUnpaddedHeaderSize(const cml_ModelHeader header) {
+    size_t sizeBytes = CML_MODEL_HEADER_PREFIX_SIZE;
+    sizeBytes += 8 * header.layerCount;
+    sizeBytes += CML_MODEL_SECTION_ENTRY_SIZE * header.sectionCount;
+    for(size_t i = 0; i < header.layerCount-1; i++) {
+        sizeBytes += cml_getSerializedMetadataSize(header.activationFunctions[i]);
+    }
+    return sizeBytes;
+}
+
+uint32 cml_getModelFormatVersion(const char* serializedModel, const size_t size) {
+    assert(serializedModel != NULL);
+
+    if(size >= CML_MODEL_MAGIC_SIZE + 4 && memcmp(serializedModel, CML_MODEL_MAGIC, CML_MODEL_MAGIC_SIZE) == 0) {
+        return cml_readUint32LE(serializedModel + CML_MODEL_MAGIC_SIZE);
+    }
+    return 1;
+}
+
+cml_ModelHeader cml_createModelHeader(const cml_Model model, cml_ModelSection* sections, const size_t sectionCount) {
+    cml_ModelHeader header;
+    header.version = CML_MODEL_FORMAT_VERSION;
+    header.flags = CML_MODEL_FLAG_CHECKSUMS;
+    header.headerSize = 0;
+    header.layerCount = model.layerCount;
+    header.scale = model.scale;
+    header.layerSizes = model.layerSizes;
+    header.activationFunctions = model.activationFunctions;
+    header.sectionCount = sectionCount;
+    header.sections = sections;
+    return header;
+}
+
+size_t cml_layoutModelSections(cml_ModelHeader* header) {
+    assert(header != NULL);
+
+    header->headerSize = cml_alignSectionOffset(cml_getUnpaddedHeaderSize(*header));
+
+    size_t offset = header->headerSize;
+    for(size_t i = 0; i < header->sectionCount; i++) {
+        offset = cml_alignSectionOffset(offset);
+        header->sections[i].offset = offset;
+        offset += header->sections[i].size;
+    }
+
+    return offset;
+}
+
+cml_ModelSection cml_createRawSection(const uint32 type, const uint64 layer, const size_t size) {
+    cml_ModelSection section;
+    section.type = type;
+    section.encoding = CML_ENCODING_RAW;
+    section.layer = layer;
+    section.offset = 0;
+    section.size = size;
+    section.rawSize = size;
+    section.checksum = 0;
+    return section;
+}
+
+// Encodes a raw section into a copy that replaces its source, then checksums what gets stored
+static void cml_storeModelSection(cml_ModelSectionList* sectionList, const size_t index, const uint32 encoding) {
+    cml_ModelSection* section = &sectionList->sections[index];
+    if(encoding != CML_ENCODING_RAW) {
+        assert(encoding == CML_ENCODING_SHUFFLE_LZ);
+
+        char* encoded = (char*)malloc(cml_getMaxCompressedSize(section->rawSize));
+        section->size = cml_compressFloats(sectionList->sources[index], section->rawSize, encoded);
+        section->encoding = encoding;
+        sectionList->encoded[index] = encoded;
+        sectionList->sources[index] = encoded;
+    }
+    section->checksum = cml_crc32c(0, sectionList->sources[index], section->size);
+}
+
+cml_ModelSectionList cml_createModelSectionList(const cml_Model model, const cml_ModelSerializeOptions options) {
+    cml_ModelSectionList sectionList;
+    sectionList.count = options.weightsOnly ? 2 * (model.layerCount-1) : 1;
+    sectionList.sections = (cml_ModelSection*)malloc(sizeof(cml_ModelSection) * sectionList.count);
+    sectionList.sources = (const char**)malloc(sizeof(const char*) * sectionList.count);
+    sectionList.encoded = (char**)calloc(sectionList.count, sizeof(char*));
+
+    if(!options.weightsOnly) {
+        sectionList.sections[0] = cml_createRawSection(CML_SECTION_DATA, 0, cml_getModelDataSize(model));
+        sectionList.sources[0] = (const char*)model.data;
+        cml_storeModelSection(&sectionList, 0, options.dataEncoding);
+        return sectionList;
+    }
+
+    // weights and biases of each layer after the first, in that order
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    for(size_t i = 0; i < model.layerCount-1; i++) {
+        size_t weightsSize = sizeof(float) * model.layerSizes[i] * model.layerSizes[i+1];
+        size_t biasesSize = sizeof(float) * model.layerSizes[i+1];
+        sectionList.sections[2*i] = cml_createRawSection(CML_SECTION_WEIGHTS, i, weightsSize);
+        sectionList.sources[2*i] = (const char*)modelMatrices.weights[i].data;
+        cml_storeModelSection(&sectionList, 2*i, options.weightsEncoding);
+        sectionList.sections[2*i+1] = cml_createRawSection(CML_SECTION_BIASES, i, biasesSize);
+        sectionList.sources[2*i+1] = (const char*)modelMatrices.biases[i].data;
+        cml_storeModelSection(&sectionList, 2*i+1, options.biasesEncoding);
+    }
+    cml_deleteModelMatrices(modelMatrices);
+
+    return sectionList;
+}
+
+void cml_deleteModelSectionList(cml_ModelSectionList* sectionList) {
+    assert(sectionList != NULL);
+
+    for(size_t i = 0; i < sectionList->count; i++) {
+        free(sectionList->encoded[i]);
+    }
+    free(sectionList->sections);
+    free(sectionList->sources);
+    free(sectionList->encoded);
+    sectionList->sections = NULL;
+    sectionList->sources = NULL;
+    sectionList->encoded = NULL;
+    sectionList->count = 0;
+}
+
+bool cml_isModelSectionUsable(const cml_ModelSection section, const size_t expectedRawSize, const size_t size) {
+    bool knownEncoding = 
+        (section.encoding == CML_ENCODING_RAW && section.size == section.rawSize) ||
+        (section.encoding == CML_ENCODING_SHUFFLE_LZ && section.size <= cml_getMaxCompressedSize(section.rawSize));
+    return knownEncoding &&
+        section.rawSize == expectedRawSize &&
+        section.offset <= size &&
+        size - section.offset >= section.size;
+}
+
+bool cml_verifyModelSection(const cml_ModelHeader header, const cml_ModelSection section, const char* stored) {
+    if((header.flags & CML_MODEL_FLAG_CHECKSUMS) == 0) {
+        return true;
+    }
+    return cml_crc32c(0, stored, section.size) == section.checksum;
+}
+
+bool cml_decodeModelSection(const cml_ModelSection section, const char* stored, char* destination) {
+    switch(section.encoding) {
+        case CML_ENCODING_RAW:
+            if(section.size != section.rawSize) {
+                return false;
+            }
+            memcpy(destination, stored, section.size);
+            return true;
+        case CML_ENCODING_SHUFFLE_LZ:
+            return cml_decompressFloats(stored, section.size, destination, section.rawSize);
+        default:
+            return false;
+    }
+}
+
+void cml_writeModelHeader(const cml_ModelHeader header, char* out) {
+    assert(out != NULL);
+    assert(header.headerSize >= cml_getUnpaddedHeaderSize(header));
+
+    memcpy(out, CML_MODEL_MAGIC, CML_MODEL_MAGIC_SIZE);
+    cml_writeUint32LE(out + 8, header.version);
+    cml_writeUint32LE(out + 12, header.flags);
+    cml_writeUint64LE(out + 16, header.headerSize);
+    cml_writeUint64LE(out + 24, header.layerCount);
+    cml_writeUint64LE(out + 32, header.scale);
+    cml_writeUint64LE(out + 40, header.sectionCount);
+
+    size_t offset = CML_MODEL_HEADER_PREFIX_SIZE;
+    for(size_t i = 0; i < header.layerCount; i++) {
+        cml_writeUint64LE(out + offset, header.layerSizes[i]);
+        offset += 8;
+    }
+
+    for(size_t i = 0; i < header.sectionCount; i++) {
+        const cml_ModelSection* section = &header.sections[i];
+        cml_writeUint32LE(out + offset, section->type);
+        cml_writeUint32LE(out + offset + 4, section->encoding);
+        cml_writeUint64LE(out + offset + 8, section->layer);
+        cml_writeUint64LE(out + offset + 16, section->offset);
+        cml_writeUint64LE(out + offset + 24, section->size);
+        cml_writeUint64LE(out + offset + 32, section->rawSize);
+        cml_writeUint64LE(out + offset + 40, section->checksum);
+        offset += CML_MODEL_SECTION_ENTRY_SIZE;
+    }
+
+    for(size_t i = 0; i < header.layerCount-1; i++) {
+        const cml_ActivationFnMetadata* metadata = &header.activationFunctions[i];
+        cml_writeUint64LE(out + offset, metadata->gpuProgramFilename.size);
+        offset += 8;
+        memcpy(out + offset, metadata->gpuProgramFilename.data, metadata->gpuProgramFilename.size);
+        offset += metadata->gpuProgramFilename.size;
+        cml_writeUint64LE(out + offset, metadata->gpuKernelName.size);
+        offset += 8;
+        memcpy(out + offset, metadata->gpuKernelName.data, metadata->gpuKernelName.size);
+        offset += metadata->gpuKernelName.size;
+        out[offset] = (char)(unsigned char)metadata->activationID;
+        offset += 1;
+    }
+
+    memset(out + offset, 0, header.headerSize - offset);
+}
+
+// Reads a length prefixed string, returns false if it runs past size
+static bool cml_readHeaderString(const char* serializedModel, const size_t size, size_t* offset, cml_String* string) {
+    if(size - *offset < 8) {
+        return false;
+    }
+    uint64 stringSize = cml_readUint64LE(serializedModel + *offset);
+    *offset += 8;
+    if(size - *offset < stringSize) {
+        return false;
+    }
+    *string = cml_createNewString(stringSize);
+    if(stringSize > 0) {
+        memcpy(string->data, serializedModel + *offset, stringSize);
+    }
+    *offset += stringSize;
+    return true;
+}
+
+bool cml_readModelHeader(const char* serializedModel, const size_t size, cml_ModelHeader* header) {
+    assert(serializedModel != NULL);
+    assert(header != NULL);
+
+    if(size < CML_MODEL_HEADER_PREFIX_SIZE || cml_getModelFormatVersion(serializedModel, size) != CML_MODEL_FORMAT_VERSION) {
+        return false;
+    }
+
+    header->version = cml_readUint32LE(serializedModel + 8);
+    header->flags = cml_readUint32LE(serializedModel + 12);
+    header->headerSize = cml_readUint64LE(serializedModel + 16);
+    header->layerCount = cml_readUint64LE(serializedModel + 24);
+    header->scale = cml_readUint64LE(serializedModel + 32);
+    header->sectionCount = cml_readUint64LE(serializedModel + 40);
+    header->layerSizes = NULL;
+    header->activationFunctions = NULL;
+    header->sections = NULL;
+
+    if(header->headerSize < CML_MODEL_HEADER_PREFIX_SIZE) {
+        return false;
+    }
+    size_t available = size < header->headerSize ? size : header->headerSize;
+    size_t tableBytes = available - CML_MODEL_HEADER_PREFIX_SIZE;
+    if(header->layerCount < 1 ||
+       header->layerCount > tableBytes / 8 ||
+       header->sectionCount > (tableBytes - 8 * header->layerCount) / CML_MODEL_SECTION_ENTRY_SIZE) {
+        return false;
+    }
+
+    size_t offset = CML_MODEL_HEADER_PREFIX_SIZE;
+    header->layerSizes = (uint64*)malloc(sizeof(uint64) * header->layerCount);
+    for(size_t i = 0; i < header->layerCount; i++) {
+        header->layerSizes[i] = cml_readUint64LE(serializedModel + offset);
+        offset += 8;
+    }
+
+    header->sections = (cml_ModelSection*)malloc(sizeof(cml_ModelSection) * (header->sectionCount > 0 ? header->sectionCount : 1));
+    for(size_t i = 0; i < header->sectionCount; i++) {
+        cml_ModelSection* section = &header->sections[i];
+        section->type = cml_readUint32LE(serializedModel + offset);
+        section->encoding = cml_readUint32LE(serializedModel + offset + 4);
+        section->layer = cml_readUint64LE(serializedModel + offset + 8);
+        section->offset = cml_readUint64LE(serializedModel + offset + 16);
+        section->size = cml_readUint64LE(serializedModel + offset + 24);
+        section->rawSize = cml_readUint64LE(serializedModel + offset + 32);
+        section->checksum = cml_readUint64LE(serializedModel + offset + 40);
+        offset += CML_MODEL_SECTION_ENTRY_SIZE;
+    }
+
+    // calloc so a partially read array can still be deleted
+    header->activationFunctions = (cml_ActivationFnMetadata*)calloc(header->layerCount-1, sizeof(cml_ActivationFnMetadata));
+    for(size_t i = 0; i < header->layerCount-1; i++) {
+        cml_ActivationFnMetadata* metadata = &header->activationFunctions[i];
+        if(!cml_readHeaderString(serializedModel, available, &offset, &metadata->gpuProgramFilename) ||
+           !cml_readHeaderString(serializedModel, available, &offset, &metadata->gpuKernelName) ||
+           available - offset < 1) {
+            cml_deleteModelHeader(header);
+            return false;
+        }
+        metadata->activationID = (enum cml_ActivationID)(unsigned char)serializedModel[offset];
+        offset += 1;
+    }
+
+    return true;
+}
+
+uint64 cml_readModelSizeV1(const char* serializedModel, const size_t sizeofSize_t) {
+    uint64 value = 0;
+    memcpy(&value, serializedModel, sizeofSize_t);
+    return value;
+}
+
+// Version 1 counterpart of cml_readHeaderString, the length is sizeofSize_t bytes
+static bool cml_readHeaderStringV1(const char* serializedModel, const size_t size, const size_t sizeofSize_t,
+                                   size_t* offset, cml_String* string) {
+    if(size - *offset < sizeofSize_t) {
+        return false;
+    }
+    uint64 stringSize = cml_readModelSizeV1(serializedModel + *offset, sizeofSize_t);
+    *offset += sizeofSize_t;
+    if(size - *offset < stringSize) {
+        return false;
+    }
+    *string = cml_createNewString(stringSize);
+    if(stringSize > 0) {
+        memcpy(string->data, serializedModel + *offset, stringSize);
+    }
+    *offset += stringSize;
+    return true;
+}
+
+bool cml_readModelHeaderV1(const char* serializedModel, const size_t size, cml_ModelHeader* header) {
+    assert(serializedModel != NULL);
+    assert(header != NULL);
+
+    memset(header, 0, sizeof(*header));
+    header->version = 1;
+    if(size < 1) {
+        return false;
+    }
+    size_t sizeofSize_t = (uint8)serializedModel[0];
+    if((sizeofSize_t != 4 && sizeofSize_t != 8) || size - 1 < 2 * sizeofSize_t) {
+        return false;
+    }
+
+    size_t offset = 1;
+    header->layerCount = cml_readModelSizeV1(serializedModel + offset, sizeofSize_t);
+    offset += sizeofSize_t;
+    header->scale = cml_readModelSizeV1(serializedModel + offset, sizeofSize_t);
+    offset += sizeofSize_t;
+    if(header->layerCount < 2 || header->layerCount > (size - offset) / sizeof(uint64)) {
+        header->layerCount = 0;
+        return false;
+    }
+
+    size_t layerSizesBytes = sizeof(uint64) * header->layerCount;
+    header->layerSizes = (uint64*)malloc(layerSizesBytes);
+    memcpy(header->layerSizes, serializedModel + offset, layerSizesBytes);
+    offset += layerSizesBytes;
+
+    // calloc so a partially read array can still be deleted
+    header->activationFunctions = (cml_ActivationFnMetadata*)calloc(header->layerCount-1, sizeof(cml_ActivationFnMetadata));
+    for(size_t i = 0; i < header->layerCount-1; i++) {
+        cml_ActivationFnMetadata* metadata = &header->activationFunctions[i];
+        if(!cml_readHeaderStringV1(serializedModel, size, sizeofSize_t, &offset, &metadata->gpuProgramFilename) ||
+           !cml_readHeaderStringV1(serializedModel, size, sizeofSize_t, &offset, &metadata->gpuKernelName) ||
+           size - offset < 1) {
+            cml_deleteModelHeader(header);
+            return false;
+        }
+        metadata->activationID = (enum cml_ActivationID)(unsigned char)serializedModel[offset];
+        offset += 1;
+    }
+
+    header->headerSize = offset;
+    return true;
+}
+
+void cml_deleteModelHeader(cml_ModelHeader* header) {
+    assert(header != NULL);
+
+    if(header->activationFunctions != NULL) {
+        for(size_t i = 0; i < header->layerCount-1; i++) {
+            cml_deleteActivationFnMetadata(&header->activationFunctions[i]);
+        }
+    }
+    free(header->activationFunctions);
+    free(header->layerSizes);
+    free(header->sections);
+
+    header->activationFunctions = NULL;
+    header->layerSizes = NULL;
+    header->sections = NULL;
+    header->layerCount = 0;
+    header->sectionCount = 0;
+}
+
+const cml_ModelSection* cml_findModelSection(const cml_ModelHeader header, const uint32 type, const uint64 layer) {
+    for(size_t i = 0; i < header.sectionCount; i++) {
+        if(header.sections[i].type == type && header.sections[i].layer == layer) {
+            return &header.sections[i];
+        }
+    }
+    return NULL;
+}
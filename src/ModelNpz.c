@@ -0,0 +1,404 @@
+#include <cml/ModelNpz.h>
+#include <cml/util/Endian.h>
+#include <cml/util/Npy.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Only the parts of the zip format (APPNOTE.TXT) np.savez produces are supported:
+// stored members in a single disk archive, optionally with zip64 sizes and offsets.
+#define CML_ZIP_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define CML_ZIP_CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define CML_ZIP_END_SIGNATURE 0x06054b50
+#define CML_ZIP64_END_SIGNATURE 0x06064b50
+#define CML_ZIP64_LOCATOR_SIGNATURE 0x07064b50
+#define CML_ZIP_LOCAL_HEADER_SIZE 30
+#define CML_ZIP_CENTRAL_HEADER_SIZE 46
+#define CML_ZIP_END_SIZE 22
+#define CML_ZIP64_END_SIZE 56
+#define CML_ZIP64_LOCATOR_SIZE 20
+#define CML_ZIP64_EXTRA_ID 0x0001
+#define CML_ZIP_MAX_COMMENT_SIZE 0xFFFF
+#define CML_ZIP_METHOD_STORED 0
+// version 2.0, the lowest that has directories and stored members
+#define CML_ZIP_VERSION 20
+// 1980-01-01, the earliest date a zip can hold
+#define CML_ZIP_DATE 0x21
+// Sanity limit when opening, a corrupt directory size should not turn into a huge allocation
+#define CML_ZIP_MAX_DIRECTORY_SIZE 0x4000000
+// "weights_" + a 20 digit layer + ".npy"
+#define CML_NPZ_MAX_NAME_SIZE 40
+
+static int cml_seekNpz(FILE* file, const uint64 offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static uint64 cml_getNpzFileSize(FILE* file) {
+#ifdef _WIN32
+    if(_fseeki64(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    __int64 size = _ftelli64(file);
+#else
+    if(fseeko(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    off_t size = ftello(file);
+#endif
+    return size < 0 ? 0 : (uint64)size;
+}
+
+// Central directory of an archive opened for reading
+typedef struct {
+    char* data;
+    uint64 size;
+    uint64 entryCount;
+} cml_NpzDirectory;
+
+// Finds the end of central directory record, the archive comment may follow it
+// Returns false if the file is not a zip archive
+static bool cml_readNpzDirectory(FILE* file, cml_NpzDirectory* directory) {
+    uint64 fileSize = cml_getNpzFileSize(file);
+    if(fileSize < CML_ZIP_END_SIZE) {
+        return false;
+    }
+    size_t tailSize = fileSize < CML_ZIP_END_SIZE + CML_ZIP_MAX_COMMENT_SIZE ?
+        (size_t)fileSize : CML_ZIP_END_SIZE + CML_ZIP_MAX_COMMENT_SIZE;
+    uint64 tailOffset = fileSize - tailSize;
+    char* tail = (char*)malloc(tailSize);
+    if(cml_seekNpz(file, tailOffset) != 0 || fread(tail, 1, tailSize, file) != tailSize) {
+        free(tail);
+        return false;
+    }
+
+    size_t endOffset = tailSize - CML_ZIP_END_SIZE;
+    while(cml_readUint32LE(tail + endOffset) != CML_ZIP_END_SIGNATURE) {
+        if(endOffset == 0) {
+            free(tail);
+            return false;
+        }
+        endOffset--;
+    }
+    const char* end = tail + endOffset;
+    directory->entryCount = cml_readUint16LE(end + 10);
+    directory->size = cml_readUint32LE(end + 12);
+    uint64 directoryOffset = cml_readUint32LE(end + 16);
+
+    // zip64 archives keep the real values in a record found through the locator right before
+    if(directory->entryCount == 0xFFFF || directory->size == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        char record[CML_ZIP64_END_SIZE];
+        bool success = endOffset >= CML_ZIP64_LOCATOR_SIZE &&
+            cml_readUint32LE(end - CML_ZIP64_LOCATOR_SIZE) == CML_ZIP64_LOCATOR_SIGNATURE &&
+            cml_seekNpz(file, cml_readUint64LE(end - CML_ZIP64_LOCATOR_SIZE + 8)) == 0 &&
+            fread(record, 1, sizeof(record), file) == sizeof(record) &&
+            cml_readUint32LE(record) == CML_ZIP64_END_SIGNATURE;
+        if(!success) {
+            free(tail);
+            return false;
+        }
+        directory->entryCount = cml_readUint64LE(record + 32);
+        directory->size = cml_readUint64LE(record + 40);
+        directoryOffset = cml_readUint64LE(record + 48);
+    }
+    free(tail);
+
+    if(directory->size > CML_ZIP_MAX_DIRECTORY_SIZE ||
+       directory->entryCount > directory->size / CML_ZIP_CENTRAL_HEADER_SIZE) {
+        return false;
+    }
+    directory->data = (char*)malloc(directory->size > 0 ? directory->size : 1);
+    if(cml_seekNpz(file, directoryOffset) != 0 ||
+       fread(directory->data, 1, directory->size, file) != directory->size) {
+        free(directory->data);
+        directory->data = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Reads the local header offset out of the zip64 extra field, it follows the sizes that
+// overflowed as well
+static bool cml_readNpzZip64Offset(const char* extra, const size_t extraSize, const char* entry, uint64* offset) {
+    size_t skippedSize = (cml_readUint32LE(entry + 24) == 0xFFFFFFFF ? 8 : 0) +
+        (cml_readUint32LE(entry + 20) == 0xFFFFFFFF ? 8 : 0);
+    for(size_t position = 0; extraSize - position >= 4;) {
+        uint16 id = cml_readUint16LE(extra + position);
+        size_t fieldSize = cml_readUint16LE(extra + position + 2);
+        if(fieldSize > extraSize - position - 4) {
+            return false;
+        }
+        if(id == CML_ZIP64_EXTRA_ID) {
+            if(fieldSize < skippedSize + 8) {
+                return false;
+            }
+            *offset = cml_readUint64LE(extra + position + 4 + skippedSize);
+            return true;
+        }
+        position += 4 + fieldSize;
+    }
+    return false;
+}
+
+// Returns false if the archive has no member of that name or it is not stored
+static bool cml_findNpzMember(const cml_NpzDirectory directory, const char* name, uint64* localHeaderOffset) {
+    size_t nameSize = strlen(name);
+    uint64 position = 0;
+    for(uint64 i = 0; i < directory.entryCount; i++) {
+        if(directory.size - position < CML_ZIP_CENTRAL_HEADER_SIZE) {
+            return false;
+        }
+        const char* entry = directory.data + position;
+        size_t entryNameSize = cml_readUint16LE(entry + 28);
+        size_t extraSize = cml_readUint16LE(entry + 30);
+        size_t commentSize = cml_readUint16LE(entry + 32);
+        if(cml_readUint32LE(entry) != CML_ZIP_CENTRAL_HEADER_SIGNATURE ||
+           directory.size - position - CML_ZIP_CENTRAL_HEADER_SIZE < entryNameSize + extraSize + commentSize) {
+            return false;
+        }
+
+        if(entryNameSize == nameSize && memcmp(entry + CML_ZIP_CENTRAL_HEADER_SIZE, name, nameSize) == 0) {
+            if(cml_readUint16LE(entry + 10) != CML_ZIP_METHOD_STORED) {
+                return false;
+            }
+            *localHeaderOffset = cml_readUint32LE(entry + 42);
+            if(*localHeaderOffset != 0xFFFFFFFF) {
+                return true;
+            }
+            return cml_readNpzZip64Offset(entry + CML_ZIP_CENTRAL_HEADER_SIZE + entryNameSize, extraSize, entry, localHeaderOffset);
+        }
+        position += CML_ZIP_CENTRAL_HEADER_SIZE + entryNameSize + extraSize + commentSize;
+    }
+    return false;
+}
+
+// Reads the .npy array stored as member name into matrix
+static bool cml_readNpzMatrix(FILE* file, const cml_NpzDirectory directory, const char* name, cml_Matrix matrix) {
+    uint64 localHeaderOffset;
+    char localHeader[CML_ZIP_LOCAL_HEADER_SIZE];
+    if(!cml_findNpzMember(directory, name, &localHeaderOffset) ||
+       cml_seekNpz(file, localHeaderOffset) != 0 ||
+       fread(localHeader, 1, sizeof(localHeader), file) != sizeof(localHeader) ||
+       cml_readUint32LE(localHeader) != CML_ZIP_LOCAL_HEADER_SIGNATURE) {
+        return false;
+    }
+
+    // the local extra field can differ from the central one, np.savez always adds zip64 sizes here
+    uint64 dataOffset = localHeaderOffset + CML_ZIP_LOCAL_HEADER_SIZE +
+        cml_readUint16LE(localHeader + 26) + cml_readUint16LE(localHeader + 28);
+    if(cml_seekNpz(file, dataOffset) != 0) {
+        return false;
+    }
+    cml_NpyReader reader = cml_openNpyAt(file);
+    if(reader.file == NULL) {
+        return false;
+    }
+    bool success = cml_readNpyMatrix(&reader, matrix);
+    cml_closeNpy(&reader);
+    return success;
+}
+
+static void cml_getNpzMemberName(char* name, const char* prefix, const size_t layer) {
+    snprintf(name, CML_NPZ_MAX_NAME_SIZE, "%s_%zu.npy", prefix, layer);
+}
+
+bool cml_loadModelNpz(const cml_Model model, const char* filename) {
+    assert(model.data != NULL);
+    assert(filename != NULL);
+
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        return false;
+    }
+    cml_NpzDirectory directory;
+    // a lazily verified mapping would no longer match its checksum once overwritten
+    if(!cml_readNpzDirectory(file, &directory) || !cml_verifyModel(model)) {
+        fclose(file);
+        return false;
+    }
+
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    cml_lockMutex(model.lock);
+    bool success = true;
+    char name[CML_NPZ_MAX_NAME_SIZE];
+    for(size_t i = 0; i < model.layerCount-1 && success; i++) {
+        cml_getNpzMemberName(name, "weights", i);
+        success = cml_readNpzMatrix(file, directory, name, modelMatrices.weights[i]);
+        cml_getNpzMemberName(name, "biases", i);
+        success = success && cml_readNpzMatrix(file, directory, name, modelMatrices.biases[i]);
+    }
+    cml_unlockMutex(model.lock);
+    cml_deleteModelMatrices(modelMatrices);
+
+    free(directory.data);
+    fclose(file);
+    return success;
+}
+
+// CRC-32 of the zip format (reflected 0x04C11DB7), not the CRC-32C of Crc32c.h
+static void cml_createZipCrcTable(uint32* table) {
+    for(uint32 i = 0; i < 256; i++) {
+        uint32 crc = i;
+        for(int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        table[i] = crc;
+    }
+}
+
+static uint32 cml_zipCrc(const uint32* table, uint32 crc, const char* data, const size_t size) {
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ (uint8)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Member as written, kept for the central directory
+typedef struct {
+    char name[CML_NPZ_MAX_NAME_SIZE];
+    uint32 crc;
+    uint32 size;
+    uint32 localHeaderOffset;
+} cml_NpzMember;
+
+// Fills in the fields shared by the local and central headers, starting at the version needed
+static void cml_writeNpzMemberFields(char* fields, const cml_NpzMember* member) {
+    cml_writeUint16LE(fields, CML_ZIP_VERSION);
+    cml_writeUint16LE(fields + 2, 0);
+    cml_writeUint16LE(fields + 4, CML_ZIP_METHOD_STORED);
+    cml_writeUint16LE(fields + 6, 0);
+    cml_writeUint16LE(fields + 8, CML_ZIP_DATE);
+    cml_writeUint32LE(fields + 10, member->crc);
+    cml_writeUint32LE(fields + 14, member->size);
+    cml_writeUint32LE(fields + 18, member->size);
+    cml_writeUint16LE(fields + 22, (uint16)strlen(member->name));
+    cml_writeUint16LE(fields + 24, 0);
+}
+
+static bool cml_writeNpzMatrix(FILE* file, const uint32* crcTable, const cml_Matrix matrix, const bool oneDimensional,
+                               uint64* offset, cml_NpzMember* member) {
+    char header[CML_NPY_WRITE_HEADER_SIZE];
+    cml_writeNpyHeader(header, matrix.rows, matrix.cols, oneDimensional);
+    size_t dataSize = sizeof(float) * matrix.rows * matrix.cols;
+    uint64 memberSize = sizeof(header) + dataSize;
+    if(*offset > 0xFFFFFFFF || memberSize > 0xFFFFFFFF) {
+        return false;
+    }
+
+    member->crc = cml_zipCrc(crcTable, 0, header, sizeof(header));
+    member->crc = cml_zipCrc(crcTable, member->crc, (const char*)matrix.data, dataSize);
+    member->size = (uint32)memberSize;
+    member->localHeaderOffset = (uint32)*offset;
+
+    char localHeader[CML_ZIP_LOCAL_HEADER_SIZE];
+    size_t nameSize = strlen(member->name);
+    cml_writeUint32LE(localHeader, CML_ZIP_LOCAL_HEADER_SIGNATURE);
+    cml_writeNpzMemberFields(localHeader + 4, member);
+    *offset += sizeof(localHeader) + nameSize + memberSize;
+    return fwrite(localHeader, 1, sizeof(localHeader), file) == sizeof(localHeader) &&
+        fwrite(member->name, 1, nameSize, file) == nameSize &&
+        fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+        fwrite(matrix.data, 1, dataSize, file) == dataSize;
+}
+
+bool cml_saveModelNpz(const cml_Model model, const char* filename) {
+    assert(model.data != NULL);
+    assert(filename != NULL);
+
+    size_t memberCount = 2 * (model.layerCount-1);
+    if(memberCount > 0xFFFF) {
+        return false;
+    }
+    FILE* file = fopen(filename, "wb");
+    if(file == NULL) {
+        return false;
+    }
+
+    uint32 crcTable[256];
+    cml_createZipCrcTable(crcTable);
+    cml_NpzMember* members = (cml_NpzMember*)malloc(sizeof(cml_NpzMember) * (memberCount > 0 ? memberCount : 1));
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    bool success = true;
+    uint64 offset = 0;
+    for(size_t i = 0; i < model.layerCount-1 && success; i++) {
+        // biases are written the way frameworks hold them, as a one dimensional array
+        cml_getNpzMemberName(members[2*i].name, "weights", i);
+        success = cml_writeNpzMatrix(file, crcTable, modelMatrices.weights[i], false, &offset, &members[2*i]);
+        cml_getNpzMemberName(members[2*i+1].name, "biases", i);
+        success = success && cml_writeNpzMatrix(file, crcTable, modelMatrices.biases[i], true, &offset, &members[2*i+1]);
+    }
+    cml_deleteModelMatrices(modelMatrices);
+
+    uint64 directoryOffset = offset;
+    for(size_t i = 0; i < memberCount && success; i++) {
+        char centralHeader[CML_ZIP_CENTRAL_HEADER_SIZE];
+        size_t nameSize = strlen(members[i].name);
+        memset(centralHeader, 0, sizeof(centralHeader));
+        cml_writeUint32LE(centralHeader, CML_ZIP_CENTRAL_HEADER_SIGNATURE);
+        cml_writeUint16LE(centralHeader + 4, CML_ZIP_VERSION);
+        cml_writeNpzMemberFields(centralHeader + 6, &members[i]);
+        cml_writeUint32LE(centralHeader + 42, members[i].localHeaderOffset);
+        success = fwrite(centralHeader, 1, sizeof(centralHeader), file) == sizeof(centralHeader) &&
+            fwrite(members[i].name, 1, nameSize, file) == nameSize;
+        offset += sizeof(centralHeader) + nameSize;
+    }
+    free(members);
+
+    char end[CML_ZIP_END_SIZE];
+    memset(end, 0, sizeof(end));
+    cml_writeUint32LE(end, CML_ZIP_END_SIGNATURE);
+    cml_writeUint16LE(end + 8, (uint16)memberCount);
+    cml_writeUint16LE(end + 10, (uint16)memberCount);
+    cml_writeUint32LE(end + 12, (uint32)(offset - directoryOffset));
+    cml_writeUint32LE(end + 16, (uint32)directoryOffset);
+    success = success && offset <= 0xFFFFFFFF && fwrite(end, 1, sizeof(end), file) == sizeof(end);
+    success = fclose(file) == 0 && success;
+    return success;
+}
+
+bool cml_predictCPUNpy(const cml_Model model, const char* inputsFilename, const char* outputsFilename) {
+    assert(model.data != NULL);
+
+    size_t inputSize = model.layerSizes[0];
+    size_t outputSize = model.layerSizes[model.layerCount-1];
+    cml_NpyReader reader = cml_openNpy(inputsFilename);
+    if(reader.file == NULL) {
+        return false;
+    }
+    if(reader.cols != inputSize) {
+        cml_closeNpy(&reader);
+        return false;
+    }
+    cml_NpyWriter writer = cml_createNpyWriter(outputsFilename, outputSize);
+    if(writer.file == NULL) {
+        cml_closeNpy(&reader);
+        return false;
+    }
+
+    // a batch of model.scale rows in and out, the last one is padded with zeros
+    float* in = (float*)malloc(sizeof(float) * model.scale * inputSize);
+    float* out = (float*)malloc(sizeof(float) * model.scale * outputSize);
+    bool success = true;
+    while(success) {
+        size_t rowCount = cml_readNpyRows(&reader, in, model.scale);
+        if(rowCount == 0) {
+            break;
+        }
+        memset(in + rowCount * inputSize, 0, sizeof(float) * (model.scale - rowCount) * inputSize);
+        cml_predictCPU(model, in, out);
+        success = cml_writeNpyRows(&writer, out, rowCount);
+    }
+    success = success && reader.rowsRead == reader.rows;
+    free(in);
+    free(out);
+
+    cml_closeNpy(&reader);
+    success = cml_closeNpyWriter(&writer) && success;
+    return success;
+}
@@ -0,0 +1,344 @@
+#include <cml/ModelPatch.h>
+#include <cml/ModelFormat.h>
+#include <cml/util/Endian.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// magic, version, flags and layerCount
+#define CML_PATCH_PREFIX_SIZE 24
+// section type, encoding, layer, offset and count
+#define CML_PATCH_ENTRY_FIXED_SIZE 32
+// unchanged floats a dense run may carry along instead of ending
+#define CML_PATCH_MAX_GAP 8
+
+static cml_ModelPatch cml_emptyModelPatch() {
+    cml_ModelPatch patch;
+    patch.layerCount = 0;
+    patch.layerSizes = NULL;
+    patch.entries = NULL;
+    patch.entryCount = 0;
+    return patch;
+}
+
+static size_t cml_getPatchSectionSize(const uint64* layerSizes, const uint32 sectionType, const uint64 layer) {
+    if(sectionType == CML_SECTION_WEIGHTS) {
+        return layerSizes[layer] * layerSizes[layer+1];
+    }
+    return layerSizes[layer+1];
+}
+
+static bool cml_floatsDiffer(const float* a, const float* b) {
+    // bitwise, so NaN payloads and signed zeros count as changes
+    return memcmp(a, b, sizeof(float)) != 0;
+}
+
+static cml_ModelPatchEntry* cml_addPatchEntry(cml_ModelPatch* patch, size_t* capacity) {
+    if(patch->entryCount == *capacity) {
+        *capacity = *capacity > 0 ? *capacity * 2 : 8;
+        patch->entries = (cml_ModelPatchEntry*)realloc(patch->entries, sizeof(cml_ModelPatchEntry) * *capacity);
+    }
+    cml_ModelPatchEntry* entry = &patch->entries[patch->entryCount++];
+    memset(entry, 0, sizeof(cml_ModelPatchEntry));
+    return entry;
+}
+
+// Adds the entries turning base into target for one weight or bias matrix of size floats
+static void cml_diffPatchSection(
+    cml_ModelPatch* patch,
+    size_t* capacity,
+    const uint32 sectionType,
+    const uint64 layer,
+    const float* base,
+    const float* target,
+    const size_t size) {
+
+    // sparse indices are 32 bit, anything larger only gets dense entries
+    bool sparseAllowed = size <= (size_t)UINT32_MAX;
+    uint32* sparseIndices = NULL;
+    size_t sparseCount = 0;
+    size_t sparseCapacity = 0;
+
+    size_t i = 0;
+    while(i < size) {
+        if(!cml_floatsDiffer(&base[i], &target[i])) {
+            i++;
+            continue;
+        }
+
+        // extend the run while changes are close enough together
+        size_t start = i;
+        size_t end = i + 1;
+        size_t changedCount = 1;
+        for(size_t j = end; j < size && j - end <= CML_PATCH_MAX_GAP; j++) {
+            if(cml_floatsDiffer(&base[j], &target[j])) {
+                end = j + 1;
+                changedCount++;
+            }
+        }
+        i = end;
+
+        // a dense entry costs its header and every float in the run, a sparse index and value per change
+        size_t denseSize = CML_PATCH_ENTRY_FIXED_SIZE + sizeof(float) * (end - start);
+        size_t sparseSize = (sizeof(uint32) + sizeof(float)) * changedCount;
+        if(!sparseAllowed || denseSize <= sparseSize) {
+            cml_ModelPatchEntry* entry = cml_addPatchEntry(patch, capacity);
+            entry->sectionType = sectionType;
+            entry->encoding = CML_PATCH_DENSE;
+            entry->layer = layer;
+            entry->offset = start;
+            entry->count = end - start;
+            entry->values = (float*)malloc(sizeof(float) * entry->count);
+            memcpy(entry->values, target + start, sizeof(float) * entry->count);
+            continue;
+        }
+
+        for(size_t j = start; j < end; j++) {
+            if(!cml_floatsDiffer(&base[j], &target[j])) {
+                continue;
+            }
+            if(sparseCount == sparseCapacity) {
+                sparseCapacity = sparseCapacity > 0 ? sparseCapacity * 2 : 16;
+                sparseIndices = (uint32*)realloc(sparseIndices, sizeof(uint32) * sparseCapacity);
+            }
+            sparseIndices[sparseCount++] = (uint32)j;
+        }
+    }
+
+    if(sparseCount == 0) {
+        return;
+    }
+    cml_ModelPatchEntry* entry = cml_addPatchEntry(patch, capacity);
+    entry->sectionType = sectionType;
+    entry->encoding = CML_PATCH_SPARSE;
+    entry->layer = layer;
+    entry->offset = 0;
+    entry->count = sparseCount;
+    entry->indices = sparseIndices;
+    entry->values = (float*)malloc(sizeof(float) * sparseCount);
+    for(size_t j = 0; j < sparseCount; j++) {
+        entry->values[j] = target[sparseIndices[j]];
+    }
+}
+
+cml_ModelPatch cml_diffModels(const cml_Model base, const cml_Model target) {
+    assert(base.data != NULL);
+    assert(target.data != NULL);
+
+    if(base.layerCount != target.layerCount ||
+       memcmp(base.layerSizes, target.layerSizes, sizeof(uint64) * base.layerCount) != 0) {
+        return cml_emptyModelPatch();
+    }
+
+    cml_ModelPatch patch = cml_emptyModelPatch();
+    patch.layerCount = base.layerCount;
+    patch.layerSizes = (uint64*)malloc(sizeof(uint64) * base.layerCount);
+    memcpy(patch.layerSizes, base.layerSizes, sizeof(uint64) * base.layerCount);
+
+    size_t capacity = 0;
+    cml_ModelMatrices baseMatrices = cml_getModelMatrices(base);
+    cml_ModelMatrices targetMatrices = cml_getModelMatrices(target);
+    for(size_t i = 0; i < base.layerCount-1; i++) {
+        cml_diffPatchSection(&patch, &capacity, CML_SECTION_WEIGHTS, i,
+            baseMatrices.weights[i].data, targetMatrices.weights[i].data, base.layerSizes[i] * base.layerSizes[i+1]);
+        cml_diffPatchSection(&patch, &capacity, CML_SECTION_BIASES, i,
+            baseMatrices.biases[i].data, targetMatrices.biases[i].data, base.layerSizes[i+1]);
+    }
+    cml_deleteModelMatrices(baseMatrices);
+    cml_deleteModelMatrices(targetMatrices);
+
+    return patch;
+}
+
+void cml_deleteModelPatch(cml_ModelPatch* patch) {
+    assert(patch != NULL);
+
+    for(size_t i = 0; i < patch->entryCount; i++) {
+        free(patch->entries[i].indices);
+        free(patch->entries[i].values);
+    }
+    free(patch->entries);
+    free(patch->layerSizes);
+    *patch = cml_emptyModelPatch();
+}
+
+static size_t cml_getPatchEntrySize(const cml_ModelPatchEntry entry) {
+    size_t indicesSize = entry.encoding == CML_PATCH_SPARSE ? sizeof(uint32) * entry.count : 0;
+    return CML_PATCH_ENTRY_FIXED_SIZE + indicesSize + sizeof(float) * entry.count;
+}
+
+cml_String cml_serializeModelPatch(const cml_ModelPatch patch) {
+    assert(patch.layerSizes != NULL);
+
+    size_t size = CML_PATCH_PREFIX_SIZE + 8 * patch.layerCount + 8;
+    for(size_t i = 0; i < patch.entryCount; i++) {
+        size += cml_getPatchEntrySize(patch.entries[i]);
+    }
+
+    cml_String serializedPatch = cml_createNewString(size);
+    char* out = serializedPatch.data;
+    memcpy(out, CML_PATCH_MAGIC, CML_PATCH_MAGIC_SIZE);
+    cml_writeUint32LE(out + 8, CML_PATCH_FORMAT_VERSION);
+    cml_writeUint32LE(out + 12, 0);
+    cml_writeUint64LE(out + 16, patch.layerCount);
+    size_t offset = CML_PATCH_PREFIX_SIZE;
+    for(size_t i = 0; i < patch.layerCount; i++) {
+        cml_writeUint64LE(out + offset, patch.layerSizes[i]);
+        offset += 8;
+    }
+    cml_writeUint64LE(out + offset, patch.entryCount);
+    offset += 8;
+
+    for(size_t i = 0; i < patch.entryCount; i++) {
+        const cml_ModelPatchEntry* entry = &patch.entries[i];
+        cml_writeUint32LE(out + offset, entry->sectionType);
+        cml_writeUint32LE(out + offset + 4, entry->encoding);
+        cml_writeUint64LE(out + offset + 8, entry->layer);
+        cml_writeUint64LE(out + offset + 16, entry->offset);
+        cml_writeUint64LE(out + offset + 24, entry->count);
+        offset += CML_PATCH_ENTRY_FIXED_SIZE;
+        if(entry->encoding == CML_PATCH_SPARSE) {
+            for(size_t j = 0; j < entry->count; j++) {
+                cml_writeUint32LE(out + offset, entry->indices[j]);
+                offset += 4;
+            }
+        }
+        memcpy(out + offset, entry->values, sizeof(float) * entry->count);
+        offset += sizeof(float) * entry->count;
+    }
+
+    return serializedPatch;
+}
+
+// Returns false if the entry points outside the model the patch was made for
+static bool cml_isPatchEntryValid(const cml_ModelPatchEntry entry, const uint64 layerCount, const uint64* layerSizes) {
+    if((entry.sectionType != CML_SECTION_WEIGHTS && entry.sectionType != CML_SECTION_BIASES) || entry.layer >= layerCount-1) {
+        return false;
+    }
+    size_t sectionSize = cml_getPatchSectionSize(layerSizes, entry.sectionType, entry.layer);
+    if(entry.encoding == CML_PATCH_DENSE) {
+        return entry.offset <= sectionSize && entry.count <= sectionSize - entry.offset;
+    }
+    if(entry.encoding != CML_PATCH_SPARSE || entry.offset != 0) {
+        return false;
+    }
+    for(size_t i = 0; i < entry.count; i++) {
+        if(entry.indices[i] >= sectionSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+cml_ModelPatch cml_deserializeModelPatch(const char* serializedPatch, const size_t size) {
+    assert(serializedPatch != NULL);
+
+    if(size < CML_PATCH_PREFIX_SIZE ||
+       memcmp(serializedPatch, CML_PATCH_MAGIC, CML_PATCH_MAGIC_SIZE) != 0 ||
+       cml_readUint32LE(serializedPatch + 8) != CML_PATCH_FORMAT_VERSION) {
+        return cml_emptyModelPatch();
+    }
+
+    uint64 layerCount = cml_readUint64LE(serializedPatch + 16);
+    // layerSizes and entryCount have to fit
+    if(layerCount == 0 || layerCount >= (size - CML_PATCH_PREFIX_SIZE) / 8) {
+        return cml_emptyModelPatch();
+    }
+
+    cml_ModelPatch patch = cml_emptyModelPatch();
+    patch.layerCount = layerCount;
+    patch.layerSizes = (uint64*)malloc(sizeof(uint64) * layerCount);
+    size_t offset = CML_PATCH_PREFIX_SIZE;
+    for(size_t i = 0; i < layerCount; i++) {
+        patch.layerSizes[i] = cml_readUint64LE(serializedPatch + offset);
+        offset += 8;
+    }
+    uint64 entryCount = cml_readUint64LE(serializedPatch + offset);
+    offset += 8;
+    if(entryCount > (size - offset) / CML_PATCH_ENTRY_FIXED_SIZE) {
+        cml_deleteModelPatch(&patch);
+        return cml_emptyModelPatch();
+    }
+
+    // entries are counted as they are read so a failure part way deletes only those
+    patch.entries = (cml_ModelPatchEntry*)calloc(entryCount > 0 ? entryCount : 1, sizeof(cml_ModelPatchEntry));
+    bool success = true;
+    for(size_t i = 0; i < entryCount && success; i++) {
+        if(size - offset < CML_PATCH_ENTRY_FIXED_SIZE) {
+            success = false;
+            break;
+        }
+        cml_ModelPatchEntry* entry = &patch.entries[patch.entryCount++];
+        entry->sectionType = cml_readUint32LE(serializedPatch + offset);
+        entry->encoding = cml_readUint32LE(serializedPatch + offset + 4);
+        entry->layer = cml_readUint64LE(serializedPatch + offset + 8);
+        entry->offset = cml_readUint64LE(serializedPatch + offset + 16);
+        entry->count = cml_readUint64LE(serializedPatch + offset + 24);
+        offset += CML_PATCH_ENTRY_FIXED_SIZE;
+
+        size_t valueSize = entry->encoding == CML_PATCH_SPARSE ? sizeof(uint32) + sizeof(float) : sizeof(float);
+        if(entry->count > (size - offset) / valueSize) {
+            success = false;
+            break;
+        }
+        if(entry->encoding == CML_PATCH_SPARSE) {
+            entry->indices = (uint32*)malloc(sizeof(uint32) * (entry->count > 0 ? entry->count : 1));
+            for(size_t j = 0; j < entry->count; j++) {
+                entry->indices[j] = cml_readUint32LE(serializedPatch + offset);
+                offset += 4;
+            }
+        }
+        entry->values = (float*)malloc(sizeof(float) * (entry->count > 0 ? entry->count : 1));
+        memcpy(entry->values, serializedPatch + offset, sizeof(float) * entry->count);
+        offset += sizeof(float) * entry->count;
+
+        success = cml_isPatchEntryValid(*entry, patch.layerCount, patch.layerSizes);
+    }
+
+    if(!success) {
+        cml_deleteModelPatch(&patch);
+        return cml_emptyModelPatch();
+    }
+    return patch;
+}
+
+bool cml_applyModelPatch(const cml_Model model, const cml_ModelPatch patch) {
+    assert(model.data != NULL);
+    assert(patch.layerSizes != NULL);
+
+    if(model.layerCount != patch.layerCount ||
+       memcmp(model.layerSizes, patch.layerSizes, sizeof(uint64) * model.layerCount) != 0) {
+        return false;
+    }
+    for(size_t i = 0; i < patch.entryCount; i++) {
+        if(!cml_isPatchEntryValid(patch.entries[i], patch.layerCount, patch.layerSizes)) {
+            return false;
+        }
+    }
+    // a lazily verified mapping would no longer match its checksum once patched,
+    // the result is remembered so checking before taking the lock is enough
+    if(!cml_verifyModel(model)) {
+        return false;
+    }
+
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    cml_lockMutex(model.lock);
+    for(size_t i = 0; i < patch.entryCount; i++) {
+        const cml_ModelPatchEntry* entry = &patch.entries[i];
+        float* section = entry->sectionType == CML_SECTION_WEIGHTS ?
+            modelMatrices.weights[entry->layer].data :
+            modelMatrices.biases[entry->layer].data;
+        if(entry->encoding == CML_PATCH_DENSE) {
+            memcpy(section + entry->offset, entry->values, sizeof(float) * entry->count);
+            continue;
+        }
+        for(size_t j = 0; j < entry->count; j++) {
+            section[entry->indices[j]] = entry->values[j];
+        }
+    }
+    cml_unlockMutex(model.lock);
+    cml_deleteModelMatrices(modelMatrices);
+
+    return true;
+}
@@ -0,0 +1,376 @@
+#include <cml/ModelStream.h>
+#include <cml/ModelFormat.h>
+#include <cml/util/Endian.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+
+static size_t cml_readFd(void* context, char* buffer, size_t size) {
+    unsigned int chunk = size > 0x40000000 ? 0x40000000 : (unsigned int)size;
+    int bytesRead = _read(*(int*)context, buffer, chunk);
+    return bytesRead > 0 ? (size_t)bytesRead : 0;
+}
+
+// same layout as POSIX so the code below doesn't care
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+
+#define CML_IOV_MAX 1024
+
+// no writev on Windows, write each buffer in turn
+static bool cml_writeVector(const int fd, struct iovec* buffers, const size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        const char* data = (const char*)buffers[i].iov_base;
+        size_t remaining = buffers[i].iov_len;
+        while(remaining > 0) {
+            unsigned int chunk = remaining > 0x40000000 ? 0x40000000 : (unsigned int)remaining;
+            int written = _write(fd, data, chunk);
+            if(written <= 0) {
+                return false;
+            }
+            data += written;
+            remaining -= (size_t)written;
+        }
+    }
+    return true;
+}
+
+#else
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static size_t cml_readFd(void* context, char* buffer, size_t size) {
+    ssize_t bytesRead;
+    do {
+        bytesRead = read(*(int*)context, buffer, size);
+    } while(bytesRead < 0 && errno == EINTR);
+    return bytesRead > 0 ? (size_t)bytesRead : 0;
+}
+
+#ifdef IOV_MAX
+#define CML_IOV_MAX IOV_MAX
+#else
+#define CML_IOV_MAX 1024
+#endif
+
+// writev until everything is written, picking up after partial writes
+static bool cml_writeVector(const int fd, struct iovec* buffers, size_t count) {
+    while(count > 0) {
+        int batch = count > CML_IOV_MAX ? CML_IOV_MAX : (int)count;
+        ssize_t written = writev(fd, buffers, batch);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        size_t remaining = (size_t)written;
+        while(count > 0 && remaining >= buffers->iov_len) {
+            remaining -= buffers->iov_len;
+            buffers++;
+            count--;
+        }
+        if(count > 0) {
+            buffers->iov_base = (char*)buffers->iov_base + remaining;
+            buffers->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+#endif
+
+static const char cml_sectionPadding[CML_MODEL_SECTION_ALIGNMENT] = {0};
+
+static bool cml_writeModelSections(const cml_Model model, const int fd, const cml_ModelSerializeOptions options) {
+    assert(fd >= 0);
+
+    cml_ModelSectionList sectionList = cml_createModelSectionList(model, options);
+    cml_ModelHeader header = cml_createModelHeader(model, sectionList.sections, sectionList.count);
+    cml_layoutModelSections(&header);
+
+    char* serializedHeader = (char*)malloc(header.headerSize);
+    cml_writeModelHeader(header, serializedHeader);
+
+    // header, then padding and data for each section
+    size_t bufferCount = 0;
+    struct iovec* buffers = (struct iovec*)malloc(sizeof(struct iovec) * (1 + 2 * sectionList.count));
+    buffers[bufferCount].iov_base = serializedHeader;
+    buffers[bufferCount].iov_len = header.headerSize;
+    bufferCount++;
+
+    size_t offset = header.headerSize;
+    for(size_t i = 0; i < sectionList.count; i++) {
+        const cml_ModelSection* section = &sectionList.sections[i];
+        if(section->offset > offset) {
+            buffers[bufferCount].iov_base = (void*)cml_sectionPadding;
+            buffers[bufferCount].iov_len = section->offset - offset;
+            bufferCount++;
+        }
+        buffers[bufferCount].iov_base = (void*)sectionList.sources[i];
+        buffers[bufferCount].iov_len = section->size;
+        bufferCount++;
+        offset = section->offset + section->size;
+    }
+
+    bool success = cml_writeVector(fd, buffers, bufferCount);
+
+    free(buffers);
+    free(serializedHeader);
+    cml_deleteModelSectionList(&sectionList);
+
+    return success;
+}
+
+bool cml_writeModel(const cml_Model model, const int fd) {
+    return cml_writeModelSections(model, fd, cml_createModelSerializeOptions());
+}
+
+bool cml_writeModelWeights(const cml_Model model, const int fd) {
+    cml_ModelSerializeOptions options = cml_createModelSerializeOptions();
+    options.weightsOnly = true;
+    return cml_writeModelSections(model, fd, options);
+}
+
+bool cml_writeModelWithOptions(const cml_Model model, const cml_ModelSerializeOptions options, const int fd) {
+    return cml_writeModelSections(model, fd, options);
+}
+
+static size_t cml_readFile(void* context, char* buffer, size_t size) {
+    return fread(buffer, 1, size, (FILE*)context);
+}
+
+// Keeps reading until size bytes arrived, returns false if the stream ends first
+static bool cml_readExactly(const cml_ModelReader reader, char* buffer, size_t size) {
+    while(size > 0) {
+        size_t chunk = size > CML_MODEL_READ_CHUNK_SIZE ? CML_MODEL_READ_CHUNK_SIZE : size;
+        size_t bytesRead = reader.read(reader.context, buffer, chunk);
+        if(bytesRead == 0) {
+            return false;
+        }
+        buffer += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+}
+
+// Reads and throws away size bytes, for padding and sections that aren't needed
+static bool cml_skipBytes(const cml_ModelReader reader, size_t size) {
+    char scratch[CML_MODEL_SECTION_ALIGNMENT * 16];
+    while(size > 0) {
+        size_t chunk = size > sizeof(scratch) ? sizeof(scratch) : size;
+        if(!cml_readExactly(reader, scratch, chunk)) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+// Where a section decodes to in model.data, NULL if the loader has no use for it
+static char* cml_getSectionDestination(const cml_ModelSection section, const cml_Model model, const cml_ModelMatrices modelMatrices) {
+    // offsets were checked against position already, the stream length is unknown
+    if(section.type == CML_SECTION_DATA && section.layer == 0 &&
+       cml_isModelSectionUsable(section, cml_getModelDataSize(model), (size_t)-1)) {
+        return (char*)model.data;
+    }
+    if(section.layer >= model.layerCount-1) {
+        return NULL;
+    }
+    size_t i = section.layer;
+    if(section.type == CML_SECTION_WEIGHTS &&
+       cml_isModelSectionUsable(section, sizeof(float) * model.layerSizes[i] * model.layerSizes[i+1], (size_t)-1)) {
+        return (char*)modelMatrices.weights[i].data;
+    }
+    if(section.type == CML_SECTION_BIASES &&
+       cml_isModelSectionUsable(section, sizeof(float) * model.layerSizes[i+1], (size_t)-1)) {
+        return (char*)modelMatrices.biases[i].data;
+    }
+    return NULL;
+}
+
+// Raw sections are read in place, encoded ones go through a buffer of their stored size
+// Returns false if the stream ends early or the section is corrupt
+static bool cml_readSection(
+    const cml_ModelReader reader, 
+    const cml_ModelHeader header, 
+    const cml_ModelSection section, 
+    char* destination) {
+
+    if(section.encoding == CML_ENCODING_RAW) {
+        return cml_readExactly(reader, destination, section.size) &&
+            cml_verifyModelSection(header, section, destination);
+    }
+    char* stored = (char*)malloc(section.size > 0 ? section.size : 1);
+    bool success = cml_readExactly(reader, stored, section.size) &&
+        cml_verifyModelSection(header, section, stored) &&
+        cml_decodeModelSection(section, stored, destination);
+    free(stored);
+    return success;
+}
+
+static int cml_compareSectionOffsets(const void* a, const void* b) {
+    uint64 offsetA = ((const cml_ModelSection*)a)->offset;
+    uint64 offsetB = ((const cml_ModelSection*)b)->offset;
+    return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+// Appends size bytes of reader to buffer, which holds *bufferSize bytes and is grown to fit.
+// Returns false if the input ends first or the header would grow past CML_MODEL_MAX_HEADER_SIZE
+static bool cml_readHeaderBytes(const cml_ModelReader reader, char** buffer, size_t* bufferSize, const uint64 size) {
+    if(size > CML_MODEL_MAX_HEADER_SIZE - *bufferSize) {
+        return false;
+    }
+    *buffer = (char*)realloc(*buffer, *bufferSize + size);
+    bool success = cml_readExactly(reader, *buffer + *bufferSize, size);
+    *bufferSize += size;
+    return success;
+}
+
+// The version 1 header has no size of its own, so it is read field by field up to the data block and
+// parsed by cml_readModelHeaderV1 once complete. serializedHeader holds the bytes read so far, at least
+// CML_MODEL_MAGIC_SIZE, and is freed
+static bool cml_readModelHeaderV1FromReader(const cml_ModelReader reader, char* serializedHeader, size_t headerSize,
+                                            cml_ModelHeader* header) {
+    size_t sizeofSize_t = (uint8)serializedHeader[0];
+    bool success = (sizeofSize_t == 4 || sizeofSize_t == 8) &&
+        cml_readHeaderBytes(reader, &serializedHeader, &headerSize, 1 + 2 * sizeofSize_t - headerSize);
+    uint64 layerCount = success ? cml_readModelSizeV1(serializedHeader + 1, sizeofSize_t) : 0;
+    success = success && layerCount >= 2 && layerCount <= CML_MODEL_MAX_HEADER_SIZE / 8 &&
+        cml_readHeaderBytes(reader, &serializedHeader, &headerSize, 8 * layerCount);
+    // gpuProgramFilename and gpuKernelName of each activation, then its id
+    for(uint64 i = 0; i < 2 * (layerCount-1) && success; i++) {
+        success = cml_readHeaderBytes(reader, &serializedHeader, &headerSize, sizeofSize_t) &&
+            cml_readHeaderBytes(reader, &serializedHeader, &headerSize,
+                cml_readModelSizeV1(serializedHeader + headerSize - sizeofSize_t, sizeofSize_t)) &&
+            (i % 2 == 0 || cml_readHeaderBytes(reader, &serializedHeader, &headerSize, 1));
+    }
+    success = success && cml_readModelHeaderV1(serializedHeader, headerSize, header);
+    free(serializedHeader);
+    return success;
+}
+
+bool cml_readModelHeaderFromReader(const cml_ModelReader reader, cml_ModelHeader* header) {
+    assert(reader.read != NULL);
+    assert(header != NULL);
+
+    // a version 1 header is longer than the magic, which is all that is read before telling them apart
+    char* serializedHeader = (char*)malloc(CML_MODEL_HEADER_PREFIX_SIZE);
+    if(!cml_readExactly(reader, serializedHeader, CML_MODEL_MAGIC_SIZE)) {
+        free(serializedHeader);
+        return false;
+    }
+    if(memcmp(serializedHeader, CML_MODEL_MAGIC, CML_MODEL_MAGIC_SIZE) != 0) {
+        return cml_readModelHeaderV1FromReader(reader, serializedHeader, CML_MODEL_MAGIC_SIZE, header);
+    }
+
+    // headerSize is at byte 16 of the prefix, see ModelFormat.h
+    size_t headerSize = CML_MODEL_MAGIC_SIZE;
+    bool headerRead = cml_readHeaderBytes(reader, &serializedHeader, &headerSize, CML_MODEL_HEADER_PREFIX_SIZE - headerSize) &&
+        cml_getModelFormatVersion(serializedHeader, headerSize) == CML_MODEL_FORMAT_VERSION;
+    uint64 storedHeaderSize = headerRead ? cml_readUint64LE(serializedHeader + 16) : 0;
+    headerRead = headerRead && storedHeaderSize >= CML_MODEL_HEADER_PREFIX_SIZE &&
+        cml_readHeaderBytes(reader, &serializedHeader, &headerSize, storedHeaderSize - headerSize) &&
+        cml_readModelHeader(serializedHeader, headerSize, header);
+    free(serializedHeader);
+    return headerRead;
+}
+
+bool cml_readModelHeaderFromFile(FILE* file, cml_ModelHeader* header) {
+    assert(file != NULL);
+
+    cml_ModelReader reader;
+    reader.read = cml_readFile;
+    reader.context = file;
+    return cml_readModelHeaderFromReader(reader, header);
+}
+
+cml_Model cml_readModelFromReader(const cml_ModelReader reader) {
+    assert(reader.read != NULL);
+
+    cml_ModelHeader header;
+    if(!cml_readModelHeaderFromReader(reader, &header)) {
+        return cml_createEmptyModel();
+    }
+    if(header.version != CML_MODEL_FORMAT_VERSION) {
+        cml_deleteModelHeader(&header);
+        return cml_createEmptyModel();
+    }
+
+    cml_Model model = cml_createScaledModel(header.layerCount, header.layerSizes, header.scale, header.activationFunctions);
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+
+    // a pipe can only go forward
+    qsort(header.sections, header.sectionCount, sizeof(cml_ModelSection), cml_compareSectionOffsets);
+
+    // weights and biases of each layer, or all of them at once through the data section
+    size_t layerSectionCount = 2 * (model.layerCount-1);
+    bool* layerSectionsRead = (bool*)calloc(layerSectionCount + 1, sizeof(bool));
+    bool hasData = false;
+    bool success = true;
+    uint64 position = header.headerSize;
+    for(size_t i = 0; i < header.sectionCount && success; i++) {
+        const cml_ModelSection section = header.sections[i];
+        if(section.offset < position) {
+            success = false;
+            break;
+        }
+
+        char* destination = cml_getSectionDestination(section, model, modelMatrices);
+        success = cml_skipBytes(reader, section.offset - position);
+        if(success && destination != NULL) {
+            success = cml_readSection(reader, header, section, destination);
+            if(section.type == CML_SECTION_DATA) {
+                hasData = true;
+            }
+            else {
+                layerSectionsRead[2 * section.layer + (section.type == CML_SECTION_BIASES)] = true;
+            }
+        }
+        else if(success) {
+            success = cml_skipBytes(reader, section.size);
+        }
+        position = section.offset + section.size;
+    }
+
+    for(size_t i = 0; i < layerSectionCount && success && !hasData; i++) {
+        success = layerSectionsRead[i];
+    }
+    free(layerSectionsRead);
+
+    cml_deleteModelMatrices(modelMatrices);
+    cml_deleteModelHeader(&header);
+    if(!success) {
+        cml_deleteModel(&model);
+        return cml_createEmptyModel();
+    }
+    return model;
+}
+
+cml_Model cml_readModel(FILE* file) {
+    assert(file != NULL);
+
+    cml_ModelReader reader;
+    reader.read = cml_readFile;
+    reader.context = file;
+    return cml_readModelFromReader(reader);
+}
+
+cml_Model cml_readModelFd(const int fd) {
+    assert(fd >= 0);
+
+    int descriptor = fd;
+    cml_ModelReader reader;
+    reader.read = cml_readFd;
+    reader.context = &descriptor;
+    return cml_readModelFromReader(reader);
+}
@@ -0,0 +1,198 @@
+#include <cml/MultiGPU.h>
+#include <cml/GPUKernels.h>
+#include <cml/util/Clock.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cml_MultiGPUExecutor cml_emptyMultiGPUExecutor() {
+    cml_MultiGPUExecutor executor;
+    memset(&executor, 0, sizeof(executor));
+    return executor;
+}
+
+static void cml_deleteMultiGPUDevice(cml_MultiGPUDevice* device) {
+    if(device->stream.slots != NULL) {
+        cml_deleteGPUStream(&device->stream);
+    }
+    cml_unbindModelGPU(&device->boundModel);
+    if(device->gpu.context != NULL) {
+        cml_releaseGPUPrograms(&device->gpu);
+        cml_deleteGPU(&device->gpu);
+    }
+    memset(device, 0, sizeof(*device));
+}
+
+// Sets up gpu, weights and stream in place, the bound model keeps a pointer to device->gpu
+static bool cml_createMultiGPUDevice(cml_MultiGPUDevice* device, const cml_Model model, cl_device_id deviceId) {
+    device->gpu = cml_setupGPUForDevice(deviceId);
+    if(device->gpu.context == NULL) {
+        return false;
+    }
+    device->boundModel = cml_bindModelGPU(model, &device->gpu);
+    if(device->boundModel.weights == NULL) {
+        return false;
+    }
+    device->stream = cml_createGPUStream(device->boundModel, CML_GPU_STREAM_DEFAULT_SLOTS);
+    return device->stream.slots != NULL;
+}
+
+cml_MultiGPUExecutor cml_createMultiGPUExecutor(const cml_Model model, const uint8 maxDevices) {
+    assert(model.data != NULL);
+
+    cml_MultiGPUExecutor executor = cml_emptyMultiGPUExecutor();
+    cml_DeviceArray deviceIds = cml_getGPUsWithCUDASupport(CML_MULTI_GPU_MAX_PLATFORMS, maxDevices);
+    if(deviceIds.count == 0) {
+        cml_deleteDeviceArray(&deviceIds);
+        return executor;
+    }
+
+    // calloc so a failed device only releases what was created
+    executor.devices = (cml_MultiGPUDevice*)calloc(deviceIds.count, sizeof(cml_MultiGPUDevice));
+    for(size_t i = 0; i < deviceIds.count; i++) {
+        cml_MultiGPUDevice* device = &executor.devices[executor.deviceCount];
+        if(cml_createMultiGPUDevice(device, model, deviceIds.deviceIds[i])) {
+            executor.deviceCount++;
+        } else {
+            cml_deleteMultiGPUDevice(device);
+        }
+    }
+    cml_deleteDeviceArray(&deviceIds);
+    if(executor.deviceCount == 0) {
+        free(executor.devices);
+        return cml_emptyMultiGPUExecutor();
+    }
+
+    executor.scale = model.scale;
+    executor.inputSize = model.layerSizes[0];
+    executor.outputSize = model.layerSizes[model.layerCount-1];
+    executor.threads = cml_createThreadPool(executor.deviceCount);
+    return executor;
+}
+
+void cml_deleteMultiGPUExecutor(cml_MultiGPUExecutor* executor) {
+    assert(executor != NULL);
+
+    for(size_t i = 0; i < executor->deviceCount; i++) {
+        cml_deleteMultiGPUDevice(&executor->devices[i]);
+    }
+    free(executor->devices);
+    if(executor->threads != NULL) {
+        cml_deleteThreadPool(executor->threads);
+    }
+    *executor = cml_emptyMultiGPUExecutor();
+}
+
+void cml_getMultiGPUShards(const cml_MultiGPUExecutor executor, const size_t rowCount, size_t* rows) {
+    assert(executor.deviceCount > 0);
+    assert(rows != NULL);
+
+    // rows per second are the inverse of the times, devices not timed yet get the average of the others
+    double measuredSpeed = 0;
+    size_t measuredCount = 0;
+    for(size_t i = 0; i < executor.deviceCount; i++) {
+        if(executor.devices[i].secondsPerRow > 0) {
+            measuredSpeed += 1.0 / executor.devices[i].secondsPerRow;
+            measuredCount++;
+        }
+    }
+    double averageSpeed = measuredCount > 0 ? measuredSpeed / (double)measuredCount : 1.0;
+    double totalSpeed = measuredSpeed + averageSpeed * (double)(executor.deviceCount - measuredCount);
+
+    // shards are counted in batches of scale rows, every stream pads its last batch to a whole one. Each
+    // device gets its share rounded down, the batches left over go one each to the largest remainders
+    size_t batchCount = (rowCount + executor.scale - 1) / executor.scale;
+    size_t assigned = 0;
+    for(size_t i = 0; i < executor.deviceCount; i++) {
+        double speed = executor.devices[i].secondsPerRow > 0 ? 1.0 / executor.devices[i].secondsPerRow : averageSpeed;
+        rows[i] = (size_t)((double)batchCount * speed / totalSpeed);
+        assigned += rows[i];
+    }
+    while(assigned < batchCount) {
+        size_t largest = 0;
+        double largestRemainder = -1;
+        for(size_t i = 0; i < executor.deviceCount; i++) {
+            double speed = executor.devices[i].secondsPerRow > 0 ? 1.0 / executor.devices[i].secondsPerRow : averageSpeed;
+            double remainder = (double)batchCount * speed / totalSpeed - (double)rows[i];
+            if(remainder > largestRemainder) {
+                largest = i;
+                largestRemainder = remainder;
+            }
+        }
+        rows[largest]++;
+        assigned++;
+    }
+
+    // batches to rows, the shard holding the last row ends there
+    size_t firstRow = 0;
+    for(size_t i = 0; i < executor.deviceCount; i++) {
+        size_t shardRows = rows[i] * executor.scale;
+        rows[i] = rowCount - firstRow < shardRows ? rowCount - firstRow : shardRows;
+        firstRow += rows[i];
+    }
+}
+
+// A predict split in shards, task i runs the shard of device i
+typedef struct {
+    cml_MultiGPUExecutor* executor;
+    const float* in;
+    float* out;
+    size_t* firstRows;
+    size_t* rows;
+    bool* successes;
+    double* seconds;
+} cml_MultiGPUBatch;
+
+static void cml_runMultiGPUShard(void* context, const size_t index) {
+    cml_MultiGPUBatch* batch = (cml_MultiGPUBatch*)context;
+    cml_MultiGPUExecutor* executor = batch->executor;
+    if(batch->rows[index] == 0) {
+        batch->successes[index] = true;
+        return;
+    }
+    double start = cml_getSeconds();
+    batch->successes[index] = cml_predictStreamGPU(&executor->devices[index].stream,
+        batch->in + batch->firstRows[index] * executor->inputSize,
+        batch->out + batch->firstRows[index] * executor->outputSize,
+        batch->rows[index]);
+    batch->seconds[index] = cml_getSeconds() - start;
+}
+
+bool cml_predictMultiGPU(cml_MultiGPUExecutor* executor, const float* in, float* out, const size_t rowCount) {
+    assert(executor != NULL);
+    assert(executor->deviceCount > 0);
+    assert(in != NULL);
+    assert(out != NULL);
+
+    size_t deviceCount = executor->deviceCount;
+    cml_MultiGPUBatch batch;
+    batch.executor = executor;
+    batch.in = in;
+    batch.out = out;
+    batch.firstRows = (size_t*)malloc(sizeof(size_t) * deviceCount);
+    batch.rows = (size_t*)malloc(sizeof(size_t) * deviceCount);
+    batch.successes = (bool*)calloc(deviceCount, sizeof(bool));
+    batch.seconds = (double*)calloc(deviceCount, sizeof(double));
+    cml_getMultiGPUShards(*executor, rowCount, batch.rows);
+    size_t firstRow = 0;
+    for(size_t i = 0; i < deviceCount; i++) {
+        batch.firstRows[i] = firstRow;
+        firstRow += batch.rows[i];
+    }
+    cml_runTasks(executor->threads, cml_runMultiGPUShard, &batch, deviceCount);
+
+    // devices that failed keep their previous time, the failure may have cut their shard short
+    bool success = true;
+    for(size_t i = 0; i < deviceCount; i++) {
+        success = success && batch.successes[i];
+        if(batch.successes[i]) {
+            cml_updateSecondsPerRow(&executor->devices[i].secondsPerRow, batch.seconds[i], batch.rows[i]);
+        }
+    }
+    free(batch.firstRows);
+    free(batch.rows);
+    free(batch.successes);
+    free(batch.seconds);
+    return success;
+}
@@ -30,10 +30,10 @@ void cml_deleteActivationFnMetadata(cml_ActivationFnMetadata* metadata) {
     assert(metadata != NULL);
     
     if(metadata->gpuProgramFilename.size != 0) {
-        cml_deleteString(&metadata->gpuKernelName);
+        cml_deleteString(&metadata->gpuProgramFilename);
     }
     if(metadata->gpuKernelName.size != 0) {
-        cml_deleteString(&metadata->gpuProgramFilename);
+        cml_deleteString(&metadata->gpuKernelName);
     }
     metadata->activationID = CML_NONE;
 }
@@ -65,17 +65,20 @@ size_t cml_getActivationFnMetadataSize(cml_ActivationFnMetadata metadata) {
 }
 
 cml_String cml_serializeActivationFnMetadata(cml_ActivationFnMetadata metadata) {
-    cml_String gpuProgramFilename = cml_serializeString(metadata.gpuProgramFilename);
-    cml_String gpuKernelName = cml_serializeString(metadata.gpuKernelName);
-    cml_String serializedMetadata = cml_createNewString(gpuProgramFilename.size + gpuKernelName.size + 1);
-
-    memcpy(serializedMetadata.data, gpuProgramFilename.data, gpuProgramFilename.size);
-    memcpy(serializedMetadata.data + gpuProgramFilename.size, gpuKernelName.data, gpuKernelName.size);
+    // written in place rather than through cml_serializeString to avoid a temporary string per field
+    cml_String serializedMetadata = cml_createNewString(cml_getActivationFnMetadataSize(metadata));
+
+    size_t offset = 0;
+    memcpy(serializedMetadata.data + offset, &metadata.gpuProgramFilename.size, sizeof(size_t));
+    offset += sizeof(size_t);
+    memcpy(serializedMetadata.data + offset, metadata.gpuProgramFilename.data, metadata.gpuProgramFilename.size);
+    offset += metadata.gpuProgramFilename.size;
+    memcpy(serializedMetadata.data + offset, &metadata.gpuKernelName.size, sizeof(size_t));
+    offset += sizeof(size_t);
+    memcpy(serializedMetadata.data + offset, metadata.gpuKernelName.data, metadata.gpuKernelName.size);
+    offset += metadata.gpuKernelName.size;
     unsigned char activationID = (unsigned char)metadata.activationID;
-    serializedMetadata.data[serializedMetadata.size-1] = activationID;
-
-    cml_deleteString(&gpuProgramFilename);
-    cml_deleteString(&gpuKernelName);
+    serializedMetadata.data[offset] = activationID;
 
     return serializedMetadata;
 }
@@ -0,0 +1,42 @@
+// clock_gettime is POSIX, not C99
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <cml/util/Clock.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef _WIN32
+
+double cml_getSeconds() {
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+#else
+
+double cml_getSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+#endif
+
+void cml_updateSecondsPerRow(double* secondsPerRow, const double seconds, const size_t rows) {
+    if(rows == 0) {
+        return;
+    }
+    double measured = seconds / (double)rows;
+    *secondsPerRow = *secondsPerRow > 0
+        ? *secondsPerRow + CML_TIMING_SMOOTHING * (measured - *secondsPerRow)
+        : measured;
+}
@@ -0,0 +1,248 @@
+#include <cml/util/Compression.h>
+#include <intdefs.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CML_COMPRESSION_SSE2
+#endif
+
+#define CML_LZ_HASH_BITS 14
+#define CML_LZ_MIN_MATCH 4
+#define CML_LZ_MAX_OFFSET 0xFFFF
+
+// bytes 0..3 of every float go to planes 0..3, trailing bytes that don't make a float are kept as is
+static void cml_shuffleFloatBytes(const uint8* source, const size_t size, uint8* destination) {
+    size_t floatCount = size / 4;
+    for(size_t i = 0; i < floatCount; i++) {
+        for(size_t plane = 0; plane < 4; plane++) {
+            destination[plane * floatCount + i] = source[i * 4 + plane];
+        }
+    }
+    memcpy(destination + floatCount * 4, source + floatCount * 4, size - floatCount * 4);
+}
+
+static void cml_unshuffleFloatBytes(const uint8* source, const size_t size, uint8* destination) {
+    size_t floatCount = size / 4;
+    const uint8* plane0 = source;
+    const uint8* plane1 = source + floatCount;
+    const uint8* plane2 = source + floatCount * 2;
+    const uint8* plane3 = source + floatCount * 3;
+
+    size_t i = 0;
+#ifdef CML_COMPRESSION_SSE2
+    // 16 floats per iteration, interleave bytes then byte pairs back into whole floats
+    for(; i + 16 <= floatCount; i += 16) {
+        __m128i bytes0 = _mm_loadu_si128((const __m128i*)(plane0 + i));
+        __m128i bytes1 = _mm_loadu_si128((const __m128i*)(plane1 + i));
+        __m128i bytes2 = _mm_loadu_si128((const __m128i*)(plane2 + i));
+        __m128i bytes3 = _mm_loadu_si128((const __m128i*)(plane3 + i));
+
+        __m128i low01 = _mm_unpacklo_epi8(bytes0, bytes1);
+        __m128i high01 = _mm_unpackhi_epi8(bytes0, bytes1);
+        __m128i low23 = _mm_unpacklo_epi8(bytes2, bytes3);
+        __m128i high23 = _mm_unpackhi_epi8(bytes2, bytes3);
+
+        __m128i* out = (__m128i*)(destination + i * 4);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(low01, low23));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low01, low23));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high01, high23));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high01, high23));
+    }
+#endif
+    for(; i < floatCount; i++) {
+        destination[i * 4] = plane0[i];
+        destination[i * 4 + 1] = plane1[i];
+        destination[i * 4 + 2] = plane2[i];
+        destination[i * 4 + 3] = plane3[i];
+    }
+    memcpy(destination + floatCount * 4, source + floatCount * 4, size - floatCount * 4);
+}
+
+static uint32 cml_read32(const uint8* source) {
+    uint32 value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+static size_t cml_hash32(const uint32 value) {
+    return (size_t)((value * 2654435761u) >> (32 - CML_LZ_HASH_BITS));
+}
+
+// length is what is left over after the 15 stored in the token
+static uint8* cml_writeLengthExtension(uint8* out, size_t length) {
+    while(length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8)length;
+    return out;
+}
+
+// Returns false if the extension runs past end
+static bool cml_readLengthExtension(const uint8** in, const uint8* end, size_t* length) {
+    uint8 byte;
+    do {
+        if(*in >= end) {
+            return false;
+        }
+        byte = *(*in)++;
+        *length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+static uint8* cml_writeSequence(uint8* out, const uint8* literals, const size_t literalCount, const size_t offset, const size_t matchLength) {
+    size_t matchCode = matchLength > 0 ? matchLength - CML_LZ_MIN_MATCH : 0;
+    uint8* token = out++;
+    *token = (uint8)((literalCount >= 15 ? 15 : literalCount) << 4);
+    if(literalCount >= 15) {
+        out = cml_writeLengthExtension(out, literalCount - 15);
+    }
+    memcpy(out, literals, literalCount);
+    out += literalCount;
+
+    // the last sequence of the stream has literals only
+    if(matchLength == 0) {
+        return out;
+    }
+    *token |= (uint8)(matchCode >= 15 ? 15 : matchCode);
+    *out++ = (uint8)(offset & 0xFF);
+    *out++ = (uint8)(offset >> 8);
+    if(matchCode >= 15) {
+        out = cml_writeLengthExtension(out, matchCode - 15);
+    }
+    return out;
+}
+
+static size_t cml_compressLZ(const uint8* source, const size_t size, uint8* destination) {
+    size_t* table = (size_t*)calloc((size_t)1 << CML_LZ_HASH_BITS, sizeof(size_t));
+    uint8* out = destination;
+
+    size_t anchor = 0;
+    size_t position = 0;
+    while(position + CML_LZ_MIN_MATCH <= size) {
+        uint32 value = cml_read32(source + position);
+        size_t hash = cml_hash32(value);
+        size_t candidate = table[hash];
+        table[hash] = position;
+
+        // the table starts out zeroed, comparing the bytes covers that too
+        if(candidate >= position || position - candidate > CML_LZ_MAX_OFFSET || cml_read32(source + candidate) != value) {
+            position++;
+            continue;
+        }
+
+        size_t matchLength = CML_LZ_MIN_MATCH;
+        while(position + matchLength < size && source[candidate + matchLength] == source[position + matchLength]) {
+            matchLength++;
+        }
+        out = cml_writeSequence(out, source + anchor, position - anchor, position - candidate, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+    out = cml_writeSequence(out, source + anchor, size - anchor, 0, 0);
+
+    free(table);
+    return (size_t)(out - destination);
+}
+
+static bool cml_decompressLZ(const uint8* source, const size_t compressedSize, uint8* destination, const size_t size) {
+    const uint8* in = source;
+    const uint8* inEnd = source + compressedSize;
+    uint8* out = destination;
+    uint8* outEnd = destination + size;
+
+    while(true) {
+        if(in >= inEnd) {
+            return false;
+        }
+        uint8 token = *in++;
+
+        size_t literalCount = token >> 4;
+        if(literalCount == 15 && !cml_readLengthExtension(&in, inEnd, &literalCount)) {
+            return false;
+        }
+        if(literalCount > (size_t)(inEnd - in) || literalCount > (size_t)(outEnd - out)) {
+            return false;
+        }
+        memcpy(out, in, literalCount);
+        in += literalCount;
+        out += literalCount;
+
+        // the stream ends right after the literals of the last sequence
+        if(in == inEnd) {
+            break;
+        }
+
+        if(inEnd - in < 2) {
+            return false;
+        }
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t matchLength = (token & 15);
+        if(matchLength == 15 && !cml_readLengthExtension(&in, inEnd, &matchLength)) {
+            return false;
+        }
+        matchLength += CML_LZ_MIN_MATCH;
+        if(offset == 0 || offset > (size_t)(out - destination) || matchLength > (size_t)(outEnd - out)) {
+            return false;
+        }
+
+        const uint8* match = out - offset;
+        if(offset >= 16) {
+            // chunks of 16 never overlap at this distance, each memcpy is a single vector move
+            while(matchLength >= 16) {
+                memcpy(out, match, 16);
+                out += 16;
+                match += 16;
+                matchLength -= 16;
+            }
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        }
+        else {
+            // overlapping copy repeats the pattern
+            for(size_t i = 0; i < matchLength; i++) {
+                out[i] = match[i];
+            }
+            out += matchLength;
+        }
+    }
+
+    return out == outEnd;
+}
+
+size_t cml_getMaxCompressedSize(const size_t size) {
+    // all literals: token, length extension and the bytes themselves
+    return size + size / 255 + 16;
+}
+
+size_t cml_compressFloats(const char* source, const size_t size, char* destination) {
+    assert(source != NULL || size == 0);
+    assert(destination != NULL);
+
+    uint8* shuffled = (uint8*)malloc(size > 0 ? size : 1);
+    cml_shuffleFloatBytes((const uint8*)source, size, shuffled);
+    size_t compressedSize = cml_compressLZ(shuffled, size, (uint8*)destination);
+    free(shuffled);
+
+    return compressedSize;
+}
+
+bool cml_decompressFloats(const char* source, const size_t compressedSize, char* destination, const size_t size) {
+    assert(source != NULL);
+    assert(destination != NULL || size == 0);
+
+    uint8* shuffled = (uint8*)malloc(size > 0 ? size : 1);
+    bool success = cml_decompressLZ((const uint8*)source, compressedSize, shuffled, size);
+    if(success) {
+        cml_unshuffleFloatBytes(shuffled, size, (uint8*)destination);
+    }
+    free(shuffled);
+
+    return success;
+}
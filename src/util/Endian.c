@@ -0,0 +1,38 @@
+#include <cml/util/Endian.h>
+
+void cml_writeUint16LE(char* destination, const uint16 value) {
+    destination[0] = (char)(value & 0xFF);
+    destination[1] = (char)((value >> 8) & 0xFF);
+}
+
+void cml_writeUint32LE(char* destination, const uint32 value) {
+    for(int i = 0; i < 4; i++) {
+        destination[i] = (char)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void cml_writeUint64LE(char* destination, const uint64 value) {
+    for(int i = 0; i < 8; i++) {
+        destination[i] = (char)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint16 cml_readUint16LE(const char* source) {
+    return (uint16)((uint8)source[0] | (uint8)source[1] << 8);
+}
+
+uint32 cml_readUint32LE(const char* source) {
+    uint32 value = 0;
+    for(int i = 0; i < 4; i++) {
+        value |= (uint32)(uint8)source[i] << (8 * i);
+    }
+    return value;
+}
+
+uint64 cml_readUint64LE(const char* source) {
+    uint64 value = 0;
+    for(int i = 0; i < 8; i++) {
+        value |= (uint64)(uint8)source[i] << (8 * i);
+    }
+    return value;
+}
@@ -0,0 +1,143 @@
+#include <cml/util/MappedFile.h>
+
+#include <assert.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static cml_MappedFile cml_emptyMappedFile() {
+    cml_MappedFile file;
+    file.data = NULL;
+    file.size = 0;
+    file.offset = 0;
+    return file;
+}
+
+// size of 0 maps everything after offset
+#define CML_MAP_TO_END 0
+
+#ifdef _WIN32
+
+static cml_MappedFile cml_mapFileSection(const char* filename, const size_t offset, const size_t size) {
+    assert(filename != NULL);
+
+    cml_MappedFile file = cml_emptyMappedFile();
+
+    HANDLE fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(fileHandle == INVALID_HANDLE_VALUE) {
+        return file;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle, &fileSize) || (size_t)fileSize.QuadPart <= offset ||
+       (size != CML_MAP_TO_END && (size_t)fileSize.QuadPart - offset < size)) {
+        CloseHandle(fileHandle);
+        return file;
+    }
+    size_t mappedSize = size != CML_MAP_TO_END ? size : (size_t)fileSize.QuadPart - offset;
+
+    // views have to start at a multiple of the allocation granularity
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    size_t alignedOffset = offset - offset % systemInfo.dwAllocationGranularity;
+
+    // PAGE_WRITECOPY + FILE_MAP_COPY is the Windows equivalent of MAP_PRIVATE
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if(mappingHandle != NULL) {
+        char* view = (char*)MapViewOfFile(
+            mappingHandle, 
+            FILE_MAP_COPY, 
+            (DWORD)((ULONGLONG)alignedOffset >> 32), 
+            (DWORD)(alignedOffset & 0xFFFFFFFF), 
+            mappedSize + (offset - alignedOffset));
+        if(view != NULL) {
+            file.offset = offset - alignedOffset;
+            file.data = view + file.offset;
+            file.size = mappedSize;
+        }
+    }
+
+    // the view keeps the mapping and file alive on its own
+    if(mappingHandle != NULL) {
+        CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+
+    return file;
+}
+
+void cml_unmapFile(cml_MappedFile* file) {
+    assert(file != NULL);
+
+    if(file->data != NULL) {
+        UnmapViewOfFile(file->data - file->offset);
+    }
+    *file = cml_emptyMappedFile();
+}
+
+#else
+
+static cml_MappedFile cml_mapFileSection(const char* filename, const size_t offset, const size_t size) {
+    assert(filename != NULL);
+
+    cml_MappedFile file = cml_emptyMappedFile();
+
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        return file;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size <= offset ||
+       (size != CML_MAP_TO_END && (size_t)fileStat.st_size - offset < size)) {
+        close(fd);
+        return file;
+    }
+    size_t mappedSize = size != CML_MAP_TO_END ? size : (size_t)fileStat.st_size - offset;
+
+    // mappings have to start on a page boundary
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset - offset % pageSize;
+
+    size_t leading = offset - alignedOffset;
+    void* address = mmap(NULL, mappedSize + leading, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)alignedOffset);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if(address == MAP_FAILED) {
+        return file;
+    }
+
+    file.data = (char*)address + leading;
+    file.size = mappedSize;
+    file.offset = leading;
+    return file;
+}
+
+void cml_unmapFile(cml_MappedFile* file) {
+    assert(file != NULL);
+
+    if(file->data != NULL) {
+        munmap(file->data - file->offset, file->size + file->offset);
+    }
+    *file = cml_emptyMappedFile();
+}
+
+#endif
+
+cml_MappedFile cml_mapFile(const char* filename) {
+    return cml_mapFileSection(filename, 0, CML_MAP_TO_END);
+}
+
+cml_MappedFile cml_mapFileRange(const char* filename, const size_t offset, const size_t size) {
+    if(size == 0) {
+        return cml_emptyMappedFile();
+    }
+    return cml_mapFileSection(filename, offset, size);
+}
@@ -0,0 +1,371 @@
+#include <cml/util/Npy.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sanity limit when opening, a corrupt header size should not turn into a huge allocation
+#define CML_NPY_MAX_HEADER_SIZE 0x100000
+// float64 values converted per read
+#define CML_NPY_CONVERT_CHUNK 1024
+// magic, version and the 2 byte header size of version 1.0
+#define CML_NPY_PREFIX_SIZE 10
+
+static cml_NpyReader cml_emptyNpyReader() {
+    cml_NpyReader reader;
+    memset(&reader, 0, sizeof(reader));
+    return reader;
+}
+
+static cml_NpyWriter cml_emptyNpyWriter() {
+    cml_NpyWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    return writer;
+}
+
+static bool cml_isHostBigEndian() {
+    const uint16 one = 1;
+    uint8 firstByte;
+    memcpy(&firstByte, &one, 1);
+    return firstByte == 0;
+}
+
+static void cml_swapBytes(char* value, const size_t size) {
+    for(size_t i = 0; i < size / 2; i++) {
+        char byte = value[i];
+        value[i] = value[size - 1 - i];
+        value[size - 1 - i] = byte;
+    }
+}
+
+// Returns the value after "'key':" with leading spaces skipped, NULL if the key is missing
+static const char* cml_findNpyHeaderValue(const char* header, const char* key) {
+    const char* value = strstr(header, key);
+    if(value == NULL) {
+        return NULL;
+    }
+    value += strlen(key);
+    while(*value == ' ') {
+        value++;
+    }
+    if(*value != ':') {
+        return NULL;
+    }
+    value++;
+    while(*value == ' ') {
+        value++;
+    }
+    return value;
+}
+
+// Fills in type, byte order, order and shape from the header dictionary, e.g.
+// {'descr': '<f4', 'fortran_order': False, 'shape': (3, 2), }
+static bool cml_parseNpyHeader(const char* header, cml_NpyReader* reader) {
+    const char* descr = cml_findNpyHeaderValue(header, "'descr'");
+    if(descr == NULL || *descr != '\'' || (descr[1] != '<' && descr[1] != '>') ||
+       descr[2] != 'f' || (descr[3] != '4' && descr[3] != '8') || descr[4] != '\'') {
+        return false;
+    }
+    if(descr[3] == '4') {
+        reader->type = CML_NPY_FLOAT32;
+    }
+    else {
+        reader->type = CML_NPY_FLOAT64;
+    }
+    reader->bigEndian = descr[1] == '>';
+
+    const char* fortranOrder = cml_findNpyHeaderValue(header, "'fortran_order'");
+    if(fortranOrder == NULL) {
+        return false;
+    }
+    if(strncmp(fortranOrder, "True", 4) == 0) {
+        reader->fortranOrder = true;
+    }
+    else if(strncmp(fortranOrder, "False", 5) == 0) {
+        reader->fortranOrder = false;
+    }
+    else {
+        return false;
+    }
+
+    const char* shape = cml_findNpyHeaderValue(header, "'shape'");
+    if(shape == NULL || *shape != '(') {
+        return false;
+    }
+    shape++;
+    size_t dimensions[2];
+    size_t dimensionCount = 0;
+    while(true) {
+        while(*shape == ' ') {
+            shape++;
+        }
+        if(*shape == ')') {
+            break;
+        }
+        if(dimensionCount == 2 || *shape < '0' || *shape > '9') {
+            return false;
+        }
+        size_t dimension = 0;
+        for(; *shape >= '0' && *shape <= '9'; shape++) {
+            size_t digit = (size_t)(*shape - '0');
+            if(dimension > (SIZE_MAX - digit) / 10) {
+                return false;
+            }
+            dimension = dimension * 10 + digit;
+        }
+        dimensions[dimensionCount++] = dimension;
+        while(*shape == ' ') {
+            shape++;
+        }
+        if(*shape == ',') {
+            shape++;
+        }
+        else if(*shape != ')') {
+            return false;
+        }
+    }
+
+    reader->rows = dimensionCount == 2 ? dimensions[0] : 1;
+    reader->cols = dimensionCount == 0 ? 1 : dimensions[dimensionCount - 1];
+    // a single row or column is laid out the same in both orders
+    if(reader->rows == 1 || reader->cols == 1) {
+        reader->fortranOrder = false;
+    }
+    // the file offset of the last value has to fit in a size_t
+    return reader->cols == 0 || reader->rows <= SIZE_MAX / sizeof(double) / reader->cols;
+}
+
+cml_NpyReader cml_openNpyAt(FILE* file) {
+    assert(file != NULL);
+
+    char prefix[CML_NPY_PREFIX_SIZE + 2];
+    if(fread(prefix, 1, CML_NPY_PREFIX_SIZE, file) != CML_NPY_PREFIX_SIZE ||
+       memcmp(prefix, CML_NPY_MAGIC, CML_NPY_MAGIC_SIZE) != 0) {
+        return cml_emptyNpyReader();
+    }
+
+    // version 1.0 has a 2 byte header size, 2.0 and 3.0 a 4 byte one
+    size_t headerSize = (uint8)prefix[8] | (size_t)(uint8)prefix[9] << 8;
+    if(prefix[6] == 2 || prefix[6] == 3) {
+        if(fread(prefix + CML_NPY_PREFIX_SIZE, 1, 2, file) != 2) {
+            return cml_emptyNpyReader();
+        }
+        headerSize |= (size_t)(uint8)prefix[10] << 16 | (size_t)(uint8)prefix[11] << 24;
+    }
+    else if(prefix[6] != 1) {
+        return cml_emptyNpyReader();
+    }
+    if(headerSize > CML_NPY_MAX_HEADER_SIZE) {
+        return cml_emptyNpyReader();
+    }
+
+    char* header = (char*)malloc(headerSize + 1);
+    cml_NpyReader reader = cml_emptyNpyReader();
+    bool success = fread(header, 1, headerSize, file) == headerSize;
+    header[headerSize] = '\0';
+    success = success && cml_parseNpyHeader(header, &reader);
+    free(header);
+    if(!success) {
+        return cml_emptyNpyReader();
+    }
+
+    reader.file = file;
+    return reader;
+}
+
+cml_NpyReader cml_openNpy(const char* filename) {
+    assert(filename != NULL);
+
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        return cml_emptyNpyReader();
+    }
+    cml_NpyReader reader = cml_openNpyAt(file);
+    if(reader.file == NULL) {
+        fclose(file);
+        return reader;
+    }
+    reader.ownsFile = true;
+    return reader;
+}
+
+void cml_closeNpy(cml_NpyReader* reader) {
+    assert(reader != NULL);
+
+    if(reader->ownsFile) {
+        fclose(reader->file);
+    }
+    *reader = cml_emptyNpyReader();
+}
+
+// Reads count values in file order as floats
+// Returns the number of values read
+static size_t cml_readNpyValues(cml_NpyReader* reader, float* destination, const size_t count) {
+    bool swap = reader->bigEndian != cml_isHostBigEndian();
+    if(reader->type == CML_NPY_FLOAT32) {
+        // straight into the destination, only swapped in place if needed
+        size_t valuesRead = fread(destination, sizeof(float), count, reader->file);
+        for(size_t i = 0; swap && i < valuesRead; i++) {
+            cml_swapBytes((char*)&destination[i], sizeof(float));
+        }
+        return valuesRead;
+    }
+
+    double values[CML_NPY_CONVERT_CHUNK];
+    size_t valuesRead = 0;
+    while(valuesRead < count) {
+        size_t chunkSize = count - valuesRead < CML_NPY_CONVERT_CHUNK ? count - valuesRead : CML_NPY_CONVERT_CHUNK;
+        size_t chunkRead = fread(values, sizeof(double), chunkSize, reader->file);
+        for(size_t i = 0; i < chunkRead; i++) {
+            if(swap) {
+                cml_swapBytes((char*)&values[i], sizeof(double));
+            }
+            destination[valuesRead + i] = (float)values[i];
+        }
+        valuesRead += chunkRead;
+        if(chunkRead != chunkSize) {
+            break;
+        }
+    }
+    return valuesRead;
+}
+
+size_t cml_readNpyRows(cml_NpyReader* reader, float* destination, const size_t rowCount) {
+    assert(reader != NULL && reader->file != NULL);
+    assert(destination != NULL || rowCount == 0);
+
+    if(reader->fortranOrder) {
+        return 0;
+    }
+    size_t remainingRows = reader->rows - reader->rowsRead;
+    size_t rowsToRead = rowCount < remainingRows ? rowCount : remainingRows;
+    if(reader->cols == 0) {
+        reader->rowsRead += rowsToRead;
+        return rowsToRead;
+    }
+
+    size_t valuesRead = cml_readNpyValues(reader, destination, rowsToRead * reader->cols);
+    size_t rowsRead = valuesRead / reader->cols;
+    reader->rowsRead += rowsRead;
+    return rowsRead;
+}
+
+// Transposes a Fortran order array chunk by chunk, the file holds one column after another
+static bool cml_readNpyMatrixTransposed(cml_NpyReader* reader, cml_Matrix matrix) {
+    float values[CML_NPY_CONVERT_CHUNK];
+    size_t count = matrix.rows * matrix.cols;
+    size_t row = 0;
+    size_t col = 0;
+    for(size_t valuesRead = 0; valuesRead < count;) {
+        size_t chunkSize = count - valuesRead < CML_NPY_CONVERT_CHUNK ? count - valuesRead : CML_NPY_CONVERT_CHUNK;
+        if(cml_readNpyValues(reader, values, chunkSize) != chunkSize) {
+            return false;
+        }
+        for(size_t i = 0; i < chunkSize; i++) {
+            matrix.data[row * matrix.cols + col] = values[i];
+            if(++row == matrix.rows) {
+                row = 0;
+                col++;
+            }
+        }
+        valuesRead += chunkSize;
+    }
+    reader->rowsRead = reader->rows;
+    return true;
+}
+
+bool cml_readNpyMatrix(cml_NpyReader* reader, cml_Matrix matrix) {
+    assert(reader != NULL && reader->file != NULL);
+    assert(matrix.data != NULL || matrix.rows * matrix.cols == 0);
+
+    if(reader->rowsRead != 0 || reader->rows != matrix.rows || reader->cols != matrix.cols) {
+        return false;
+    }
+    if(reader->fortranOrder) {
+        return cml_readNpyMatrixTransposed(reader, matrix);
+    }
+    return cml_readNpyRows(reader, matrix.data, matrix.rows) == matrix.rows;
+}
+
+void cml_writeNpyHeader(char* out, const size_t rows, const size_t cols, const bool oneDimensional) {
+    assert(out != NULL);
+
+    // padded with spaces up to the newline that ends the header, so the data is 64 byte aligned
+    memset(out, ' ', CML_NPY_WRITE_HEADER_SIZE);
+    memcpy(out, CML_NPY_MAGIC, CML_NPY_MAGIC_SIZE);
+    out[6] = 1;
+    out[7] = 0;
+    out[8] = (char)((CML_NPY_WRITE_HEADER_SIZE - CML_NPY_PREFIX_SIZE) & 0xFF);
+    out[9] = (char)((CML_NPY_WRITE_HEADER_SIZE - CML_NPY_PREFIX_SIZE) >> 8);
+
+    char header[CML_NPY_WRITE_HEADER_SIZE - CML_NPY_PREFIX_SIZE];
+    const char* descr = cml_isHostBigEndian() ? ">f4" : "<f4";
+    int headerSize = oneDimensional ?
+        snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu,), }", descr, cols) :
+        snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu, %zu), }", descr, rows, cols);
+    // two 20 digit dimensions still leave room for the newline
+    assert(headerSize > 0 && (size_t)headerSize < sizeof(header));
+    memcpy(out + CML_NPY_PREFIX_SIZE, header, (size_t)headerSize);
+    out[CML_NPY_WRITE_HEADER_SIZE - 1] = '\n';
+}
+
+cml_NpyWriter cml_createNpyWriter(const char* filename, const size_t cols) {
+    assert(filename != NULL);
+
+    cml_NpyWriter writer = cml_emptyNpyWriter();
+    writer.file = fopen(filename, "wb");
+    if(writer.file == NULL) {
+        return writer;
+    }
+    writer.cols = cols;
+
+    // the row count is not known yet, the header is written again when closing
+    char header[CML_NPY_WRITE_HEADER_SIZE];
+    cml_writeNpyHeader(header, 0, cols, false);
+    writer.success = fwrite(header, 1, sizeof(header), writer.file) == sizeof(header);
+    return writer;
+}
+
+bool cml_writeNpyRows(cml_NpyWriter* writer, const float* rows, const size_t rowCount) {
+    assert(writer != NULL && writer->file != NULL);
+    assert(rows != NULL || rowCount == 0);
+
+    size_t count = rowCount * writer->cols;
+    writer->success = writer->success && fwrite(rows, sizeof(float), count, writer->file) == count;
+    writer->rows += rowCount;
+    return writer->success;
+}
+
+bool cml_closeNpyWriter(cml_NpyWriter* writer) {
+    assert(writer != NULL && writer->file != NULL);
+
+    char header[CML_NPY_WRITE_HEADER_SIZE];
+    cml_writeNpyHeader(header, writer->rows, writer->cols, false);
+    bool success = writer->success && fseek(writer->file, 0, SEEK_SET) == 0 &&
+        fwrite(header, 1, sizeof(header), writer->file) == sizeof(header);
+    success = fclose(writer->file) == 0 && success;
+    *writer = cml_emptyNpyWriter();
+    return success;
+}
+
+bool cml_saveNpyMatrix(const char* filename, const cml_Matrix matrix) {
+    assert(matrix.data != NULL || matrix.rows * matrix.cols == 0);
+
+    cml_NpyWriter writer = cml_createNpyWriter(filename, matrix.cols);
+    if(writer.file == NULL) {
+        return false;
+    }
+    cml_writeNpyRows(&writer, matrix.data, matrix.rows);
+    return cml_closeNpyWriter(&writer);
+}
+
+bool cml_loadNpyMatrix(const char* filename, cml_Matrix matrix) {
+    cml_NpyReader reader = cml_openNpy(filename);
+    if(reader.file == NULL) {
+        return false;
+    }
+    bool success = cml_readNpyMatrix(&reader, matrix);
+    cml_closeNpy(&reader);
+    return success;
+}
@@ -0,0 +1,284 @@
+#include <cml/util/Thread.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+struct cml_Mutex {
+    SRWLOCK lock;
+};
+
+typedef SRWLOCK cml_Lock;
+typedef CONDITION_VARIABLE cml_Condition;
+typedef HANDLE cml_ThreadHandle;
+
+static void cml_initLock(cml_Lock* lock) {
+    InitializeSRWLock(lock);
+}
+
+static void cml_destroyLock(cml_Lock* lock) {
+    // SRW locks hold no resources
+    (void)lock;
+}
+
+static void cml_acquireLock(cml_Lock* lock) {
+    AcquireSRWLockExclusive(lock);
+}
+
+static void cml_releaseLock(cml_Lock* lock) {
+    ReleaseSRWLockExclusive(lock);
+}
+
+static void cml_initCondition(cml_Condition* condition) {
+    InitializeConditionVariable(condition);
+}
+
+static void cml_destroyCondition(cml_Condition* condition) {
+    (void)condition;
+}
+
+static void cml_waitCondition(cml_Condition* condition, cml_Lock* lock) {
+    SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+}
+
+static void cml_broadcastCondition(cml_Condition* condition) {
+    WakeAllConditionVariable(condition);
+}
+
+size_t cml_getProcessorCount() {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwNumberOfProcessors;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+struct cml_Mutex {
+    pthread_mutex_t lock;
+};
+
+typedef pthread_mutex_t cml_Lock;
+typedef pthread_cond_t cml_Condition;
+typedef pthread_t cml_ThreadHandle;
+
+static void cml_initLock(cml_Lock* lock) {
+    pthread_mutex_init(lock, NULL);
+}
+
+static void cml_destroyLock(cml_Lock* lock) {
+    pthread_mutex_destroy(lock);
+}
+
+static void cml_acquireLock(cml_Lock* lock) {
+    pthread_mutex_lock(lock);
+}
+
+static void cml_releaseLock(cml_Lock* lock) {
+    pthread_mutex_unlock(lock);
+}
+
+static void cml_initCondition(cml_Condition* condition) {
+    pthread_cond_init(condition, NULL);
+}
+
+static void cml_destroyCondition(cml_Condition* condition) {
+    pthread_cond_destroy(condition);
+}
+
+static void cml_waitCondition(cml_Condition* condition, cml_Lock* lock) {
+    pthread_cond_wait(condition, lock);
+}
+
+static void cml_broadcastCondition(cml_Condition* condition) {
+    pthread_cond_broadcast(condition);
+}
+
+size_t cml_getProcessorCount() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+#endif
+
+cml_Mutex* cml_createMutex() {
+    cml_Mutex* mutex = (cml_Mutex*)malloc(sizeof(cml_Mutex));
+    cml_initLock(&mutex->lock);
+    return mutex;
+}
+
+void cml_deleteMutex(cml_Mutex* mutex) {
+    if(mutex != NULL) {
+        cml_destroyLock(&mutex->lock);
+    }
+    free(mutex);
+}
+
+void cml_lockMutex(cml_Mutex* mutex) {
+    assert(mutex != NULL);
+    cml_acquireLock(&mutex->lock);
+}
+
+void cml_unlockMutex(cml_Mutex* mutex) {
+    assert(mutex != NULL);
+    cml_releaseLock(&mutex->lock);
+}
+
+struct cml_ThreadPool {
+    cml_ThreadHandle* threads;
+    size_t threadCount; // workers, not counting the caller of cml_runTasks
+    cml_Lock lock;
+    cml_Condition workAvailable;
+    cml_Condition workDone;
+
+    // current batch, guarded by lock
+    cml_Task task; // NULL between batches
+    void* context;
+    size_t count;
+    size_t next;
+    size_t completed;
+    bool stopping;
+};
+
+// Takes the next task of the batch, lock has to be held and is held again on return
+// Returns false if every task has been handed out
+static bool cml_runNextTask(cml_ThreadPool* pool) {
+    if(pool->task == NULL || pool->next >= pool->count) {
+        return false;
+    }
+    cml_Task task = pool->task;
+    void* context = pool->context;
+    size_t index = pool->next++;
+
+    cml_releaseLock(&pool->lock);
+    task(context, index);
+    cml_acquireLock(&pool->lock);
+
+    pool->completed++;
+    if(pool->completed == pool->count) {
+        cml_broadcastCondition(&pool->workDone);
+    }
+    return true;
+}
+
+static void cml_runWorker(cml_ThreadPool* pool) {
+    cml_acquireLock(&pool->lock);
+    while(!pool->stopping) {
+        if(!cml_runNextTask(pool)) {
+            cml_waitCondition(&pool->workAvailable, &pool->lock);
+        }
+    }
+    cml_releaseLock(&pool->lock);
+}
+
+#ifdef _WIN32
+
+static DWORD WINAPI cml_workerMain(LPVOID pool) {
+    cml_runWorker((cml_ThreadPool*)pool);
+    return 0;
+}
+
+static bool cml_startThread(cml_ThreadHandle* thread, cml_ThreadPool* pool) {
+    *thread = CreateThread(NULL, 0, cml_workerMain, pool, 0, NULL);
+    return *thread != NULL;
+}
+
+static void cml_joinThread(cml_ThreadHandle thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+#else
+
+static void* cml_workerMain(void* pool) {
+    cml_runWorker((cml_ThreadPool*)pool);
+    return NULL;
+}
+
+static bool cml_startThread(cml_ThreadHandle* thread, cml_ThreadPool* pool) {
+    return pthread_create(thread, NULL, cml_workerMain, pool) == 0;
+}
+
+static void cml_joinThread(cml_ThreadHandle thread) {
+    pthread_join(thread, NULL);
+}
+
+#endif
+
+cml_ThreadPool* cml_createThreadPool(const size_t threadCount) {
+    size_t totalCount = threadCount > 0 ? threadCount : cml_getProcessorCount();
+
+    cml_ThreadPool* pool = (cml_ThreadPool*)malloc(sizeof(cml_ThreadPool));
+    pool->threads = (cml_ThreadHandle*)malloc(sizeof(cml_ThreadHandle) * totalCount);
+    pool->threadCount = 0;
+    cml_initLock(&pool->lock);
+    cml_initCondition(&pool->workAvailable);
+    cml_initCondition(&pool->workDone);
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->count = 0;
+    pool->next = 0;
+    pool->completed = 0;
+    pool->stopping = false;
+
+    // a thread that fails to start only makes the pool smaller, the caller always works
+    for(size_t i = 0; i < totalCount - 1; i++) {
+        if(cml_startThread(&pool->threads[pool->threadCount], pool)) {
+            pool->threadCount++;
+        }
+    }
+    return pool;
+}
+
+void cml_deleteThreadPool(cml_ThreadPool* pool) {
+    if(pool == NULL) {
+        return;
+    }
+
+    cml_acquireLock(&pool->lock);
+    pool->stopping = true;
+    cml_broadcastCondition(&pool->workAvailable);
+    cml_releaseLock(&pool->lock);
+    for(size_t i = 0; i < pool->threadCount; i++) {
+        cml_joinThread(pool->threads[i]);
+    }
+
+    cml_destroyCondition(&pool->workDone);
+    cml_destroyCondition(&pool->workAvailable);
+    cml_destroyLock(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+size_t cml_getThreadPoolSize(const cml_ThreadPool* pool) {
+    assert(pool != NULL);
+    return pool->threadCount + 1;
+}
+
+void cml_runTasks(cml_ThreadPool* pool, cml_Task task, void* context, const size_t count) {
+    assert(pool != NULL);
+    assert(task != NULL);
+
+    if(count == 0) {
+        return;
+    }
+
+    cml_acquireLock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->count = count;
+    pool->next = 0;
+    pool->completed = 0;
+    cml_broadcastCondition(&pool->workAvailable);
+
+    while(cml_runNextTask(pool)) {}
+    while(pool->completed < pool->count) {
+        cml_waitCondition(&pool->workDone, &pool->lock);
+    }
+    pool->task = NULL;
+    cml_releaseLock(&pool->lock);
+}
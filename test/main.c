@@ -1,5 +1,20 @@
+#include <cml/GPUBufferPool.h>
+#include <cml/GPUModel.h>
+#include <cml/GPUKernels.h>
+#include <cml/GPUProgramCache.h>
+#include <cml/GPUStream.h>
+#include <cml/HybridPredictor.h>
+#include <cml/MultiGPU.h>
+#include <cml/KernelSources.h>
 #include <cml/Logger.h>
 #include <cml/Model.h>
+#include <cml/ModelBundle.h>
+#include <cml/ModelFormat.h>
+#include <cml/ModelNpz.h>
+#include <cml/ModelPatch.h>
+#include <cml/ModelStream.h>
+#include <cml/util/Crc32c.h>
+#include <cml/util/Npy.h>
 #include <cml/util/String.h>
 #include <intdefs.h>
 #include <stdio.h>
@@ -25,15 +40,118 @@ bool test_createAndSerializeModel();
 bool test_modelPredictCPULinear();
 bool test_modelPredictCPURelu();
 bool test_modelPredictGPULinear();
+bool test_mapModel();
+bool test_modelFormatVersions();
+bool test_serializeModelWeights();
+bool test_writeModel();
+bool test_readModel();
+bool test_compressModel();
+bool test_modelChecksums();
+bool test_modelBundle();
+bool test_modelPatch();
+bool test_parallelLoad();
+bool test_npy();
+bool test_bindModelGPU();
+bool test_gpuProgramCache();
+bool test_kernelSources();
+bool test_gpuTuning();
+bool test_gpuStream();
+bool test_customActivationGPU();
+bool test_gpuBufferPool();
+bool test_hybridPredict();
+bool test_multiGPUPredict();
 bool cml_withinMarginOfError(const float actual, const float expected, const float acceptableDeviation);
 
+// A scaled model and rows of input for the batch predict tests, filled from seed
+typedef struct {
+    cml_Model model;
+    cml_ActivationFnMetadata* activations;
+    float* in;  // rowCount rows of the first layer size
+    float* out; // rowCount rows of the last layer size
+    size_t rowCount;
+} BatchFixture;
+
+// Hidden layers are relu, the last one lastActivation. Seeds coprime with 11 and 13 spread the values best
+BatchFixture createBatchFixture(const size_t numOflayers, const uint64* layerSizes, const size_t scale,
+    const enum cml_ActivationID lastActivation, const size_t seed, const size_t rowCount) {
+    BatchFixture fixture;
+    fixture.activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * (numOflayers-1));
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        enum cml_ActivationID id = i == numOflayers-2 ? lastActivation : CML_RELU;
+        fixture.activations[i] = cml_createActivationFnMetadataWithID(NULL, NULL, id);
+    }
+    fixture.model = cml_createScaledModel(numOflayers, layerSizes, scale, fixture.activations);
+    size_t cells = cml_getModelDataSize(fixture.model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        fixture.model.data[i] = (float)((i * seed) % 13) * 0.125f - 0.75f;
+    }
+    fixture.rowCount = rowCount;
+    fixture.in = (float*)malloc(sizeof(float) * rowCount * layerSizes[0]);
+    fixture.out = (float*)malloc(sizeof(float) * rowCount * layerSizes[numOflayers-1]);
+    for(size_t i = 0; i < rowCount * layerSizes[0]; i++) {
+        fixture.in[i] = (float)((i * seed) % 11) * 0.125f - 0.625f;
+    }
+    return fixture;
+}
+
+void deleteBatchFixture(BatchFixture* fixture) {
+    for(size_t i = 0; i < fixture->model.layerCount-1; i++) {
+        cml_deleteActivationFnMetadata(&fixture->activations[i]);
+    }
+    cml_deleteModel(&fixture->model);
+    free(fixture->activations);
+    free(fixture->in);
+    free(fixture->out);
+}
+
+// Every batch of scale rows of out matches cml_predictCPU, a partial last batch scored as if padded with zeros
+bool matchesCPUInBatches(const cml_Model model, const float* in, const float* out, const size_t rowCount) {
+    size_t inputSize = model.layerSizes[0];
+    size_t outputSize = model.layerSizes[model.layerCount-1];
+    float* batchIn = (float*)malloc(sizeof(float) * model.scale * inputSize);
+    float* expected = (float*)malloc(sizeof(float) * model.scale * outputSize);
+    bool success = true;
+    for(size_t firstRow = 0; firstRow < rowCount && success; firstRow += model.scale) {
+        size_t rows = rowCount - firstRow < model.scale ? rowCount - firstRow : model.scale;
+        memset(batchIn, 0, sizeof(float) * model.scale * inputSize);
+        memcpy(batchIn, in + firstRow * inputSize, sizeof(float) * rows * inputSize);
+        cml_predictCPU(model, batchIn, expected);
+        for(size_t i = 0; i < rows * outputSize && success; i++) {
+            success = cml_withinMarginOfError(out[firstRow * outputSize + i], expected[i], 0.001f);
+        }
+    }
+    free(batchIn);
+    free(expected);
+    return success;
+}
+
 int main() {
     cml_logStream = stdout;
     return 
         test_createAndSerializeModel() &&
         test_modelPredictCPULinear() &&
         test_modelPredictCPURelu() &&
-        test_modelPredictGPULinear();
+        test_modelPredictGPULinear() &&
+        test_mapModel() &&
+        test_modelFormatVersions() &&
+        test_serializeModelWeights() &&
+        test_writeModel() &&
+        test_readModel() &&
+        test_compressModel() &&
+        test_modelChecksums() &&
+        test_modelBundle() &&
+        test_modelPatch() &&
+        test_parallelLoad() &&
+        test_npy() &&
+        test_bindModelGPU() &&
+        test_gpuProgramCache() &&
+        test_kernelSources() &&
+        test_gpuTuning() &&
+        test_gpuStream() &&
+        test_customActivationGPU() &&
+        test_gpuBufferPool() &&
+        test_hybridPredict() &&
+        test_multiGPUPredict();
 }
 
 bool test_createAndSerializeModel() {
@@ -296,6 +414,1512 @@ bool test_modelPredictGPULinear() {
     return cml_withinMarginOfError(out[0], 27.6f, 0.125f) && cml_withinMarginOfError(out[1], 17.4f, 0.125f);
 }
 
+bool test_mapModel() {
+    printf("==[ Map model test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {3,2,2};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        activations[i] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+    }
+
+    // Model
+    cml_Model model = cml_createModel(numOflayers, layerSizes, activations);
+
+    // Set model weights and biases manually
+    float layer1Weights[] = {1,2,3,4,5,6};
+    float layer2Biases[] = {1,2};
+    float layer2Weights[] = {4,3,2,1};
+    float layer3Biases[] = {2,1};
+    memcpy(model.data + 3, layer1Weights, sizeof(layer1Weights));
+    memcpy(model.data + 9, layer2Biases, sizeof(layer2Biases));
+    memcpy(model.data + 15, layer2Weights, sizeof(layer2Weights));
+    memcpy(model.data + 19, layer3Biases, sizeof(layer3Biases));
+
+    cml_String serializedModel = cml_serializeModel(model);
+    FILE* file = fopen("mapped_model.dat", "wb");
+    fwrite(serializedModel.data, 1, serializedModel.size, file);
+    fclose(file);
+
+    // Map and compare
+    cml_Model mappedModel = cml_mapModel("mapped_model.dat");
+    if(mappedModel.data == NULL) {
+        printf("failed to map model\n");
+        return false;
+    }
+    cml_String serializedMappedModel = cml_serializeModel(mappedModel);
+    int cmp = memcmp(serializedModel.data, serializedMappedModel.data, serializedModel.size);
+
+    // Predict straight out of the mapping
+    float in[] = {0.5f, 0.2f, 0.3f};
+    float out[2];
+    cml_predictCPU(mappedModel, in, out);
+    printf("%0.4f %0.4f\n", out[0], out[1]);
+
+    // Missing files give back an empty model
+    cml_Model missingModel = cml_mapModel("missing_model.dat");
+
+    // clean up memory
+    cml_deleteModel(&model);
+    cml_deleteModel(&mappedModel);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedMappedModel);
+    remove("mapped_model.dat");
+
+    return cmp == 0 &&
+        missingModel.data == NULL &&
+        cml_withinMarginOfError(out[0], 27.6f, 0.125f) && cml_withinMarginOfError(out[1], 17.4f, 0.125f);
+}
+
+bool test_modelFormatVersions() {
+    printf("==[ Model format versions test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {3,4,2};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID("programName", "kernelName", CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Model
+    cml_Model model = cml_createModel(numOflayers, layerSizes, activations);
+    // L1 - W12 - B1 - A1 - Z1/L2 - W23 - B2 - A2 - Z2/L3
+    int cells = 3 + 12 + 4 + 4 + 4 + 8 + 2 + 2 + 2;
+    for(int i = 0; i < cells; i++) {
+        model.data[i] = (float)i;
+    }
+
+    // Version 1 layout written by hand
+    // [sizeof(size_t)][layerCount][scale][layerSizes][activation metadata][data]
+    char legacyModel[512];
+    size_t offset = 0;
+    legacyModel[offset++] = (char)sizeof(size_t);
+    memcpy(legacyModel + offset, &model.layerCount, sizeof(size_t));
+    offset += sizeof(size_t);
+    memcpy(legacyModel + offset, &model.scale, sizeof(size_t));
+    offset += sizeof(size_t);
+    memcpy(legacyModel + offset, layerSizes, sizeof(layerSizes));
+    offset += sizeof(layerSizes);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_String serializedActivation = cml_serializeActivationFnMetadata(activations[i]);
+        memcpy(legacyModel + offset, serializedActivation.data, serializedActivation.size);
+        offset += serializedActivation.size;
+        cml_deleteString(&serializedActivation);
+    }
+    memcpy(legacyModel + offset, model.data, cells * sizeof(float));
+    offset += cells * sizeof(float);
+
+    FILE* file = fopen("legacy_model.dat", "wb");
+    fwrite(legacyModel, 1, offset, file);
+    fclose(file);
+
+    // Both versions read back to the same model
+    cml_Model legacyDeserialized = cml_deserializeModel(legacyModel);
+    cml_String serializedModel = cml_serializeModel(model);
+    cml_String serializedLegacy = cml_serializeModel(legacyDeserialized);
+    bool sameModel = serializedModel.size == serializedLegacy.size &&
+        memcmp(serializedModel.data, serializedLegacy.data, serializedModel.size) == 0;
+
+    // Every truncation of the version 1 layout is rejected without reading past it, as are
+    // a bad sizeof(size_t) byte and a model of less than two layers
+    bool legacyBounded = true;
+    for(size_t size = 0; size < offset && legacyBounded; size++) {
+        char* truncated = (char*)malloc(size > 0 ? size : 1);
+        memcpy(truncated, legacyModel, size);
+        cml_Model truncatedModel = cml_deserializeModelFromBuffer(truncated, size);
+        legacyBounded = truncatedModel.data == NULL;
+        free(truncated);
+    }
+    char corruptModel[512];
+    memcpy(corruptModel, legacyModel, offset);
+    corruptModel[0] = 200;
+    cml_Model corruptDeserialized = cml_deserializeModelFromBuffer(corruptModel, offset);
+    legacyBounded = legacyBounded && corruptDeserialized.data == NULL;
+    corruptModel[0] = (char)sizeof(size_t);
+    memset(corruptModel + 1, 0, sizeof(size_t));
+    corruptDeserialized = cml_deserializeModelFromBuffer(corruptModel, offset);
+    legacyBounded = legacyBounded && corruptDeserialized.data == NULL;
+    printf("version 1 reads bounded: %d\n", legacyBounded);
+
+    // Version 2 header and alignment
+    cml_ModelHeader header;
+    bool headerRead = cml_readModelHeader(serializedModel.data, serializedModel.size, &header);
+    const cml_ModelSection* dataSection = headerRead ? cml_findModelSection(header, CML_SECTION_DATA, 0) : NULL;
+    bool aligned = dataSection != NULL && dataSection->offset % CML_MODEL_SECTION_ALIGNMENT == 0;
+    printf("format version: %u, data section offset: %u\n",
+        cml_getModelFormatVersion(serializedModel.data, serializedModel.size),
+        dataSection != NULL ? (unsigned)dataSection->offset : 0);
+    if(headerRead) {
+        cml_deleteModelHeader(&header);
+    }
+
+    // The version 1 header alone, read up to the data block
+    file = fopen("legacy_model.dat", "rb");
+    cml_ModelHeader legacyHeader;
+    bool legacyHeaderFound = cml_readModelHeaderFromFile(file, &legacyHeader);
+    bool legacyHeaderRead = legacyHeaderFound && legacyHeader.version == 1 &&
+        legacyHeader.layerCount == numOflayers && legacyHeader.layerSizes[1] == 4 && legacyHeader.sectionCount == 0 &&
+        legacyHeader.activationFunctions[0].gpuKernelName.size == strlen("kernelName") &&
+        (size_t)ftell(file) == legacyHeader.headerSize && legacyHeader.headerSize == offset - cells * sizeof(float);
+    fclose(file);
+    if(legacyHeaderFound) {
+        cml_deleteModelHeader(&legacyHeader);
+    }
+    printf("version 1 header read: %d\n", legacyHeaderRead);
+
+    // Upgrade in place
+    bool upgraded = cml_upgradeModelFile("legacy_model.dat", "legacy_model.dat");
+    FILE* temporaryFile = fopen("legacy_model.dat.tmp", "rb");
+    upgraded = upgraded && temporaryFile == NULL;
+    if(temporaryFile != NULL) {
+        fclose(temporaryFile);
+    }
+    cml_Model upgradedModel = cml_mapModel("legacy_model.dat");
+    cml_String serializedUpgraded = upgradedModel.data != NULL ? cml_serializeModel(upgradedModel) : cml_createNewString(0);
+    bool sameUpgraded = serializedUpgraded.size == serializedModel.size &&
+        memcmp(serializedModel.data, serializedUpgraded.data, serializedModel.size) == 0;
+
+    // clean up memory
+    cml_deleteModel(&model);
+    cml_deleteModel(&legacyDeserialized);
+    if(upgradedModel.data != NULL) {
+        cml_deleteModel(&upgradedModel);
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedLegacy);
+    cml_deleteString(&serializedUpgraded);
+    remove("legacy_model.dat");
+
+    return sameModel && legacyBounded && legacyHeaderRead && aligned && upgraded && sameUpgraded;
+}
+
+bool test_serializeModelWeights() {
+    printf("==[ Serialize model weights test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {3,2,2};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        activations[i] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+    }
+
+    // Model with a large batch capacity
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, 64, activations);
+    cml_ModelMatrices modelMatrices = cml_getModelMatrices(model);
+    float layer1Weights[] = {1,2,3,4,5,6};
+    float layer2Biases[] = {1,2};
+    float layer2Weights[] = {4,3,2,1};
+    float layer3Biases[] = {2,1};
+    memcpy(modelMatrices.weights[0].data, layer1Weights, sizeof(layer1Weights));
+    memcpy(modelMatrices.biases[0].data, layer2Biases, sizeof(layer2Biases));
+    memcpy(modelMatrices.weights[1].data, layer2Weights, sizeof(layer2Weights));
+    memcpy(modelMatrices.biases[1].data, layer3Biases, sizeof(layer3Biases));
+    cml_deleteModelMatrices(modelMatrices);
+
+    cml_String serializedModel = cml_serializeModel(model);
+    cml_String serializedWeights = cml_serializeModelWeights(model);
+    printf("full size: %u, weights only size: %u\n", (unsigned)serializedModel.size, (unsigned)serializedWeights.size);
+
+    // Loader picks the batch capacity
+    cml_Model defaultScaleModel = cml_deserializeModel(serializedWeights.data);
+    cml_Model weightsModel = cml_deserializeScaledModel(serializedWeights.data, 2);
+    cml_Model fullModel = cml_deserializeScaledModel(serializedModel.data, 2);
+
+    float in[] = {0.5f, 0.2f, 0.3f, 0.5f, 0.2f, 0.3f};
+    float weightsOut[4];
+    float fullOut[4];
+    cml_predictCPU(weightsModel, in, weightsOut);
+    cml_predictCPU(fullModel, in, fullOut);
+
+    bool success = serializedWeights.size < serializedModel.size &&
+        defaultScaleModel.scale == 64 &&
+        weightsModel.scale == 2 && fullModel.scale == 2;
+    for(int i = 0; i < 4; i++) {
+        float expected = (i % 2 == 0) ? 27.6f : 17.4f;
+        success = success && 
+            cml_withinMarginOfError(weightsOut[i], expected, 0.125f) && 
+            cml_withinMarginOfError(fullOut[i], expected, 0.125f);
+    }
+
+    // clean up memory
+    cml_deleteModel(&model);
+    cml_deleteModel(&defaultScaleModel);
+    cml_deleteModel(&weightsModel);
+    cml_deleteModel(&fullModel);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedWeights);
+
+    return success;
+}
+
+// Returns true if the file holds exactly the given bytes
+bool fileMatches(const char* filename, const cml_String expected) {
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        return false;
+    }
+    char* contents = (char*)malloc(expected.size + 1);
+    size_t size = fread(contents, 1, expected.size + 1, file);
+    fclose(file);
+    bool matches = size == expected.size && memcmp(contents, expected.data, expected.size) == 0;
+    free(contents);
+    return matches;
+}
+
+bool test_writeModel() {
+    printf("==[ Write model test ]==\n");
+    // Model Specs
+    size_t numOflayers = 4;
+    uint64 layerSizes[] = {5,7,3,2};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 3);
+    activations[0] = cml_createActivationFnMetadataWithID("matrix_relu.cl", "matrixRelu", CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[2] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Model
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, 3, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)i * 0.5f;
+    }
+
+    // Stream both flavours to disk
+    FILE* file = fopen("streamed_model.dat", "wb");
+    bool written = cml_writeModel(model, fileno(file));
+    fclose(file);
+    file = fopen("streamed_weights.dat", "wb");
+    written = cml_writeModelWeights(model, fileno(file)) && written;
+    fclose(file);
+
+    // Must match the in memory serialization byte for byte
+    cml_String serializedModel = cml_serializeModel(model);
+    cml_String serializedWeights = cml_serializeModelWeights(model);
+    bool matches = fileMatches("streamed_model.dat", serializedModel) && fileMatches("streamed_weights.dat", serializedWeights);
+
+    // clean up memory
+    cml_deleteModel(&model);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedWeights);
+    remove("streamed_model.dat");
+    remove("streamed_weights.dat");
+
+    return written && matches;
+}
+
+// cml_ModelReader over a buffer handing out a few bytes at a time, like a pipe would
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t position;
+} TrickleReader;
+
+size_t trickleRead(void* context, char* buffer, size_t size) {
+    TrickleReader* reader = (TrickleReader*)context;
+    size_t remaining = reader->size - reader->position;
+    size_t chunk = size < 7 ? size : 7;
+    chunk = chunk < remaining ? chunk : remaining;
+    memcpy(buffer, reader->data + reader->position, chunk);
+    reader->position += chunk;
+    return chunk;
+}
+
+bool test_readModel() {
+    printf("==[ Read model test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {4,6,3};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Model
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, 2, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)i - 10.0f;
+    }
+    cml_String serializedModel = cml_serializeModel(model);
+    cml_String serializedWeights = cml_serializeModelWeights(model);
+
+    // From a FILE*
+    FILE* file = fopen("read_model.dat", "wb");
+    fwrite(serializedModel.data, 1, serializedModel.size, file);
+    fclose(file);
+    file = fopen("read_model.dat", "rb");
+    cml_Model fileModel = cml_readModel(file);
+    fclose(file);
+    cml_String serializedFileModel = fileModel.data != NULL ? cml_serializeModel(fileModel) : cml_createNewString(0);
+
+    // From a reader that only ever returns a few bytes
+    TrickleReader trickle = {serializedWeights.data, serializedWeights.size, 0};
+    cml_ModelReader reader = {trickleRead, &trickle};
+    cml_Model trickleModel = cml_readModelFromReader(reader);
+    cml_String serializedTrickleModel = trickleModel.data != NULL ? cml_serializeModelWeights(trickleModel) : cml_createNewString(0);
+
+    // Truncated input
+    TrickleReader truncated = {serializedWeights.data, serializedWeights.size - 4, 0};
+    cml_ModelReader truncatedReader = {trickleRead, &truncated};
+    cml_Model truncatedModel = cml_readModelFromReader(truncatedReader);
+
+    // Header only, nothing past it is read
+    TrickleReader headerTrickle = {serializedWeights.data, serializedWeights.size, 0};
+    cml_ModelReader headerReader = {trickleRead, &headerTrickle};
+    cml_ModelHeader header;
+    bool headerRead = cml_readModelHeaderFromReader(headerReader, &header);
+    bool headerOnly = headerRead && headerTrickle.position == header.headerSize &&
+        header.layerCount == numOflayers && header.scale == 2 &&
+        header.layerSizes[1] == 6 && header.activationFunctions[0].activationID == CML_RELU &&
+        header.sectionCount == 2 * (numOflayers-1);
+    if(headerRead) {
+        cml_deleteModelHeader(&header);
+    }
+
+    bool success = headerOnly &&
+        serializedFileModel.size == serializedModel.size &&
+        memcmp(serializedFileModel.data, serializedModel.data, serializedModel.size) == 0 &&
+        serializedTrickleModel.size == serializedWeights.size &&
+        memcmp(serializedTrickleModel.data, serializedWeights.data, serializedWeights.size) == 0 &&
+        truncatedModel.data == NULL;
+
+    // clean up memory
+    cml_deleteModel(&model);
+    if(fileModel.data != NULL) {
+        cml_deleteModel(&fileModel);
+    }
+    if(trickleModel.data != NULL) {
+        cml_deleteModel(&trickleModel);
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedWeights);
+    cml_deleteString(&serializedFileModel);
+    cml_deleteString(&serializedTrickleModel);
+    remove("read_model.dat");
+
+    return success;
+}
+
+bool test_compressModel() {
+    printf("==[ Compress model test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {16,32,8};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Model, small repeating weights like a quantized network
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, 4, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)(i % 7) * 0.25f - 0.5f;
+    }
+    cml_String serializedModel = cml_serializeModel(model);
+    cml_String serializedWeights = cml_serializeModelWeights(model);
+
+    cml_ModelSerializeOptions options = cml_createModelSerializeOptions();
+    options.dataEncoding = CML_ENCODING_SHUFFLE_LZ;
+    cml_String compressedModel = cml_serializeModelWithOptions(model, options);
+    options.weightsOnly = true;
+    options.weightsEncoding = CML_ENCODING_SHUFFLE_LZ;
+    options.biasesEncoding = CML_ENCODING_SHUFFLE_LZ;
+    cml_String compressedWeights = cml_serializeModelWithOptions(model, options);
+
+    // In memory
+    cml_Model loadedModel = cml_deserializeModel(compressedModel.data);
+    cml_Model loadedWeights = cml_deserializeModel(compressedWeights.data);
+    cml_String reserializedModel = loadedModel.data != NULL ? cml_serializeModel(loadedModel) : cml_createNewString(0);
+    cml_String reserializedWeights = loadedWeights.data != NULL ? cml_serializeModelWeights(loadedWeights) : cml_createNewString(0);
+
+    // Mapped and streamed
+    FILE* file = fopen("compressed_model.dat", "wb");
+    fwrite(compressedModel.data, 1, compressedModel.size, file);
+    fclose(file);
+    cml_Model mappedModel = cml_mapModel("compressed_model.dat");
+    cml_String remappedModel = mappedModel.data != NULL ? cml_serializeModel(mappedModel) : cml_createNewString(0);
+    TrickleReader trickle = {compressedWeights.data, compressedWeights.size, 0};
+    cml_ModelReader reader = {trickleRead, &trickle};
+    cml_Model streamedModel = cml_readModelFromReader(reader);
+    cml_String restreamedModel = streamedModel.data != NULL ? cml_serializeModelWeights(streamedModel) : cml_createNewString(0);
+
+    // Corrupt the first compressed section, loading should fail instead of reading out of bounds
+    cml_ModelHeader header;
+    cml_readModelHeader(compressedWeights.data, compressedWeights.size, &header);
+    memset(compressedWeights.data + header.sections[0].offset, 0xFF, header.sections[0].size);
+    cml_deleteModelHeader(&header);
+    cml_Model corruptModel = cml_deserializeModel(compressedWeights.data);
+
+    printf("raw size: %zu, compressed size: %zu\n", serializedModel.size, compressedModel.size);
+    bool success = compressedModel.size < serializedModel.size &&
+        compressedWeights.size < serializedWeights.size &&
+        reserializedModel.size == serializedModel.size &&
+        memcmp(reserializedModel.data, serializedModel.data, serializedModel.size) == 0 &&
+        reserializedWeights.size == serializedWeights.size &&
+        memcmp(reserializedWeights.data, serializedWeights.data, serializedWeights.size) == 0 &&
+        remappedModel.size == serializedModel.size &&
+        memcmp(remappedModel.data, serializedModel.data, serializedModel.size) == 0 &&
+        restreamedModel.size == serializedWeights.size &&
+        memcmp(restreamedModel.data, serializedWeights.data, serializedWeights.size) == 0 &&
+        corruptModel.data == NULL;
+
+    // clean up memory
+    cml_deleteModel(&model);
+    cml_Model* loaded[] = {&loadedModel, &loadedWeights, &mappedModel, &streamedModel};
+    for(size_t i = 0; i < 4; i++) {
+        if(loaded[i]->data != NULL) {
+            cml_deleteModel(loaded[i]);
+        }
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedWeights);
+    cml_deleteString(&compressedModel);
+    cml_deleteString(&compressedWeights);
+    cml_deleteString(&reserializedModel);
+    cml_deleteString(&reserializedWeights);
+    cml_deleteString(&remappedModel);
+    cml_deleteString(&restreamedModel);
+    remove("compressed_model.dat");
+
+    return success;
+}
+
+bool test_modelChecksums() {
+    printf("==[ Model checksums test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {3,4,2};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Model
+    cml_Model model = cml_createModel(numOflayers, layerSizes, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)i * 0.5f;
+    }
+    cml_String serializedModel = cml_serializeModel(model);
+    FILE* file = fopen("intact_model.dat", "wb");
+    fwrite(serializedModel.data, 1, serializedModel.size, file);
+    fclose(file);
+
+    // Flip one bit in the middle of the data section
+    cml_ModelHeader header;
+    cml_readModelHeader(serializedModel.data, serializedModel.size, &header);
+    serializedModel.data[header.sections[0].offset + header.sections[0].size / 2] ^= 0x10;
+    cml_deleteModelHeader(&header);
+    file = fopen("corrupt_model.dat", "wb");
+    fwrite(serializedModel.data, 1, serializedModel.size, file);
+    fclose(file);
+
+    cml_Model deserializedModel = cml_deserializeModel(serializedModel.data);
+    cml_Model mappedModel = cml_mapModel("corrupt_model.dat");
+    TrickleReader trickle = {serializedModel.data, serializedModel.size, 0};
+    cml_ModelReader reader = {trickleRead, &trickle};
+    cml_Model streamedModel = cml_readModelFromReader(reader);
+    cml_Model uncheckedModel = cml_mapModelWithVerification("corrupt_model.dat", CML_VERIFY_NONE);
+    cml_Model lazyIntactModel = cml_mapModelWithVerification("intact_model.dat", CML_VERIFY_LAZY);
+    cml_Model lazyCorruptModel = cml_mapModelWithVerification("corrupt_model.dat", CML_VERIFY_LAZY);
+
+    // Corruption only shows once the lazy model is used
+    bool lazyLoaded = lazyIntactModel.data != NULL && lazyCorruptModel.data != NULL;
+    float in[3] = {1.0f, 2.0f, 3.0f};
+    float out[2] = {0.0f, 0.0f};
+    if(lazyLoaded) {
+        cml_predictCPU(lazyCorruptModel, in, out);
+    }
+
+    bool success = cml_crc32c(0, "123456789", 9) == 0xE3069283 &&
+        deserializedModel.data == NULL &&
+        mappedModel.data == NULL &&
+        streamedModel.data == NULL &&
+        uncheckedModel.data != NULL && cml_verifyModel(uncheckedModel) &&
+        lazyLoaded && cml_verifyModel(lazyIntactModel) && !cml_verifyModel(lazyCorruptModel) &&
+        isnan(out[0]) && isnan(out[1]);
+
+    // clean up memory
+    cml_deleteModel(&model);
+    cml_Model* loaded[] = {&uncheckedModel, &lazyIntactModel, &lazyCorruptModel};
+    for(size_t i = 0; i < 3; i++) {
+        if(loaded[i]->data != NULL) {
+            cml_deleteModel(loaded[i]);
+        }
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    remove("intact_model.dat");
+    remove("corrupt_model.dat");
+
+    return success;
+}
+
+bool test_modelBundle() {
+    printf("==[ Model bundle test ]==\n");
+    // Models of different shapes
+    size_t numOflayers = 3;
+    uint64 layerSizes[3][3] = {{3,4,2}, {5,2,7}, {2,2,2}};
+    const char* names[] = {"ranker", "classifier", "scorer"};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+    cml_Model models[3];
+    cml_String serializedModels[3];
+    for(size_t i = 0; i < 3; i++) {
+        models[i] = cml_createModel(numOflayers, layerSizes[i], activations);
+        size_t cells = cml_getModelDataSize(models[i]) / sizeof(float);
+        for(size_t j = 0; j < cells; j++) {
+            models[i].data[j] = (float)(i * 100 + j);
+        }
+        serializedModels[i] = cml_serializeModel(models[i]);
+    }
+
+    const char* repeatedNames[] = {"ranker", "ranker"};
+    bool rejectsRepeated = !cml_writeModelBundle("repeated.bundle", repeatedNames, models, 2);
+    bool written = cml_writeModelBundle("models.bundle", names, models, 3);
+    cml_ModelBundle bundle = cml_openModelBundle("models.bundle");
+    cml_ModelBundle notBundle = cml_openModelBundle("test/main.c");
+
+    bool success = rejectsRepeated && written && bundle.filename != NULL && notBundle.filename == NULL &&
+        bundle.entryCount == 3 && strcmp(bundle.entries[0].name, "classifier") == 0;
+    cml_Model loadedModel, mappedModel, missingModel;
+    loadedModel.data = mappedModel.data = missingModel.data = NULL;
+    cml_Model allModels[3];
+    bool mappedAll = false;
+    if(success) {
+        loadedModel = cml_loadBundleModel(bundle, "scorer");
+        mappedModel = cml_mapBundleModel(bundle, "ranker", CML_VERIFY_EAGER);
+        missingModel = cml_loadBundleModel(bundle, "missing");
+        mappedAll = cml_mapBundleModels(bundle, CML_VERIFY_LAZY, NULL, allModels);
+    }
+
+    // Compare by serializing again
+    cml_String serializedLoaded = loadedModel.data != NULL ? cml_serializeModel(loadedModel) : cml_createNewString(0);
+    cml_String serializedMapped = mappedModel.data != NULL ? cml_serializeModel(mappedModel) : cml_createNewString(0);
+    success = success && missingModel.data == NULL && mappedAll &&
+        mappedModel.mapping.size != 0 &&
+        serializedLoaded.size == serializedModels[2].size &&
+        memcmp(serializedLoaded.data, serializedModels[2].data, serializedLoaded.size) == 0 &&
+        serializedMapped.size == serializedModels[0].size &&
+        memcmp(serializedMapped.data, serializedModels[0].data, serializedMapped.size) == 0 &&
+        allModels[0].layerSizes[0] == 5 && cml_verifyModel(allModels[0]) &&
+        allModels[1].layerSizes[0] == 3 && allModels[2].layerSizes[0] == 2;
+
+    // clean up memory
+    if(mappedAll) {
+        for(size_t i = 0; i < 3; i++) {
+            cml_deleteModel(&allModels[i]);
+        }
+    }
+    if(loadedModel.data != NULL) {
+        cml_deleteModel(&loadedModel);
+    }
+    if(mappedModel.data != NULL) {
+        cml_deleteModel(&mappedModel);
+    }
+    for(size_t i = 0; i < 3; i++) {
+        cml_deleteModel(&models[i]);
+        cml_deleteString(&serializedModels[i]);
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedLoaded);
+    cml_deleteString(&serializedMapped);
+    if(bundle.filename != NULL) {
+        cml_closeModelBundle(&bundle);
+    }
+    remove("models.bundle");
+    remove("repeated.bundle");
+
+    return success;
+}
+
+bool test_modelPatch() {
+    printf("==[ Model patch test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {16,32,4};
+    uint64 otherLayerSizes[] = {16,32,5};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Target differs from base in a block of weights and a few scattered ones
+    cml_Model base = cml_createModel(numOflayers, layerSizes, activations);
+    size_t cells = cml_getModelDataSize(base) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        base.data[i] = (float)i;
+    }
+    cml_Model target = cml_copyModelWithScale(base, 1);
+    cml_ModelMatrices targetMatrices = cml_getModelMatrices(target);
+    for(size_t i = 100; i < 140; i++) {
+        targetMatrices.weights[0].data[i] += 1.0f;
+    }
+    targetMatrices.weights[0].data[400] = -1.0f;
+    targetMatrices.weights[1].data[7] = -2.0f;
+    targetMatrices.weights[1].data[90] = -3.0f;
+    targetMatrices.biases[1].data[3] = 0.5f;
+    cml_deleteModelMatrices(targetMatrices);
+
+    cml_ModelPatch patch = cml_diffModels(base, target);
+    cml_String serializedPatch = cml_serializeModelPatch(patch);
+    cml_ModelPatch loadedPatch = cml_deserializeModelPatch(serializedPatch.data, serializedPatch.size);
+    cml_ModelPatch truncatedPatch = cml_deserializeModelPatch(serializedPatch.data, serializedPatch.size - 1);
+
+    size_t denseCount = 0;
+    size_t sparseCount = 0;
+    for(size_t i = 0; i < patch.entryCount; i++) {
+        denseCount += patch.entries[i].encoding == CML_PATCH_DENSE;
+        sparseCount += patch.entries[i].encoding == CML_PATCH_SPARSE;
+    }
+
+    // Apply to a copy of base and compare the weights
+    cml_Model patched = cml_copyModelWithScale(base, 1);
+    cml_Model other = cml_createModel(numOflayers, otherLayerSizes, activations);
+    bool applied = loadedPatch.layerSizes != NULL && cml_applyModelPatch(patched, loadedPatch);
+    bool rejected = !cml_applyModelPatch(other, patch);
+    cml_String patchedWeights = cml_serializeModelWeights(patched);
+    cml_String targetWeights = cml_serializeModelWeights(target);
+
+    printf("patch entries: %zu dense, %zu sparse, %zu bytes\n", denseCount, sparseCount, serializedPatch.size);
+    bool success = denseCount == 1 && sparseCount == 3 &&
+        serializedPatch.size < cml_getModelDataSize(base) / 4 &&
+        truncatedPatch.layerSizes == NULL &&
+        applied && rejected &&
+        patchedWeights.size == targetWeights.size &&
+        memcmp(patchedWeights.data, targetWeights.data, targetWeights.size) == 0;
+
+    // clean up memory
+    cml_deleteModel(&base);
+    cml_deleteModel(&target);
+    cml_deleteModel(&patched);
+    cml_deleteModel(&other);
+    cml_deleteModelPatch(&patch);
+    if(loadedPatch.layerSizes != NULL) {
+        cml_deleteModelPatch(&loadedPatch);
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedPatch);
+    cml_deleteString(&patchedWeights);
+    cml_deleteString(&targetWeights);
+
+    return success;
+}
+
+bool test_parallelLoad() {
+    printf("==[ Parallel load test ]==\n");
+    // Model Specs, large enough to split into several pieces
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {256,512,64};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, 2, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)(i % 1000) * 0.01f;
+    }
+    cml_String serializedModel = cml_serializeModel(model);
+    cml_String serializedWeights = cml_serializeModelWeights(model);
+    cml_ModelSerializeOptions options = cml_createModelSerializeOptions();
+    options.weightsOnly = true;
+    options.weightsEncoding = CML_ENCODING_SHUFFLE_LZ;
+    cml_String compressedWeights = cml_serializeModelWithOptions(model, options);
+    FILE* file = fopen("parallel_model.dat", "wb");
+    fwrite(serializedModel.data, 1, serializedModel.size, file);
+    fclose(file);
+
+    cml_ThreadPool* pool = cml_createThreadPool(4);
+    cml_Model fullModel = cml_deserializeModelParallel(serializedModel.data, serializedModel.size, pool);
+    cml_Model weightsModel = cml_deserializeModelParallel(serializedWeights.data, serializedWeights.size, pool);
+    cml_Model compressedModel = cml_deserializeModelParallel(compressedWeights.data, compressedWeights.size, pool);
+    cml_Model fileModel = cml_loadModelParallel("parallel_model.dat", pool);
+
+    // Corrupt the last piece of the data section
+    cml_ModelHeader header;
+    cml_readModelHeader(serializedModel.data, serializedModel.size, &header);
+    size_t corruptOffset = header.sections[0].offset + header.sections[0].size - 1;
+    cml_deleteModelHeader(&header);
+    serializedModel.data[corruptOffset] ^= 1;
+    cml_Model corruptModel = cml_deserializeModelParallel(serializedModel.data, serializedModel.size, pool);
+    serializedModel.data[corruptOffset] ^= 1;
+
+    cml_String serializedFull = fullModel.data != NULL ? cml_serializeModel(fullModel) : cml_createNewString(0);
+    cml_String serializedFile = fileModel.data != NULL ? cml_serializeModel(fileModel) : cml_createNewString(0);
+    cml_String weightsFromWeights = weightsModel.data != NULL ? cml_serializeModelWeights(weightsModel) : cml_createNewString(0);
+    cml_String weightsFromCompressed = compressedModel.data != NULL ? cml_serializeModelWeights(compressedModel) : cml_createNewString(0);
+
+    printf("pool size: %zu, model size: %zu\n", cml_getThreadPoolSize(pool), cml_getModelDataSize(model));
+    bool success = cml_getThreadPoolSize(pool) == 4 &&
+        corruptModel.data == NULL &&
+        serializedFull.size == serializedModel.size &&
+        memcmp(serializedFull.data, serializedModel.data, serializedModel.size) == 0 &&
+        serializedFile.size == serializedModel.size &&
+        memcmp(serializedFile.data, serializedModel.data, serializedModel.size) == 0 &&
+        weightsFromWeights.size == serializedWeights.size &&
+        memcmp(weightsFromWeights.data, serializedWeights.data, serializedWeights.size) == 0 &&
+        weightsFromCompressed.size == serializedWeights.size &&
+        memcmp(weightsFromCompressed.data, serializedWeights.data, serializedWeights.size) == 0;
+
+    // clean up memory
+    cml_deleteThreadPool(pool);
+    cml_deleteModel(&model);
+    cml_Model* loaded[] = {&fullModel, &weightsModel, &compressedModel, &fileModel};
+    for(size_t i = 0; i < 4; i++) {
+        if(loaded[i]->data != NULL) {
+            cml_deleteModel(loaded[i]);
+        }
+    }
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&serializedModel);
+    cml_deleteString(&serializedWeights);
+    cml_deleteString(&compressedWeights);
+    cml_deleteString(&serializedFull);
+    cml_deleteString(&serializedFile);
+    cml_deleteString(&weightsFromWeights);
+    cml_deleteString(&weightsFromCompressed);
+    remove("parallel_model.dat");
+
+    return success;
+}
+
 bool cml_withinMarginOfError(const float actual, const float expected, const float acceptableDeviation) {
     return fabs(actual - expected) < acceptableDeviation;
-}
\ No newline at end of file
+}
+bool test_npy() {
+    printf("==[ NumPy import and export test ]==\n");
+    // Model Specs
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {4,8,3};
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    // Weights round trip through an .npz into a zeroed model
+    cml_Model model = cml_createModel(numOflayers, layerSizes, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)(i % 7) * 0.25f - 0.5f;
+    }
+    cml_Model loaded = cml_createModel(numOflayers, layerSizes, activations);
+    bool saved = cml_saveModelNpz(model, "npy_model.npz");
+    bool npzLoaded = cml_loadModelNpz(loaded, "npy_model.npz");
+    cml_String modelWeights = cml_serializeModelWeights(model);
+    cml_String loadedWeights = cml_serializeModelWeights(loaded);
+
+    // Fortran order float64, as saved from a transposed NumPy array
+    const char header[] = "{'descr': '<f8', 'fortran_order': True, 'shape': (2, 3), }";
+    double columns[] = {1, 4, 2, 5, 3, 6};
+    char prefix[10] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, (char)(sizeof(header) - 1), 0};
+    FILE* file = fopen("npy_fortran.npy", "wb");
+    fwrite(prefix, 1, sizeof(prefix), file);
+    fwrite(header, 1, sizeof(header) - 1, file);
+    fwrite(columns, sizeof(double), 6, file);
+    fclose(file);
+    float values[6] = {0};
+    cml_Matrix matrix = {values, 2, 3};
+    cml_Matrix wrongShape = {values, 3, 2};
+    bool transposed = cml_loadNpyMatrix("npy_fortran.npy", matrix) && !cml_loadNpyMatrix("npy_fortran.npy", wrongShape);
+    for(size_t i = 0; i < 6; i++) {
+        transposed = transposed && values[i] == (float)(i + 1);
+    }
+
+    // Bulk prediction in batches of 2 matches predicting one row at a time
+    float inputs[5 * 4];
+    for(size_t i = 0; i < 5 * 4; i++) {
+        inputs[i] = (float)i * 0.1f;
+    }
+    cml_Matrix inputMatrix = {inputs, 5, 4};
+    cml_Model batchModel = cml_copyModelWithScale(model, 2);
+    bool predicted = cml_saveNpyMatrix("npy_inputs.npy", inputMatrix) &&
+        cml_predictCPUNpy(batchModel, "npy_inputs.npy", "npy_outputs.npy");
+    float outputs[5 * 3] = {0};
+    cml_NpyReader reader = cml_openNpy("npy_outputs.npy");
+    predicted = predicted && reader.file != NULL && reader.rows == 5 && reader.cols == 3 &&
+        cml_readNpyRows(&reader, outputs, 2) == 2 && cml_readNpyRows(&reader, outputs + 2 * 3, 8) == 3;
+    if(reader.file != NULL) {
+        cml_closeNpy(&reader);
+    }
+    for(size_t i = 0; i < 5; i++) {
+        float expected[3];
+        cml_predictCPU(model, inputs + i * 4, expected);
+        predicted = predicted && memcmp(expected, outputs + i * 3, sizeof(expected)) == 0;
+    }
+
+    printf("npz: saved %d loaded %d, fortran order: %d, bulk predict: %d\n", saved, npzLoaded, transposed, predicted);
+    bool success = saved && npzLoaded && transposed && predicted &&
+        modelWeights.size == loadedWeights.size &&
+        memcmp(modelWeights.data, loadedWeights.data, modelWeights.size) == 0 &&
+        !cml_loadModelNpz(loaded, "npy_inputs.npy");
+
+    // clean up memory
+    cml_deleteModel(&model);
+    cml_deleteModel(&loaded);
+    cml_deleteModel(&batchModel);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteString(&modelWeights);
+    cml_deleteString(&loadedWeights);
+    remove("npy_model.npz");
+    remove("npy_fortran.npy");
+    remove("npy_inputs.npy");
+    remove("npy_outputs.npy");
+
+    return success;
+}
+
+bool test_bindModelGPU() {
+    printf("==[ Bound GPU model test ]==\n");
+    // Model Specs, the wide first layer uses the tiled multiply with partial tiles on every side,
+    // the narrow ones the dense kernel
+    size_t numOflayers = 4;
+    uint64 layerSizes[] = {20,96,6,4};
+    size_t scale = 10;
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 3);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[2] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    cml_GPU gpu = cml_simpleSetupGPU();
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, scale, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)((i * 7) % 13) * 0.125f - 0.75f;
+    }
+
+    // the three programs of the simple setup are enough when nothing else may be built
+    size_t programCount = gpu.programMap.size;
+    cml_GPUBindOptions loadedOnly = cml_createGPUBindOptions();
+    loadedOnly.loadedKernelsOnly = true;
+    cml_GPUModel loadedModel = cml_bindModelGPUWithOptions(model, &gpu, loadedOnly);
+    bool success = loadedModel.weights != NULL && gpu.programMap.size == programCount;
+    for(size_t i = 0; i < numOflayers-1 && success; i++) {
+        success = loadedModel.layerKernels[i] == CML_GPU_LAYER_SEPARATE;
+    }
+    float* in = (float*)malloc(sizeof(float) * scale * layerSizes[0]);
+    float* expected = (float*)malloc(sizeof(float) * scale * layerSizes[3]);
+    float* out = (float*)malloc(sizeof(float) * scale * layerSizes[3]);
+    for(size_t i = 0; i < scale * layerSizes[0]; i++) {
+        in[i] = (float)(i % 5) * 0.25f - 0.5f;
+    }
+    cml_predictCPU(model, in, expected);
+    success = success && cml_predictBoundModelGPU(loadedModel, in, out);
+    for(size_t i = 0; i < scale * layerSizes[3] && success; i++) {
+        success = cml_withinMarginOfError(out[i], expected[i], 0.001f);
+    }
+    cml_unbindModelGPU(&loadedModel);
+    printf("loaded kernels only: %d\n", success);
+
+    // Bound once, predicted several times with different inputs
+    cml_GPUModel boundModel = cml_bindModelGPU(model, &gpu);
+    success = success && boundModel.weights != NULL;
+    if(success) {
+        printf("layer kernels: %d %d %d\n", boundModel.layerKernels[0], boundModel.layerKernels[1], boundModel.layerKernels[2]);
+    }
+    for(size_t run = 0; run < 3 && success; run++) {
+        for(size_t i = 0; i < scale * layerSizes[0]; i++) {
+            in[i] = (float)((i + run) % 5) * 0.25f - 0.5f;
+        }
+        cml_predictCPU(model, in, expected);
+        success = cml_predictBoundModelGPU(boundModel, in, out);
+        for(size_t i = 0; i < scale * layerSizes[3] && success; i++) {
+            success = cml_withinMarginOfError(out[i], expected[i], 0.001f);
+        }
+    }
+    printf("bound predictions match: %d\n", success);
+
+    // the empty model of a failed bind unbinds like any other
+    cml_GPUModel failedBind;
+    memset(&failedBind, 0, sizeof(failedBind));
+    cml_unbindModelGPU(&failedBind);
+
+    // clean up memory
+    cml_unbindModelGPU(&boundModel);
+    free(in);
+    free(expected);
+    free(out);
+    cml_deleteModel(&model);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    cml_deleteGPU(&gpu);
+
+    return success;
+}
+
+bool test_gpuProgramCache() {
+    printf("==[ GPU program cache test ]==\n");
+    cml_GPU gpu = cml_setupGPU();
+    if(gpu.context == NULL) {
+        printf("no device\n");
+        return false;
+    }
+
+    const char* source = "__kernel void cacheTest(__global float* out) { out[get_global_id(0)] = 1.0f; }";
+    size_t size = strlen(source);
+    cml_gpuProgramCacheDirectory = ".";
+    char* path = cml_getGPUProgramCachePath(&gpu, source, size, NULL);
+    char* optionsPath = cml_getGPUProgramCachePath(&gpu, source, size, "-cl-fast-relaxed-math");
+    bool success = path != NULL && optionsPath != NULL && strcmp(path, optionsPath) != 0;
+    if(success) {
+        remove(path);
+    }
+
+    // the first build stores the binary, the second one loads it
+    cl_program programs[3] = {NULL, NULL, NULL};
+    programs[0] = success ? cml_buildGPUProgram(&gpu, source, size, NULL) : NULL;
+    FILE* file = success ? fopen(path, "rb") : NULL;
+    success = programs[0] != NULL && file != NULL;
+    if(file != NULL) {
+        fclose(file);
+    }
+    programs[1] = success ? cml_buildGPUProgram(&gpu, source, size, NULL) : NULL;
+    success = success && programs[1] != NULL;
+    printf("cached program built: %d\n", success);
+
+    // a damaged binary is replaced by a fresh build
+    file = success ? fopen(path, "wb") : NULL;
+    if(file != NULL) {
+        fputs("CMLCLBIN garbage", file);
+        fclose(file);
+    }
+    programs[2] = success ? cml_buildGPUProgram(&gpu, source, size, NULL) : NULL;
+    file = success ? fopen(path, "rb") : NULL;
+    success = programs[2] != NULL && file != NULL && fseek(file, 0, SEEK_END) == 0 && ftell(file) > 16;
+    if(file != NULL) {
+        fclose(file);
+    }
+    printf("damaged cache rebuilt: %d\n", success);
+
+    // clean up memory
+    for(size_t i = 0; i < 3; i++) {
+        if(programs[i] != NULL) {
+            clReleaseProgram(programs[i]);
+        }
+    }
+    if(path != NULL) {
+        remove(path);
+    }
+    free(path);
+    free(optionsPath);
+    cml_gpuProgramCacheDirectory = NULL;
+    cml_deleteGPU(&gpu);
+
+    return success;
+}
+
+bool test_kernelSources() {
+    printf("==[ Kernel sources test ]==\n");
+    // every program of the library is embedded, null-terminated
+    const char* programs[] = {CML_MATRIX_MULTIPLY_PROGRAM, CML_MATRIX_ADD_ROW_PROGRAM, CML_MATRIX_RELU_PROGRAM,
+        CML_MATRIX_MULTIPLY_TILED_PROGRAM, CML_MATRIX_ADD_ROW_BROADCAST_PROGRAM, CML_MATRIX_DENSE_PROGRAM};
+    bool success = cml_findKernelSource("missing.cl") == NULL;
+    for(size_t i = 0; i < sizeof(programs) / sizeof(programs[0]) && success; i++) {
+        const cml_KernelSource* source = cml_findKernelSource(programs[i]);
+        success = source != NULL && source->size > 0 && strlen(source->source) == source->size;
+    }
+    success = success && strstr(cml_findKernelSource(CML_MATRIX_DENSE_PROGRAM)->source, "matrixDenseRelu") != NULL;
+    printf("embedded programs found: %d\n", success);
+
+    // the set up gpu has a kernel of each, built from the embedded sources
+    cml_GPU gpu = cml_setupGPU();
+    success = success && gpu.context != NULL && gpu.kernelMap.size == sizeof(programs) / sizeof(programs[0]);
+    printf("embedded programs built: %d\n", success);
+
+    // clean up memory
+    if(gpu.context != NULL) {
+        cml_deleteGPU(&gpu);
+    }
+
+    return success;
+}
+
+bool test_gpuTuning() {
+    printf("==[ GPU tuning test ]==\n");
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {12,64,5};
+    size_t scale = 9;
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_RELU);
+    activations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+
+    cml_GPU gpu = cml_setupGPU();
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, scale, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)((i * 5) % 11) * 0.125f - 0.5f;
+    }
+
+    // every layer shape gets a tuning
+    const char* filename = "tuning.profile";
+    FILE* file = fopen(filename, "wb");
+    fputs("Other Device\t1 2 3 dense 8 8\n", file);
+    fclose(file);
+    cml_GPUProfile profile = cml_loadGPUProfile(filename, &gpu);
+    bool success = gpu.context != NULL && profile.deviceName != NULL && profile.tuningCount == 0 &&
+        cml_tuneModelGPU(&profile, &gpu, model, 2) && profile.tuningCount == 2;
+    for(size_t i = 0; i < numOflayers-1 && success; i++) {
+        success = cml_findGPUTuning(profile, scale, layerSizes[i], layerSizes[i+1]) != NULL;
+    }
+    printf("layers tuned: %d\n", success);
+
+    // saved and loaded again, the other device's line is kept
+    cml_GPUProfile loaded = {0};
+    if(success) {
+        success = cml_saveGPUProfile(filename, profile);
+        loaded = cml_loadGPUProfile(filename, &gpu);
+        success = success && loaded.deviceName != NULL && loaded.tuningCount == profile.tuningCount;
+    }
+    for(size_t i = 0; i < profile.tuningCount && success; i++) {
+        const cml_GPUTuning* tuning = &profile.tunings[i];
+        const cml_GPUTuning* found = cml_findGPUTuning(loaded, tuning->rows, tuning->sharedDimension, tuning->columns);
+        success = found != NULL && found->tiled == tuning->tiled &&
+            found->localSize[0] == tuning->localSize[0] && found->localSize[1] == tuning->localSize[1];
+    }
+    bool otherDeviceKept = false;
+    file = success ? fopen(filename, "rb") : NULL;
+    char line[256];
+    while(file != NULL && fgets(line, sizeof(line), file) != NULL) {
+        otherDeviceKept = otherDeviceKept || strcmp(line, "Other Device\t1 2 3 dense 8 8\n") == 0;
+    }
+    if(file != NULL) {
+        fclose(file);
+    }
+    success = success && otherDeviceKept;
+    printf("profile reloaded: %d\n", success);
+
+    // the tuned kernels predict like the CPU
+    cml_GPUModel boundModel = success ? cml_bindTunedModelGPU(model, &gpu, &loaded) : (cml_GPUModel){0};
+    success = success && boundModel.weights != NULL;
+    float* in = (float*)malloc(sizeof(float) * scale * layerSizes[0]);
+    float* expected = (float*)malloc(sizeof(float) * scale * layerSizes[2]);
+    float* out = (float*)malloc(sizeof(float) * scale * layerSizes[2]);
+    for(size_t i = 0; i < scale * layerSizes[0]; i++) {
+        in[i] = (float)(i % 7) * 0.25f - 0.75f;
+    }
+    cml_predictCPU(model, in, expected);
+    success = success && cml_predictBoundModelGPU(boundModel, in, out);
+    for(size_t i = 0; i < scale * layerSizes[2] && success; i++) {
+        success = cml_withinMarginOfError(out[i], expected[i], 0.001f);
+    }
+    printf("tuned predictions match: %d\n", success);
+
+    // a profile asking for the tiled kernel on columns it can't load as float4 gets the dense one
+    cml_GPUProfile edited = cml_createGPUProfile(&gpu);
+    cml_GPUTuning forcedTiled = {scale, layerSizes[1], layerSizes[2], true, {0, 0}};
+    cml_addGPUTuning(&edited, forcedTiled);
+    cml_GPUModel editedModel = success ? cml_bindTunedModelGPU(model, &gpu, &edited) : (cml_GPUModel){0};
+    success = success && editedModel.weights != NULL && editedModel.layerKernels[1] != CML_GPU_LAYER_TILED &&
+        cml_predictBoundModelGPU(editedModel, in, out);
+    for(size_t i = 0; i < scale * layerSizes[2] && success; i++) {
+        success = cml_withinMarginOfError(out[i], expected[i], 0.001f);
+    }
+    printf("unaligned tiled tuning ignored: %d\n", success);
+
+    // clean up memory
+    cml_unbindModelGPU(&editedModel);
+    cml_deleteGPUProfile(&edited);
+    cml_unbindModelGPU(&boundModel);
+    free(in);
+    free(expected);
+    free(out);
+    cml_deleteGPUProfile(&loaded);
+    cml_deleteGPUProfile(&profile);
+    remove(filename);
+    cml_deleteModel(&model);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    if(gpu.context != NULL) {
+        cml_deleteGPU(&gpu);
+    }
+
+    return success;
+}
+
+bool test_gpuStream() {
+    printf("==[ GPU stream test ]==\n");
+    // a deeper model with widths the tiled kernel can't take, five full batches and a partial one,
+    // more than the slots hold at once
+    uint64 layerSizes[] = {12,24,20,3};
+    size_t scale = 4;
+    BatchFixture fixture = createBatchFixture(4, layerSizes, scale, CML_LINEAR, 3, 5 * scale + 3);
+
+    cml_GPU gpu = cml_setupGPU();
+    cml_GPUModel boundModel = gpu.context != NULL ? cml_bindModelGPU(fixture.model, &gpu) : (cml_GPUModel){0};
+    cml_GPUStream stream = boundModel.weights != NULL ? cml_createGPUStream(boundModel, 3) : (cml_GPUStream){0};
+    bool success = stream.slots != NULL;
+    printf("stream created: %d\n", success);
+
+    // every batch matches the CPU on every run, also a single batch that isn't full
+    for(size_t run = 0; run < 2 && success; run++) {
+        success = cml_predictStreamGPU(&stream, fixture.in, fixture.out, fixture.rowCount) &&
+            matchesCPUInBatches(fixture.model, fixture.in, fixture.out, fixture.rowCount);
+    }
+    success = success && cml_predictStreamGPU(&stream, fixture.in, fixture.out, scale - 1) &&
+        matchesCPUInBatches(fixture.model, fixture.in, fixture.out, scale - 1);
+    printf("streamed predictions match: %d\n", success);
+
+    // the stream's copies share the weights, the bound model still predicts on its own
+    size_t outputSize = layerSizes[3];
+    success = success && cml_predictBoundModelGPU(boundModel, fixture.in, fixture.out) &&
+        cml_predictStreamGPU(&stream, fixture.in, fixture.out + scale * outputSize, scale);
+    for(size_t i = 0; i < scale * outputSize && success; i++) {
+        success = cml_withinMarginOfError(fixture.out[i], fixture.out[scale * outputSize + i], 0.001f);
+    }
+    printf("bound model unaffected: %d\n", success);
+
+    // clean up memory
+    if(stream.slots != NULL) {
+        cml_deleteGPUStream(&stream);
+    }
+    cml_unbindModelGPU(&boundModel);
+    deleteBatchFixture(&fixture);
+    if(gpu.context != NULL) {
+        cml_deleteGPU(&gpu);
+    }
+
+    return success;
+}
+
+bool test_customActivationGPU() {
+    printf("==[ Custom GPU activation test ]==\n");
+    // two kernels of one program, after a tiled layer and a dense one
+    const char* programFilename = "test_activations.cl";
+    FILE* file = fopen(programFilename, "w");
+    fputs("__kernel void testSquare(__global const float* in, __global float* out) {\n"
+          "    int i = get_global_id(0);\n"
+          "    out[i] = in[i] * in[i];\n"
+          "}\n"
+          "__kernel void testNegate(__global const float* in, __global float* out) {\n"
+          "    int i = get_global_id(0);\n"
+          "    out[i] = -in[i];\n"
+          "}\n", file);
+    fclose(file);
+
+    size_t numOflayers = 3;
+    uint64 layerSizes[] = {20,64,3};
+    size_t scale = 10;
+    cml_ActivationFnMetadata* activations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    activations[0] = cml_createActivationFnMetadataWithID(programFilename, "testSquare", CML_CUSTOM);
+    activations[1] = cml_createActivationFnMetadataWithID(programFilename, "testNegate", CML_CUSTOM);
+
+    cml_GPU gpu = cml_setupGPU();
+    cml_Model model = cml_createScaledModel(numOflayers, layerSizes, scale, activations);
+    size_t cells = cml_getModelDataSize(model) / sizeof(float);
+    for(size_t i = 0; i < cells; i++) {
+        model.data[i] = (float)((i * 5) % 9) * 0.125f - 0.5f;
+    }
+
+    // custom programs are kept out of the gpu and built once for its context
+    size_t programCount = gpu.programMap.size;
+    cml_GPUModel boundModel = gpu.context != NULL ? cml_bindModelGPU(model, &gpu) : (cml_GPUModel){0};
+    bool success = boundModel.weights != NULL && gpu.programMap.size == programCount;
+    cml_GPUModel reboundModel = success ? cml_bindModelGPU(model, &gpu) : (cml_GPUModel){0};
+    success = success && reboundModel.weights != NULL && gpu.programMap.size == programCount;
+    cl_program boundProgram = NULL;
+    cl_program reboundProgram = NULL;
+    if(success) {
+        clGetKernelInfo(boundModel.activationKernels[0], CL_KERNEL_PROGRAM, sizeof(cl_program), &boundProgram, NULL);
+        clGetKernelInfo(reboundModel.activationKernels[1], CL_KERNEL_PROGRAM, sizeof(cl_program), &reboundProgram, NULL);
+    }
+    success = success && boundProgram != NULL && boundProgram == reboundProgram;
+    printf("programs kept out of the gpu: %d\n", success);
+
+    // a kernel only comes from the program its metadata names, even when another program has one of that name
+    const char* otherProgramFilename = "test_activations_other.cl";
+    file = fopen(otherProgramFilename, "w");
+    fputs("__kernel void testNegate(__global const float* in, __global float* out) {\n"
+          "    int i = get_global_id(0);\n"
+          "    out[i] = -in[i];\n"
+          "}\n", file);
+    fclose(file);
+    cml_ActivationFnMetadata* otherActivations = (cml_ActivationFnMetadata*)malloc(sizeof(cml_ActivationFnMetadata) * 2);
+    otherActivations[0] = cml_createActivationFnMetadataWithID(otherProgramFilename, "testSquare", CML_CUSTOM);
+    otherActivations[1] = cml_createActivationFnMetadataWithID(NULL, NULL, CML_LINEAR);
+    cml_Model otherModel = cml_createScaledModel(numOflayers, layerSizes, scale, otherActivations);
+    cml_GPUModel otherBoundModel = success ? cml_bindModelGPU(otherModel, &gpu) : (cml_GPUModel){0};
+    success = success && otherBoundModel.weights == NULL;
+    cml_deleteModel(&otherModel);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&otherActivations[i]);
+    }
+    free(otherActivations);
+    remove(otherProgramFilename);
+    printf("kernels taken from their own program: %d\n", success);
+
+    // out = -((in * W0 + b0)^2 * W1 + b1)
+    cml_ModelMatrices matrices = cml_getModelMatrices(model);
+    float* in = (float*)malloc(sizeof(float) * scale * layerSizes[0]);
+    float* hidden = (float*)malloc(sizeof(float) * scale * layerSizes[1]);
+    float* expected = (float*)malloc(sizeof(float) * scale * layerSizes[2]);
+    float* out = (float*)malloc(sizeof(float) * scale * layerSizes[2]);
+    for(size_t i = 0; i < scale * layerSizes[0]; i++) {
+        in[i] = (float)(i % 7) * 0.25f - 0.75f;
+    }
+    for(size_t row = 0; row < scale; row++) {
+        for(size_t col = 0; col < layerSizes[1]; col++) {
+            float value = matrices.biases[0].data[col];
+            for(size_t k = 0; k < layerSizes[0]; k++) {
+                value += in[row * layerSizes[0] + k] * matrices.weights[0].data[k * layerSizes[1] + col];
+            }
+            hidden[row * layerSizes[1] + col] = value * value;
+        }
+        for(size_t col = 0; col < layerSizes[2]; col++) {
+            float value = matrices.biases[1].data[col];
+            for(size_t k = 0; k < layerSizes[1]; k++) {
+                value += hidden[row * layerSizes[1] + k] * matrices.weights[1].data[k * layerSizes[2] + col];
+            }
+            expected[row * layerSizes[2] + col] = -value;
+        }
+    }
+    cml_deleteModelMatrices(matrices);
+    success = success && cml_predictBoundModelGPU(boundModel, in, out);
+    for(size_t i = 0; i < scale * layerSizes[2] && success; i++) {
+        success = cml_withinMarginOfError(out[i], expected[i], 0.01f);
+    }
+    printf("custom activations on the device: %d\n", success);
+
+    // copies of the bound model run the same kernels
+    cml_GPUModel copy = success ? cml_copyBoundModelGPU(boundModel) : (cml_GPUModel){0};
+    success = copy.weights != NULL && cml_predictBoundModelGPU(copy, in, out);
+    for(size_t i = 0; i < scale * layerSizes[2] && success; i++) {
+        success = cml_withinMarginOfError(out[i], expected[i], 0.01f);
+    }
+    printf("copied custom activations: %d\n", success);
+
+    // clean up memory
+    cml_unbindModelGPU(&copy);
+    cml_unbindModelGPU(&reboundModel);
+    cml_unbindModelGPU(&boundModel);
+    free(in);
+    free(hidden);
+    free(expected);
+    free(out);
+    cml_deleteModel(&model);
+    for(size_t i = 0; i < numOflayers-1; i++) {
+        cml_deleteActivationFnMetadata(&activations[i]);
+    }
+    free(activations);
+    if(gpu.context != NULL) {
+        cml_releaseGPUPrograms(&gpu);
+        cml_deleteGPU(&gpu);
+    }
+    remove(programFilename);
+
+    return success;
+}
+
+bool test_gpuBufferPool() {
+    printf("==[ GPU buffer pool test ]==\n");
+    bool success = cml_getGPUBufferSizeClass(1) == CML_GPU_BUFFER_MIN_SIZE &&
+        cml_getGPUBufferSizeClass(256) == 256 &&
+        cml_getGPUBufferSizeClass(257) == 320 &&
+        cml_getGPUBufferSizeClass(1000) == 1024 &&
+        cml_getGPUBufferSizeClass(1025) == 1280 &&
+        cml_getGPUBufferSizeClass(3 << 20) == 3 << 20;
+    printf("size classes: %d\n", success);
+
+    // odd widths so no buffer fills a size class exactly, a single batch
+    uint64 layerSizes[] = {9,17,2};
+    size_t scale = 6;
+    BatchFixture fixture = createBatchFixture(3, layerSizes, scale, CML_LINEAR, 7, scale);
+    cml_GPU gpu = cml_setupGPU();
+
+    // the second bind reuses every buffer of the first one
+    cml_GPUBufferPool* pool = gpu.context != NULL ? cml_createGPUBufferPool(&gpu, 0) : NULL;
+    cml_GPUBindOptions options = cml_createGPUBindOptions();
+    options.pool = pool;
+    cml_GPUBufferPoolStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for(size_t bind = 0; bind < 2 && success; bind++) {
+        cml_GPUModel boundModel = cml_bindModelGPUWithOptions(fixture.model, &gpu, options);
+        success = boundModel.weights != NULL && cml_predictBoundModelGPU(boundModel, fixture.in, fixture.out) &&
+            matchesCPUInBatches(fixture.model, fixture.in, fixture.out, fixture.rowCount);
+        stats = cml_getGPUBufferPoolStats(pool);
+        success = success && stats.bytesInUse > 0;
+        cml_unbindModelGPU(&boundModel);
+    }
+    uint64 requestsPerBind = stats.requests / 2;
+    stats = cml_getGPUBufferPoolStats(pool);
+    success = success && requestsPerBind > 0 && stats.hits == requestsPerBind &&
+        stats.bytesInUse == 0 && stats.bytesPooled == stats.peakBytes;
+    printf("buffers reused: %d, hits %llu of %llu\n", success,
+        (unsigned long long)stats.hits, (unsigned long long)stats.requests);
+
+    // trimming frees everything pooled, a limit of one buffer frees the rest as they are released
+    success = success && cml_trimGPUBufferPool(pool) == stats.bytesPooled &&
+        cml_getGPUBufferPoolStats(pool).bytesPooled == 0;
+    if(pool != NULL) {
+        cml_deleteGPUBufferPool(pool);
+    }
+    pool = success ? cml_createGPUBufferPool(&gpu, 1024) : NULL;
+    cl_mem buffers[3] = {NULL, NULL, NULL};
+    for(size_t i = 0; i < 3 && success; i++) {
+        buffers[i] = cml_acquireGPUBuffer(pool, 1000);
+        success = buffers[i] != NULL;
+    }
+    for(size_t i = 0; i < 3 && success; i++) {
+        cml_releaseGPUBuffer(pool, buffers[i]);
+    }
+    success = success && cml_getGPUBufferPoolStats(pool).bytesPooled == 1024;
+    printf("pool limit kept: %d\n", success);
+
+    // clean up memory
+    if(pool != NULL) {
+        cml_deleteGPUBufferPool(pool);
+    }
+    deleteBatchFixture(&fixture);
+    if(gpu.context != NULL) {
+        cml_deleteGPU(&gpu);
+    }
+
+    return success;
+}
+
+bool test_hybridPredict() {
+    printf("==[ Hybrid predict test ]==\n");
+    // a wide output and relu on the last layer
+    uint64 layerSizes[] = {6,32,10};
+    size_t scale = 4;
+    BatchFixture fixture = createBatchFixture(3, layerSizes, scale, CML_RELU, 5, 9 * scale + 1);
+
+    cml_GPU gpu = cml_setupGPU();
+    cml_GPUModel boundModel = gpu.context != NULL ? cml_bindModelGPU(fixture.model, &gpu) : (cml_GPUModel){0};
+    cml_HybridPredictor predictor = boundModel.weights != NULL ? cml_createHybridPredictor(fixture.model, boundModel) : (cml_HybridPredictor){0};
+    bool success = predictor.threads != NULL;
+
+    // the split follows the measured speeds, whole batches to the device
+    success = success && cml_getHybridGPURows(predictor, 12 * scale) == 6 * scale;
+    predictor.cpuSecondsPerRow = 3e-6;
+    predictor.gpuSecondsPerRow = 1e-6;
+    success = success && cml_getHybridGPURows(predictor, 12 * scale) == 9 * scale &&
+        cml_getHybridGPURows(predictor, 1) == 0;
+    predictor.cpuSecondsPerRow = 0;
+    predictor.gpuSecondsPerRow = 0;
+    printf("split by throughput: %d\n", success);
+
+    // both sides fill their part of out and get timed
+    for(size_t run = 0; run < 3 && success; run++) {
+        success = cml_predictHybrid(&predictor, fixture.in, fixture.out, fixture.rowCount) &&
+            matchesCPUInBatches(fixture.model, fixture.in, fixture.out, fixture.rowCount);
+    }
+    success = success && predictor.cpuSecondsPerRow > 0 && predictor.gpuSecondsPerRow > 0;
+    printf("hybrid predictions match: %d\n", success);
+
+    // fewer rows than a batch go to one side whole
+    success = success && cml_predictHybrid(&predictor, fixture.in, fixture.out, scale - 1) &&
+        matchesCPUInBatches(fixture.model, fixture.in, fixture.out, scale - 1);
+    printf("partial batch: %d\n", success);
+
+    // clean up memory
+    if(predictor.threads != NULL) {
+        cml_deleteHybridPredictor(&predictor);
+    }
+    cml_unbindModelGPU(&boundModel);
+    deleteBatchFixture(&fixture);
+    if(gpu.context != NULL) {
+        cml_deleteGPU(&gpu);
+    }
+
+    return success;
+}
+
+bool test_multiGPUPredict() {
+    printf("==[ Multi GPU predict test ]==\n");
+    // tile sized hidden layers and a single output
+    uint64 layerSizes[] = {5,16,16,1};
+    size_t scale = 4;
+    size_t rowCount = 9 * scale + 1;
+    BatchFixture fixture = createBatchFixture(4, layerSizes, scale, CML_LINEAR, 7, rowCount);
+
+    cml_MultiGPUExecutor executor = cml_createMultiGPUExecutor(fixture.model, 8);
+    bool success = executor.deviceCount > 0;
+    printf("devices: %zu\n", executor.deviceCount);
+
+    // even shards until timed, then by speed, the last one ending at the last row
+    size_t* rows = (size_t*)malloc(sizeof(size_t) * (executor.deviceCount > 0 ? executor.deviceCount : 1));
+    if(success) {
+        size_t total = 0;
+        cml_getMultiGPUShards(executor, rowCount, rows);
+        for(size_t i = 0; i < executor.deviceCount; i++) {
+            total += rows[i];
+        }
+        success = total == rowCount;
+    }
+    if(success && executor.deviceCount == 2) {
+        cml_getMultiGPUShards(executor, 12 * scale, rows);
+        success = rows[0] == 6 * scale && rows[1] == 6 * scale;
+        executor.devices[0].secondsPerRow = 1e-6;
+        executor.devices[1].secondsPerRow = 3e-6;
+        cml_getMultiGPUShards(executor, 12 * scale, rows);
+        success = success && rows[0] == 9 * scale && rows[1] == 3 * scale;
+        cml_getMultiGPUShards(executor, rowCount, rows);
+        success = success && rows[0] == 8 * scale && rows[1] == scale + 1;
+        executor.devices[0].secondsPerRow = 0;
+        executor.devices[1].secondsPerRow = 0;
+    }
+    printf("split by device speed: %d\n", success);
+
+    // every shard lands in its rows of out and every device gets timed
+    for(size_t run = 0; run < 3 && success; run++) {
+        success = cml_predictMultiGPU(&executor, fixture.in, fixture.out, rowCount) &&
+            matchesCPUInBatches(fixture.model, fixture.in, fixture.out, rowCount);
+    }
+    for(size_t i = 0; i < executor.deviceCount && success; i++) {
+        success = executor.devices[i].secondsPerRow > 0;
+    }
+    printf("multi GPU predictions match: %d\n", success);
+
+    // a single partial batch leaves every device but one with an empty shard
+    success = success && cml_predictMultiGPU(&executor, fixture.in, fixture.out, scale - 1) &&
+        matchesCPUInBatches(fixture.model, fixture.in, fixture.out, scale - 1);
+    printf("empty shards: %d\n", success);
+
+    // clean up memory
+    if(executor.deviceCount > 0) {
+        cml_deleteMultiGPUExecutor(&executor);
+    }
+    free(rows);
+    deleteBatchFixture(&fixture);
+
+    return success;
+}
@@ -0,0 +1,80 @@
+// Packs model files of any supported format version into a single bundle
+// usage: cml-bundle <output bundle> <name>=<model file>...
+// Lists the models of a bundle when only the bundle is given
+
+#include <cml/Model.h>
+#include <cml/ModelBundle.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int cml_listBundle(const char* filename) {
+    cml_ModelBundle bundle = cml_openModelBundle(filename);
+    if(bundle.filename == NULL) {
+        fprintf(stderr, "failed to open bundle %s\n", filename);
+        return 1;
+    }
+
+    for(size_t i = 0; i < bundle.entryCount; i++) {
+        printf("%s: %llu bytes at %llu\n",
+            bundle.entries[i].name,
+            (unsigned long long)bundle.entries[i].size,
+            (unsigned long long)bundle.entries[i].offset);
+    }
+    cml_closeModelBundle(&bundle);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <output bundle> <name>=<model file>...\n", argv[0]);
+        return 1;
+    }
+    if(argc == 2) {
+        return cml_listBundle(argv[1]);
+    }
+
+    size_t count = (size_t)(argc - 2);
+    char** names = (char**)calloc(count, sizeof(char*));
+    cml_Model* models = (cml_Model*)calloc(count, sizeof(cml_Model));
+    int result = 0;
+    for(size_t i = 0; i < count && result == 0; i++) {
+        const char* argument = argv[i + 2];
+        const char* separator = strchr(argument, '=');
+        if(separator == NULL || separator == argument) {
+            fprintf(stderr, "expected <name>=<model file>, got %s\n", argument);
+            result = 1;
+            break;
+        }
+
+        size_t nameSize = (size_t)(separator - argument);
+        names[i] = (char*)malloc(nameSize + 1);
+        memcpy(names[i], argument, nameSize);
+        names[i][nameSize] = '\0';
+
+        models[i] = cml_mapModel(separator + 1);
+        if(models[i].data == NULL) {
+            fprintf(stderr, "failed to load %s\n", separator + 1);
+            result = 1;
+        }
+    }
+
+    if(result == 0 && !cml_writeModelBundle(argv[1], (const char* const*)names, models, count)) {
+        fprintf(stderr, "failed to write %s, are the names unique?\n", argv[1]);
+        result = 1;
+    }
+    if(result == 0) {
+        printf("%zu models -> %s\n", count, argv[1]);
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        free(names[i]);
+        if(models[i].data != NULL) {
+            cml_deleteModel(&models[i]);
+        }
+    }
+    free(names);
+    free(models);
+    return result;
+}
@@ -0,0 +1,58 @@
+// Writes a patch turning the weights and biases of one model into those of another
+// usage: cml-diff <base model> <target model> <output patch>
+// Apply it to a live model with cml_applyModelPatch
+
+#include <cml/Model.h>
+#include <cml/ModelPatch.h>
+
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+    if(argc != 4) {
+        fprintf(stderr, "usage: %s <base model> <target model> <output patch>\n", argv[0]);
+        return 1;
+    }
+
+    cml_Model base = cml_mapModel(argv[1]);
+    cml_Model target = cml_mapModel(argv[2]);
+    int result = 0;
+    if(base.data == NULL || target.data == NULL) {
+        fprintf(stderr, "failed to load %s\n", base.data == NULL ? argv[1] : argv[2]);
+        result = 1;
+    }
+
+    cml_ModelPatch patch;
+    patch.layerSizes = NULL;
+    if(result == 0) {
+        patch = cml_diffModels(base, target);
+        if(patch.layerSizes == NULL) {
+            fprintf(stderr, "the models have different layer sizes\n");
+            result = 1;
+        }
+    }
+
+    if(result == 0) {
+        cml_String serializedPatch = cml_serializeModelPatch(patch);
+        FILE* file = fopen(argv[3], "wb");
+        if(file == NULL || fwrite(serializedPatch.data, 1, serializedPatch.size, file) != serializedPatch.size) {
+            fprintf(stderr, "failed to write %s\n", argv[3]);
+            result = 1;
+        }
+        if(file != NULL && fclose(file) != 0) {
+            result = 1;
+        }
+        if(result == 0) {
+            printf("%zu entries, %zu bytes -> %s\n", patch.entryCount, serializedPatch.size, argv[3]);
+        }
+        cml_deleteString(&serializedPatch);
+        cml_deleteModelPatch(&patch);
+    }
+
+    if(base.data != NULL) {
+        cml_deleteModel(&base);
+    }
+    if(target.data != NULL) {
+        cml_deleteModel(&target);
+    }
+    return result;
+}
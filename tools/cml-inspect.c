@@ -0,0 +1,144 @@
+// Reports the shape and cost of model files from their headers alone, the sections are never read
+// usage: cml-inspect [--batch <size>] <model file>...
+// FLOPs count a multiply and an add per weight plus one operation per bias and per activation,
+// memory is the size of model.data at the batch size (activations of every layer plus parameters)
+
+#include <cml/ModelFormat.h>
+#include <cml/ModelStream.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* cml_getActivationName(const enum cml_ActivationID activationID) {
+    switch(activationID) {
+        case CML_LINEAR: return "linear";
+        case CML_RELU: return "relu";
+        case CML_CUSTOM: return "custom";
+        default: return "none";
+    }
+}
+
+static const char* cml_getSectionTypeName(const uint32 type) {
+    switch(type) {
+        case CML_SECTION_DATA: return "data";
+        case CML_SECTION_WEIGHTS: return "weights";
+        case CML_SECTION_BIASES: return "biases";
+        default: return "unknown";
+    }
+}
+
+static const char* cml_getSectionEncodingName(const uint32 encoding) {
+    switch(encoding) {
+        case CML_ENCODING_RAW: return "raw";
+        case CML_ENCODING_SHUFFLE_LZ: return "shuffle-lz";
+        default: return "unknown";
+    }
+}
+
+static int cml_inspectModel(const char* filename, const uint64 batchSize) {
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        fprintf(stderr, "failed to open %s\n", filename);
+        return 1;
+    }
+    cml_ModelHeader header;
+    bool headerRead = cml_readModelHeaderFromFile(file, &header);
+    fclose(file);
+    if(!headerRead) {
+        fprintf(stderr, "failed to read the header of %s\n", filename);
+        return 1;
+    }
+
+    printf("%s: version %u, %llu layers, scale %llu%s\n",
+        filename,
+        header.version,
+        (unsigned long long)header.layerCount,
+        (unsigned long long)header.scale,
+        (header.flags & CML_MODEL_FLAG_CHECKSUMS) ? ", checksums" : "");
+
+    uint64 parameterCount = 0;
+    uint64 flopsPerSample = 0;
+    uint64 activationCells = 0;
+    for(size_t i = 0; i < header.layerCount; i++) {
+        uint64 layerSize = header.layerSizes[i];
+        activationCells += layerSize;
+        if(i == 0) {
+            printf("  layer 0: %llu inputs\n", (unsigned long long)layerSize);
+            continue;
+        }
+
+        const cml_ActivationFnMetadata* activation = &header.activationFunctions[i-1];
+        uint64 previousSize = header.layerSizes[i-1];
+        parameterCount += previousSize * layerSize + layerSize;
+        flopsPerSample += 2 * previousSize * layerSize + 2 * layerSize;
+        // inputs and outputs of the activation
+        activationCells += layerSize;
+
+        printf("  layer %zu: %llu units, %s", i, (unsigned long long)layerSize, cml_getActivationName(activation->activationID));
+        if(activation->gpuKernelName.size > 0) {
+            printf(", kernel %.*s in %.*s",
+                (int)activation->gpuKernelName.size, activation->gpuKernelName.data,
+                (int)activation->gpuProgramFilename.size, activation->gpuProgramFilename.data);
+        }
+        printf("\n");
+    }
+
+    uint64 storedSize = header.headerSize;
+    for(size_t i = 0; i < header.sectionCount; i++) {
+        const cml_ModelSection* section = &header.sections[i];
+        printf("  section %s", cml_getSectionTypeName(section->type));
+        if(section->type != CML_SECTION_DATA) {
+            printf(" %llu", (unsigned long long)section->layer);
+        }
+        printf(": %s, %llu bytes (%llu decoded) at %llu\n",
+            cml_getSectionEncodingName(section->encoding),
+            (unsigned long long)section->size,
+            (unsigned long long)section->rawSize,
+            (unsigned long long)section->offset);
+        if(section->offset + section->size > storedSize) {
+            storedSize = section->offset + section->size;
+        }
+    }
+
+    // version 1 files have no sections, the data block at the stored scale follows the header
+    if(header.version == 1) {
+        storedSize += (activationCells * header.scale + parameterCount) * sizeof(float);
+    }
+
+    printf("  parameters: %llu (%llu bytes)\n",
+        (unsigned long long)parameterCount,
+        (unsigned long long)(parameterCount * sizeof(float)));
+    printf("  FLOPs per sample: %llu\n", (unsigned long long)flopsPerSample);
+    printf("  memory at batch %llu: %llu bytes\n",
+        (unsigned long long)batchSize,
+        (unsigned long long)((activationCells * batchSize + parameterCount) * sizeof(float)));
+    printf("  file size: %llu bytes\n", (unsigned long long)storedSize);
+
+    cml_deleteModelHeader(&header);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    uint64 batchSize = 1;
+    int firstFile = 1;
+    if(argc > 2 && strcmp(argv[1], "--batch") == 0) {
+        char* end;
+        batchSize = strtoull(argv[2], &end, 10);
+        if(*end != '\0' || batchSize == 0) {
+            fprintf(stderr, "expected a positive batch size, got %s\n", argv[2]);
+            return 1;
+        }
+        firstFile = 3;
+    }
+    if(firstFile >= argc) {
+        fprintf(stderr, "usage: %s [--batch <size>] <model file>...\n", argv[0]);
+        return 1;
+    }
+
+    int result = 0;
+    for(int i = firstFile; i < argc; i++) {
+        result |= cml_inspectModel(argv[i], batchSize);
+    }
+    return result;
+}
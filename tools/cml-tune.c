@@ -0,0 +1,113 @@
+// Times the layer kernels of model files on the first device and stores the fastest in a profile,
+// for cml_bindTunedModelGPU to use at bind time. Only the headers of the models are read.
+// usage: cml-tune [--profile <file>] [--repeat <count>] <model file>...
+// Every layer shape is tuned at the scale of its model, shapes the profile already has are skipped.
+// The profile defaults to cml-tune.profile, lines of other devices in it are kept.
+
+#include <cml/GPUKernels.h>
+#include <cml/GPUTuning.h>
+#include <cml/ModelFormat.h>
+#include <cml/ModelStream.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int cml_tuneModelFile(cml_GPUProfile* profile, cml_GPU* gpu, const char* filename, const size_t repetitions) {
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        fprintf(stderr, "failed to open %s\n", filename);
+        return 1;
+    }
+    cml_ModelHeader header;
+    bool headerRead = cml_readModelHeaderFromFile(file, &header);
+    fclose(file);
+    if(!headerRead) {
+        fprintf(stderr, "failed to read the header of %s\n", filename);
+        return 1;
+    }
+
+    int result = 0;
+    for(size_t i = 1; i < header.layerCount; i++) {
+        uint64 sharedDimension = header.layerSizes[i-1];
+        uint64 columns = header.layerSizes[i];
+        const cml_GPUTuning* tuning = cml_findGPUTuning(*profile, header.scale, sharedDimension, columns);
+        cml_GPUTuning tuned;
+        if(tuning == NULL) {
+            tuned = cml_tuneGPULayer(gpu, header.scale, sharedDimension, columns, repetitions);
+            if(tuned.rows == 0) {
+                fprintf(stderr, "failed to tune layer %zu of %s\n", i, filename);
+                result = 1;
+                continue;
+            }
+            cml_addGPUTuning(profile, tuned);
+            tuning = &tuned;
+        }
+        printf("%s layer %zu: %llu x %llu x %llu, ", filename, i,
+            (unsigned long long)tuning->rows,
+            (unsigned long long)tuning->sharedDimension,
+            (unsigned long long)tuning->columns);
+        if(tuning->tiled) {
+            printf("tiled\n");
+        } else if(tuning->localSize[0] == 0) {
+            printf("dense, driver work-group size\n");
+        } else {
+            printf("dense, work-group %zu x %zu\n", tuning->localSize[0], tuning->localSize[1]);
+        }
+    }
+
+    cml_deleteModelHeader(&header);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const char* profileFilename = "cml-tune.profile";
+    size_t repetitions = 10;
+    int firstFile = 1;
+    while(firstFile + 1 < argc && strncmp(argv[firstFile], "--", 2) == 0) {
+        if(strcmp(argv[firstFile], "--profile") == 0) {
+            profileFilename = argv[firstFile+1];
+        } else if(strcmp(argv[firstFile], "--repeat") == 0) {
+            char* end;
+            repetitions = (size_t)strtoull(argv[firstFile+1], &end, 10);
+            if(*end != '\0' || repetitions == 0) {
+                fprintf(stderr, "expected a positive repeat count, got %s\n", argv[firstFile+1]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[firstFile]);
+            return 1;
+        }
+        firstFile += 2;
+    }
+    if(firstFile >= argc) {
+        fprintf(stderr, "usage: %s [--profile <file>] [--repeat <count>] <model file>...\n", argv[0]);
+        return 1;
+    }
+
+    cml_GPU gpu = cml_setupGPU();
+    if(gpu.context == NULL) {
+        fprintf(stderr, "no OpenCL device found\n");
+        return 1;
+    }
+    cml_GPUProfile profile = cml_loadGPUProfile(profileFilename, &gpu);
+    if(profile.deviceName == NULL) {
+        fprintf(stderr, "failed to read %s or the device has no name\n", profileFilename);
+        cml_deleteGPU(&gpu);
+        return 1;
+    }
+    printf("device: %s\n", profile.deviceName);
+
+    int result = 0;
+    for(int i = firstFile; i < argc; i++) {
+        result |= cml_tuneModelFile(&profile, &gpu, argv[i], repetitions);
+    }
+    if(!cml_saveGPUProfile(profileFilename, profile)) {
+        fprintf(stderr, "failed to write %s\n", profileFilename);
+        result = 1;
+    }
+
+    cml_deleteGPUProfile(&profile);
+    cml_deleteGPU(&gpu);
+    return result;
+}
@@ -0,0 +1,24 @@
+// Rewrites model files of any supported format version in the current format
+// usage: cml-upgrade <input model> [output model]
+// The input file is upgraded in place when no output is given
+
+#include <cml/Model.h>
+
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+    if(argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <input model> [output model]\n", argv[0]);
+        return 1;
+    }
+
+    const char* inputFilename = argv[1];
+    const char* outputFilename = argc == 3 ? argv[2] : argv[1];
+    if(!cml_upgradeModelFile(inputFilename, outputFilename)) {
+        fprintf(stderr, "failed to upgrade %s\n", inputFilename);
+        return 1;
+    }
+
+    printf("%s -> %s\n", inputFilename, outputFilename);
+    return 0;
+}